@@ -0,0 +1,117 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+
+/**
+ * @brief A thread-safe FIFO queue with a maximum size
+ *
+ * Push() blocks while the queue is full and Pop() blocks while it's empty, so a slow consumer applies back-pressure to
+ * its producers rather than letting the queue grow without limit. Cancel() wakes everyone waiting and makes all
+ * further calls return false, which is how threads blocked on the queue are told to exit.
+ */
+template<typename T>
+class BoundedQueue
+{
+public:
+  BoundedQueue(int capacity) :
+    capacity_(capacity),
+    cancelled_(false)
+  {
+  }
+
+  /**
+   * @brief Add an item to the end of the queue, waiting for space if necessary
+   *
+   * @return False if the queue was cancelled before the item could be added
+   */
+  bool Push(const T& item)
+  {
+    QMutexLocker locker(&mutex_);
+
+    while (queue_.size() >= capacity_ && !cancelled_) {
+      not_full_.wait(&mutex_);
+    }
+
+    if (cancelled_) {
+      return false;
+    }
+
+    queue_.append(item);
+    not_empty_.wakeOne();
+
+    return true;
+  }
+
+  /**
+   * @brief Take an item from the front of the queue, waiting for one if necessary
+   *
+   * @return False if the queue was cancelled before an item became available
+   */
+  bool Pop(T* item)
+  {
+    QMutexLocker locker(&mutex_);
+
+    while (queue_.isEmpty() && !cancelled_) {
+      not_empty_.wait(&mutex_);
+    }
+
+    if (cancelled_) {
+      return false;
+    }
+
+    *item = queue_.takeFirst();
+    not_full_.wakeOne();
+
+    return true;
+  }
+
+  void Cancel()
+  {
+    QMutexLocker locker(&mutex_);
+
+    cancelled_ = true;
+    queue_.clear();
+
+    not_empty_.wakeAll();
+    not_full_.wakeAll();
+  }
+
+private:
+  QMutex mutex_;
+
+  QWaitCondition not_empty_;
+
+  QWaitCondition not_full_;
+
+  QList<T> queue_;
+
+  int capacity_;
+
+  bool cancelled_;
+
+};
+
+#endif // BOUNDEDQUEUE_H
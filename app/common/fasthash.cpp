@@ -0,0 +1,184 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "fasthash.h"
+
+#include <QtEndian>
+
+namespace {
+
+const quint64 kC1 = Q_UINT64_C(0x87c37b91114253d5);
+const quint64 kC2 = Q_UINT64_C(0x4cf5ad432745937f);
+
+inline quint64 RotateLeft(quint64 x, int r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+inline quint64 FinalMix(quint64 k)
+{
+  k ^= k >> 33;
+  k *= Q_UINT64_C(0xff51afd7ed558ccd);
+  k ^= k >> 33;
+  k *= Q_UINT64_C(0xc4ceb9fe1a85ec53);
+  k ^= k >> 33;
+
+  return k;
+}
+
+}
+
+FastHash::FastHash(quint64 seed) :
+  seed_(seed)
+{
+  reset();
+}
+
+void FastHash::reset()
+{
+  h1_ = seed_;
+  h2_ = seed_;
+  buffer_length_ = 0;
+  total_length_ = 0;
+}
+
+void FastHash::addData(const char *data, int length)
+{
+  const uchar* bytes = reinterpret_cast<const uchar*>(data);
+
+  total_length_ += static_cast<quint64>(length);
+
+  // Top up a partially filled block first
+  if (buffer_length_ > 0) {
+    int copy = qMin(length, 16 - buffer_length_);
+
+    memcpy(buffer_ + buffer_length_, bytes, static_cast<size_t>(copy));
+    buffer_length_ += copy;
+    bytes += copy;
+    length -= copy;
+
+    if (buffer_length_ < 16) {
+      return;
+    }
+
+    ProcessBlock(buffer_, &h1_, &h2_);
+    buffer_length_ = 0;
+  }
+
+  while (length >= 16) {
+    ProcessBlock(bytes, &h1_, &h2_);
+    bytes += 16;
+    length -= 16;
+  }
+
+  if (length > 0) {
+    memcpy(buffer_, bytes, static_cast<size_t>(length));
+    buffer_length_ = length;
+  }
+}
+
+void FastHash::addData(const QByteArray &data)
+{
+  addData(data.constData(), data.size());
+}
+
+QByteArray FastHash::result() const
+{
+  quint64 h1 = h1_;
+  quint64 h2 = h2_;
+
+  // Mix in whatever is left over in the buffer
+  quint64 k1 = 0;
+  quint64 k2 = 0;
+
+  for (int i=buffer_length_-1;i>=8;i--) {
+    k2 ^= static_cast<quint64>(buffer_[i]) << ((i - 8) * 8);
+  }
+
+  if (buffer_length_ > 8) {
+    k2 *= kC2;
+    k2 = RotateLeft(k2, 33);
+    k2 *= kC1;
+    h2 ^= k2;
+  }
+
+  for (int i=qMin(buffer_length_, 8)-1;i>=0;i--) {
+    k1 ^= static_cast<quint64>(buffer_[i]) << (i * 8);
+  }
+
+  if (buffer_length_ > 0) {
+    k1 *= kC1;
+    k1 = RotateLeft(k1, 31);
+    k1 *= kC2;
+    h1 ^= k1;
+  }
+
+  // Finalize
+  h1 ^= total_length_;
+  h2 ^= total_length_;
+
+  h1 += h2;
+  h2 += h1;
+
+  h1 = FinalMix(h1);
+  h2 = FinalMix(h2);
+
+  h1 += h2;
+  h2 += h1;
+
+  QByteArray bytes;
+  bytes.resize(16);
+
+  qToLittleEndian(h1, reinterpret_cast<uchar*>(bytes.data()));
+  qToLittleEndian(h2, reinterpret_cast<uchar*>(bytes.data()) + 8);
+
+  return bytes;
+}
+
+QByteArray FastHash::hash(const QByteArray &data, quint64 seed)
+{
+  FastHash hasher(seed);
+  hasher.addData(data);
+  return hasher.result();
+}
+
+void FastHash::ProcessBlock(const uchar *block, quint64 *h1, quint64 *h2)
+{
+  quint64 k1 = qFromLittleEndian<quint64>(block);
+  quint64 k2 = qFromLittleEndian<quint64>(block + 8);
+
+  k1 *= kC1;
+  k1 = RotateLeft(k1, 31);
+  k1 *= kC2;
+  *h1 ^= k1;
+
+  *h1 = RotateLeft(*h1, 27);
+  *h1 += *h2;
+  *h1 = *h1 * 5 + 0x52dce729;
+
+  k2 *= kC2;
+  k2 = RotateLeft(k2, 33);
+  k2 *= kC1;
+  *h2 ^= k2;
+
+  *h2 = RotateLeft(*h2, 31);
+  *h2 += *h1;
+  *h2 = *h2 * 5 + 0x38495ab5;
+}
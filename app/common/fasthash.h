@@ -0,0 +1,69 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FASTHASH_H
+#define FASTHASH_H
+
+#include <QByteArray>
+
+/**
+ * @brief A fast, non-cryptographic 128-bit hash with an interface similar to QCryptographicHash
+ *
+ * This is a streaming implementation of MurmurHash3 (x64, 128-bit). It's intended for hashing node graphs where
+ * collisions only need to be improbable rather than impossible to engineer, and where SHA-1 is far slower than it
+ * needs to be.
+ */
+class FastHash
+{
+public:
+  FastHash(quint64 seed = 0);
+
+  void reset();
+
+  void addData(const char* data, int length);
+  void addData(const QByteArray& data);
+
+  /**
+   * @brief Return the 16-byte hash of everything added so far
+   *
+   * This doesn't modify the state, so more data can still be added afterwards.
+   */
+  QByteArray result() const;
+
+  static QByteArray hash(const QByteArray& data, quint64 seed = 0);
+
+private:
+  static void ProcessBlock(const uchar* block, quint64* h1, quint64* h2);
+
+  quint64 seed_;
+
+  quint64 h1_;
+
+  quint64 h2_;
+
+  uchar buffer_[16];
+
+  int buffer_length_;
+
+  quint64 total_length_;
+
+};
+
+#endif // FASTHASH_H
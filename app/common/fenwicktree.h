@@ -0,0 +1,163 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FENWICKTREE_H
+#define FENWICKTREE_H
+
+#include <QVector>
+
+/**
+ * @brief An array of values that can quickly return the sum of any prefix of it
+ *
+ * Also known as a binary indexed tree. Changing a value and summing a prefix are both O(log n), and building the tree
+ * from an existing array is O(n). UpperBound() and LowerBound() search the prefix sums in O(log n) too, but require
+ * every value to be non-negative (so the prefix sums are sorted).
+ *
+ * `T` must default-construct to zero and support `+`, `-` and `<`.
+ */
+template<typename T>
+class FenwickTree
+{
+public:
+  FenwickTree() = default;
+
+  /**
+   * @brief Replace the contents of the tree with `values`
+   */
+  void Build(const QVector<T>& values)
+  {
+    values_ = values;
+    tree_ = values;
+
+    int sz = tree_.size();
+
+    for (int i=1;i<=sz;i++) {
+      int parent = i + (i & -i);
+
+      if (parent <= sz) {
+        tree_[parent - 1] = tree_.at(parent - 1) + tree_.at(i - 1);
+      }
+    }
+  }
+
+  void Clear()
+  {
+    values_.clear();
+    tree_.clear();
+  }
+
+  int size() const
+  {
+    return values_.size();
+  }
+
+  const T& at(int index) const
+  {
+    return values_.at(index);
+  }
+
+  /**
+   * @brief Change the value at `index`
+   */
+  void Set(int index, const T& value)
+  {
+    T delta = value - values_.at(index);
+
+    values_[index] = value;
+
+    for (int i=index+1;i<=tree_.size();i+=(i & -i)) {
+      tree_[i - 1] = tree_.at(i - 1) + delta;
+    }
+  }
+
+  /**
+   * @brief Return the sum of the first `count` values
+   */
+  T PrefixSum(int count) const
+  {
+    T sum = T();
+
+    for (int i=count;i>0;i-=(i & -i)) {
+      sum = sum + tree_.at(i - 1);
+    }
+
+    return sum;
+  }
+
+  /**
+   * @brief Return the sum of all values
+   */
+  T Total() const
+  {
+    return PrefixSum(tree_.size());
+  }
+
+  /**
+   * @brief Return how many of the (non-empty) prefix sums are less than or equal to `value`
+   */
+  int UpperBound(const T& value) const
+  {
+    return Descend(value, true);
+  }
+
+  /**
+   * @brief Return how many of the (non-empty) prefix sums are less than `value`
+   */
+  int LowerBound(const T& value) const
+  {
+    return Descend(value, false);
+  }
+
+private:
+  int Descend(const T& value, bool inclusive) const
+  {
+    int sz = tree_.size();
+
+    int step = 1;
+    while (step * 2 <= sz) {
+      step *= 2;
+    }
+
+    int count = 0;
+    T sum = T();
+
+    for (;step>0;step/=2) {
+      int next = count + step;
+
+      if (next <= sz) {
+        T next_sum = sum + tree_.at(next - 1);
+
+        if (inclusive ? !(value < next_sum) : (next_sum < value)) {
+          count = next;
+          sum = next_sum;
+        }
+      }
+    }
+
+    return count;
+  }
+
+  QVector<T> values_;
+
+  QVector<T> tree_;
+
+};
+
+#endif // FENWICKTREE_H
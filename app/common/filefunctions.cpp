@@ -73,3 +73,15 @@ QString GetMediaCacheLocation()
 
   return media_cache_dir.absolutePath();
 }
+
+QString GetShaderCacheLocation()
+{
+  QDir local_appdata_dir(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation));
+
+  QDir shader_cache_dir = local_appdata_dir.filePath("shadercache");
+
+  // Attempt to ensure this folder exists
+  shader_cache_dir.mkpath(".");
+
+  return shader_cache_dir.absolutePath();
+}
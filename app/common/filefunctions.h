@@ -31,4 +31,6 @@ QString GetMediaIndexFilename(const QString& filename);
 
 QString GetMediaCacheLocation();
 
+QString GetShaderCacheLocation();
+
 #endif // FILEFUNCTIONS_H
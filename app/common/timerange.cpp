@@ -0,0 +1,89 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "timerange.h"
+
+TimeRange::TimeRange()
+{
+}
+
+TimeRange::TimeRange(const rational &in, const rational &out) :
+  in_(qMin(in, out)),
+  out_(qMax(in, out))
+{
+}
+
+const rational &TimeRange::in() const
+{
+  return in_;
+}
+
+const rational &TimeRange::out() const
+{
+  return out_;
+}
+
+bool TimeRange::OverlapsWith(const TimeRange &other) const
+{
+  return in_ <= other.out_ && other.in_ <= out_;
+}
+
+TimeRange TimeRange::CombineWith(const TimeRange &other) const
+{
+  return TimeRange(qMin(in_, other.in_), qMax(out_, other.out_));
+}
+
+TimeRangeList::TimeRangeList()
+{
+}
+
+void TimeRangeList::InsertTimeRange(const TimeRange &range)
+{
+  TimeRange merged = range;
+
+  // Find where this range belongs, absorbing any ranges it overlaps along the way
+  int i = 0;
+
+  while (i < ranges_.size() && ranges_.at(i).out() < merged.in()) {
+    i++;
+  }
+
+  while (i < ranges_.size() && ranges_.at(i).OverlapsWith(merged)) {
+    merged = merged.CombineWith(ranges_.at(i));
+    ranges_.remove(i);
+  }
+
+  ranges_.insert(i, merged);
+}
+
+bool TimeRangeList::isEmpty() const
+{
+  return ranges_.isEmpty();
+}
+
+void TimeRangeList::clear()
+{
+  ranges_.clear();
+}
+
+const QVector<TimeRange> &TimeRangeList::ranges() const
+{
+  return ranges_;
+}
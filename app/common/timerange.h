@@ -0,0 +1,82 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef TIMERANGE_H
+#define TIMERANGE_H
+
+#include <QVector>
+
+#include "rational.h"
+
+/**
+ * @brief A range of time from `in` to `out` (inclusive)
+ */
+class TimeRange
+{
+public:
+  TimeRange();
+  TimeRange(const rational& in, const rational& out);
+
+  const rational& in() const;
+  const rational& out() const;
+
+  /**
+   * @brief Return whether this range and another share any time (or touch at either end)
+   */
+  bool OverlapsWith(const TimeRange& other) const;
+
+  /**
+   * @brief Return the smallest range that contains both this range and another
+   */
+  TimeRange CombineWith(const TimeRange& other) const;
+
+private:
+  rational in_;
+
+  rational out_;
+};
+
+/**
+ * @brief A set of time ranges that merges overlapping ranges as they're added
+ *
+ * Ranges are kept sorted and never overlap, so however many ranges are added, iterating the list only visits each
+ * moment in time once.
+ */
+class TimeRangeList
+{
+public:
+  TimeRangeList();
+
+  /**
+   * @brief Add a range, merging it with any ranges it overlaps
+   */
+  void InsertTimeRange(const TimeRange& range);
+
+  bool isEmpty() const;
+
+  void clear();
+
+  const QVector<TimeRange>& ranges() const;
+
+private:
+  QVector<TimeRange> ranges_;
+};
+
+#endif // TIMERANGE_H
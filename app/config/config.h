@@ -22,6 +22,7 @@
 #define CONFIG_H
 
 #include "common/timecodefunctions.h"
+#include "render/cachecodec.h"
 
 /**
  * @brief Temporary variables that will definitely be configurable but aren't yet
@@ -31,4 +32,41 @@ const olive::TimecodeDisplay kTimecodeDisplay = olive::kTimecodeFrames;
 
 const rational kDefaultImageLength = 2;
 
+const olive::CacheCodec kCacheCodec = olive::kCacheCodecDwaa;
+
+/**
+ * @brief Number of threads compressing cached frames (0 uses QThread::idealThreadCount())
+ */
+const int kCacheEncoderThreads = 0;
+
+/**
+ * @brief Maximum number of frames waiting at each stage of the cache pipeline
+ */
+const int kCacheQueueSize = 8;
+
+/**
+ * @brief Size of each file in the render cache's frame store
+ */
+const qint64 kFrameStoreSegmentSize = Q_INT64_C(256) * 1024 * 1024;
+
+/**
+ * @brief Maximum disk space the render cache's frame store may use before old frames are evicted
+ */
+const qint64 kFrameStoreQuota = Q_INT64_C(20) * 1024 * 1024 * 1024;
+
+/**
+ * @brief Maximum memory each Renderer may use to hold decoded cache frames
+ */
+const qint64 kFrameMemoryCacheBudget = Q_INT64_C(2) * 1024 * 1024 * 1024;
+
+/**
+ * @brief Number of threads loading cached frames for each Renderer
+ */
+const int kCacheLoaderThreads = 2;
+
+/**
+ * @brief Number of frames ahead of the playhead that are loaded in advance
+ */
+const int kCacheLoaderPrefetch = 8;
+
 #endif // CONFIG_H
@@ -33,6 +33,7 @@
 #include "panel/project/project.h"
 #include "project/item/footage/footage.h"
 #include "project/item/sequence/sequence.h"
+#include "render/cachecodec.h"
 #include "render/colorservice.h"
 #include "task/import/import.h"
 #include "task/taskmanager.h"
@@ -71,6 +72,10 @@ void Core::Start()
   QCommandLineOption fullscreen_option({"f", "fullscreen"}, tr("Start in full screen mode"));
   parser.addOption(fullscreen_option);
 
+  // Create cache codec benchmark option
+  QCommandLineOption benchmark_cache_option("benchmark-cache", tr("Benchmark the render cache codecs on startup"));
+  parser.addOption(benchmark_cache_option);
+
   // Parse options
   parser.process(*app);
 
@@ -84,6 +89,10 @@ void Core::Start()
   // Declare custom types for Qt signal/slot syste
   DeclareTypesForQt();
 
+  if (parser.isSet(benchmark_cache_option)) {
+    BenchmarkCacheCodecs();
+  }
+
 
   //
   // Start GUI (FIXME CLI mode)
@@ -96,6 +105,26 @@ void Core::Start()
   AddOpenProject(std::make_shared<Project>());
 }
 
+void Core::BenchmarkCacheCodecs()
+{
+  // FIXME: Hardcoded values, should match the renderer's default parameters
+  const int width = 1920;
+  const int height = 1080;
+  const olive::PixelFormat format = olive::PIX_FMT_RGBA16F;
+
+  qInfo() << "Benchmarking cache codecs at" << width << "x" << height;
+
+  QList<CacheCodecBenchmark> results = CacheCodecService::Benchmark(width, height, format, 5);
+
+  foreach (const CacheCodecBenchmark& result, results) {
+    qInfo().noquote() << QString("%1: encode %2 ms, decode %3 ms, %4 bytes per frame")
+                         .arg(CacheCodecService::GetName(result.codec),
+                              QString::number(result.encode_ms, 'f', 2),
+                              QString::number(result.decode_ms, 'f', 2),
+                              QString::number(result.bytes));
+  }
+}
+
 void Core::Stop()
 {
   delete main_window_;
@@ -285,8 +314,6 @@ void Core::CreateNewSequence()
                       olive::RenderMode::kOffline,
                       2);
 
-    // Set the "cache name" only here to aid the cache ID's uniqueness
-    rp->SetCacheName(new_sequence->name());
     rp->SetTimebase(new_sequence->video_time_base());
 
     new_sequence->AddNode(rp);
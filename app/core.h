@@ -171,6 +171,11 @@ private:
    */
   void StartGUI(bool full_screen);
 
+  /**
+   * @brief Encode and decode a test frame with each cache codec and print the timings and sizes
+   */
+  void BenchmarkCacheCodecs();
+
   /**
    * @brief Get the currently active project
    *
@@ -49,7 +49,7 @@ void AlphaOverBlend::Release()
 {
 }
 
-QVariant AlphaOverBlend::Value(NodeOutput *param, const rational &time)
+NodeValue AlphaOverBlend::Value(NodeOutput *param, const rational &time)
 {
   // Find the current Renderer instance
   RenderInstance* renderer = RendererProcessor::CurrentInstance();
@@ -67,9 +67,9 @@ QVariant AlphaOverBlend::Value(NodeOutput *param, const rational &time)
     if (base == nullptr && blend == nullptr) {
       return 0;
     } else if (base == nullptr) {
-      return QVariant::fromValue(blend);
+      return NodeValue(blend);
     } else if (blend == nullptr) {
-      return QVariant::fromValue(base);
+      return NodeValue(base);
     }
 
     // Attach framebuffer to the backbuffer of base
@@ -92,7 +92,7 @@ QVariant AlphaOverBlend::Value(NodeOutput *param, const rational &time)
 
     // Return base texture which now has blend composited on top
     // NOTE: Blend texture will be implicitly deleted here (if it's not used anywhere else)
-    return QVariant::fromValue(base);
+    return NodeValue(base);
   }
 
   return 0;
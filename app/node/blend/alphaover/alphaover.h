@@ -36,7 +36,7 @@ public:
   virtual void Release() override;
 
 protected:
-  virtual QVariant Value(NodeOutput* param, const rational& time) override;
+  virtual NodeValue Value(NodeOutput* param, const rational& time) override;
 
 private:
 };
@@ -0,0 +1,285 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "compositor.h"
+
+#include "node/processor/renderer/renderer.h"
+#include "render/gl/functions.h"
+#include "render/gl/shadergenerators.h"
+#include "render/rendertexture.h"
+
+/**
+ * @brief Upper limit of layers read in one pass, regardless of how many texture units the GPU has
+ */
+const int kMaxLayersPerPass = 16;
+
+CompositorNode::CompositorNode()
+{
+  texture_output_ = new NodeOutput("tex_out");
+  texture_output_->set_data_type(NodeParam::kTexture);
+  AddParameter(texture_output_);
+
+  // Start with a base and a blend layer, like the other blending nodes
+  AddLayer();
+  AddLayer();
+}
+
+QString CompositorNode::Name()
+{
+  return tr("Compositor");
+}
+
+QString CompositorNode::id()
+{
+  return "org.olivevideoeditor.Olive.compositor";
+}
+
+QString CompositorNode::Category()
+{
+  return tr("Blend");
+}
+
+QString CompositorNode::Description()
+{
+  return tr("Composite any number of layers over each other in a single pass.");
+}
+
+void CompositorNode::Release()
+{
+  QMutexLocker locker(&pipeline_lock_);
+
+  pipelines_.clear();
+}
+
+void CompositorNode::Retranslate()
+{
+  for (int i=0;i<layers_.size();i++) {
+    layers_.at(i).texture->set_name(tr("Layer %1").arg(i + 1));
+    layers_.at(i).opacity->set_name(tr("Layer %1 Opacity").arg(i + 1));
+    layers_.at(i).blend_mode->set_name(tr("Layer %1 Blend Mode").arg(i + 1));
+  }
+}
+
+int CompositorNode::AddLayer()
+{
+  int index = layers_.size();
+
+  Layer layer;
+
+  layer.texture = new NodeInput(QString("layer%1_tex_in").arg(index));
+  layer.texture->add_data_input(NodeParam::kTexture);
+  AddParameter(layer.texture);
+
+  layer.opacity = new NodeInput(QString("layer%1_opacity_in").arg(index));
+  layer.opacity->add_data_input(NodeParam::kFloat);
+  layer.opacity->set_value(100);
+  layer.opacity->set_minimum(0);
+  layer.opacity->set_maximum(100);
+  AddParameter(layer.opacity);
+
+  layer.blend_mode = new NodeInput(QString("layer%1_mode_in").arg(index));
+  layer.blend_mode->add_data_input(NodeParam::kInt);
+  layer.blend_mode->set_value(kNormal);
+  layer.blend_mode->set_minimum(kNormal);
+  layer.blend_mode->set_maximum(kScreen);
+  AddParameter(layer.blend_mode);
+
+  layers_.append(layer);
+
+  Retranslate();
+
+  return index;
+}
+
+int CompositorNode::layer_count()
+{
+  return layers_.size();
+}
+
+bool CompositorNode::GetInputTime(NodeOutput *output, NodeInput *input, const rational &time, rational *input_time)
+{
+  // Same as Value(), the textures of invisible layers aren't used
+  foreach (const Layer& layer, layers_) {
+    if (layer.texture == input) {
+      if (layer.opacity->get_value(time).toFloat() <= 0.0f) {
+        return false;
+      }
+
+      break;
+    }
+  }
+
+  return Node::GetInputTime(output, input, time, input_time);
+}
+
+NodeInput *CompositorNode::layer_texture_input(int layer)
+{
+  return layers_.at(layer).texture;
+}
+
+NodeInput *CompositorNode::layer_opacity_input(int layer)
+{
+  return layers_.at(layer).opacity;
+}
+
+NodeInput *CompositorNode::layer_blend_mode_input(int layer)
+{
+  return layers_.at(layer).blend_mode;
+}
+
+NodeOutput *CompositorNode::texture_output()
+{
+  return texture_output_;
+}
+
+NodeValue CompositorNode::Value(NodeOutput *output, const rational &time)
+{
+  // Find the current Renderer instance
+  RenderInstance* renderer = RendererProcessor::CurrentInstance();
+
+  // If nothing is available, don't return a texture
+  if (renderer == nullptr || output != texture_output_) {
+    return 0;
+  }
+
+  // Collect the layers that will actually be visible
+  QVector<RenderTexturePtr> textures;
+  QVector<float> opacities;
+  QVector<int> modes;
+
+  foreach (const Layer& layer, layers_) {
+    float opacity = layer.opacity->get_value(time).toFloat() * 0.01f;
+
+    if (opacity <= 0.0f) {
+      continue;
+    }
+
+    RenderTexturePtr tex = layer.texture->get_value(time).value<RenderTexturePtr>();
+
+    if (tex == nullptr) {
+      continue;
+    }
+
+    textures.append(tex);
+    opacities.append(opacity);
+    modes.append(layer.blend_mode->get_value(time).toInt());
+  }
+
+  if (textures.isEmpty()) {
+    return 0;
+  }
+
+  // A single opaque layer over nothing is just that layer (every blend mode is the identity over transparent black)
+  if (textures.size() == 1 && opacities.first() >= 1.0f) {
+    return NodeValue(textures.first());
+  }
+
+  QOpenGLContext* ctx = renderer->context();
+  QOpenGLFunctions* f = ctx->functions();
+
+  GLint max_units;
+  f->glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &max_units);
+  int layers_per_pass = qMin(static_cast<int>(max_units), kMaxLayersPerPass);
+
+  RenderTexturePtr output_texture = renderer->image_cache()->Get(ctx,
+                                                                 renderer->width(),
+                                                                 renderer->height(),
+                                                                 renderer->format(),
+                                                                 RenderTexture::kDoubleBuffer);
+
+  // The shader does all the blending
+  f->glBlendFunc(GL_ONE, GL_ZERO);
+
+  int layer = 0;
+  bool first_pass = true;
+
+  while (layer < textures.size()) {
+    // After the first pass, the result so far is read back in as the bottom layer
+    int pass_layers = qMin(textures.size() - layer + (first_pass ? 0 : 1), layers_per_pass);
+
+    ShaderPtr pipeline = GetPipeline(ctx, pass_layers);
+
+    pipeline->bind();
+
+    int unit = 0;
+
+    if (!first_pass) {
+      f->glActiveTexture(GL_TEXTURE0);
+      output_texture->Bind();
+
+      pipeline->setUniformValue("opacity0", 1.0f);
+      pipeline->setUniformValue("mode0", static_cast<int>(kNormal));
+
+      unit++;
+    }
+
+    for (;unit<pass_layers;unit++) {
+      f->glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(unit));
+      textures.at(layer)->Bind();
+
+      pipeline->setUniformValue(QString("opacity%1").arg(unit).toUtf8().constData(), opacities.at(layer));
+      pipeline->setUniformValue(QString("mode%1").arg(unit).toUtf8().constData(), modes.at(layer));
+
+      layer++;
+    }
+
+    pipeline->release();
+
+    f->glActiveTexture(GL_TEXTURE0);
+
+    // Draw into the back buffer, then swap so the result is in front
+    renderer->buffer()->AttachBackBuffer(output_texture);
+    renderer->buffer()->Bind();
+
+    olive::gl::Blit(pipeline);
+
+    renderer->buffer()->Release();
+    renderer->buffer()->Detach();
+
+    // Unbind every unit used
+    for (int i=pass_layers-1;i>=0;i--) {
+      f->glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(i));
+      f->glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    output_texture->SwapFrontAndBack();
+
+    first_pass = false;
+  }
+
+  return NodeValue(output_texture);
+}
+
+ShaderPtr CompositorNode::GetPipeline(QOpenGLContext *ctx, int layers)
+{
+  QMutexLocker locker(&pipeline_lock_);
+
+  QMap<int, ShaderPtr>& context_pipelines = pipelines_[ctx];
+
+  ShaderPtr pipeline = context_pipelines.value(layers);
+
+  if (pipeline == nullptr) {
+    pipeline = olive::ShaderGenerator::CompositorPipeline(layers);
+
+    context_pipelines.insert(layers, pipeline);
+  }
+
+  return pipeline;
+}
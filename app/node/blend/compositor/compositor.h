@@ -0,0 +1,111 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef COMPOSITORNODE_H
+#define COMPOSITORNODE_H
+
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QOpenGLContext>
+
+#include "node/node.h"
+#include "render/gl/shaderptr.h"
+
+/**
+ * @brief A Node that composites any number of layers over each other
+ *
+ * Each layer has a texture, an opacity and a blend mode. Unlike chaining BlendNodes, which takes one render pass per
+ * layer, every layer is read in the same pass by a shader with one sampler per layer (split into several passes only
+ * if there are more layers than the GPU has texture units). Layers with no texture or zero opacity are skipped without
+ * drawing anything.
+ *
+ * Layer 0 is the bottom layer.
+ */
+class CompositorNode : public Node
+{
+  Q_OBJECT
+public:
+  CompositorNode();
+
+  enum BlendMode {
+    kNormal,
+    kAdd,
+    kMultiply,
+    kScreen
+  };
+
+  virtual QString Name() override;
+  virtual QString id() override;
+  virtual QString Category() override;
+  virtual QString Description() override;
+
+  virtual void Release() override;
+
+  virtual void Retranslate() override;
+
+  virtual bool GetInputTime(NodeOutput* output, NodeInput* input, const rational& time, rational* input_time) override;
+
+  /**
+   * @brief Add a layer on top of the existing ones and return its index
+   */
+  int AddLayer();
+
+  int layer_count();
+
+  NodeInput* layer_texture_input(int layer);
+
+  NodeInput* layer_opacity_input(int layer);
+
+  NodeInput* layer_blend_mode_input(int layer);
+
+  NodeOutput* texture_output();
+
+protected:
+  virtual NodeValue Value(NodeOutput* output, const rational& time) override;
+
+private:
+  struct Layer {
+    NodeInput* texture;
+    NodeInput* opacity;
+    NodeInput* blend_mode;
+  };
+
+  /**
+   * @brief Return a pipeline compositing `layers` textures, compiled for the current context
+   */
+  ShaderPtr GetPipeline(QOpenGLContext* ctx, int layers);
+
+  QVector<Layer> layers_;
+
+  NodeOutput* texture_output_;
+
+  /**
+   * @brief Compiled pipelines per context, by number of layers
+   *
+   * Several renderer threads can use this Node at once, each with its own context.
+   */
+  QHash<QOpenGLContext*, QMap<int, ShaderPtr> > pipelines_;
+
+  QMutex pipeline_lock_;
+
+};
+
+#endif // COMPOSITORNODE_H
@@ -22,8 +22,11 @@
 
 #include <QDebug>
 
+#include "node/output/track/track.h"
+
 Block::Block() :
-  next_(nullptr)
+  next_(nullptr),
+  track_(nullptr)
 {
   previous_input_ = new NodeInput("prev_block");
   previous_input_->add_data_input(NodeParam::kBlock);
@@ -32,6 +35,9 @@ Block::Block() :
 
   block_output_ = new NodeOutput("block_out");
   block_output_->set_data_type(NodeParam::kBlock);
+
+  // Only a pointer to this Block, it's cheaper to return it than to cache it
+  block_output_->SetValueCachingEnabled(false);
   AddParameter(block_output_);
 
   texture_output_ = new NodeOutput("tex_out");
@@ -47,19 +53,42 @@ QString Block::Category()
   return tr("Block");
 }
 
-const rational &Block::in()
+rational Block::in()
 {
-  return in_point_;
+  TrackOutput* track = track_.load();
+
+  if (track != nullptr) {
+    return track->GetBlockInPoint(this);
+  }
+
+  // Not attached to a track, add up the lengths of every Block before this one
+  rational in_point;
+
+  Block* prev = previous();
+  while (prev != nullptr) {
+    in_point += prev->length();
+
+    prev = prev->previous();
+  }
+
+  return in_point;
 }
 
-const rational &Block::out()
+rational Block::out()
 {
-  return out_point_;
+  return in() + length();
 }
 
-const rational& Block::length()
+rational Block::length()
 {
-  return length_;
+  // Render threads read this while the main thread may be changing it
+  Lock();
+
+  rational length = length_;
+
+  Unlock();
+
+  return length;
 }
 
 void Block::set_length(const rational &length)
@@ -70,7 +99,18 @@ void Block::set_length(const rational &length)
 
   Unlock();
 
-  Refresh();
+  BumpEditVersion();
+
+  // Memoized hashes were worked out for the old out point
+  ClearHashCache(RATIONAL_MIN, RATIONAL_MAX);
+
+  TrackOutput* track = track_.load();
+
+  if (track != nullptr) {
+    track->BlockLengthChanged(this);
+  } else {
+    emit Refreshed();
+  }
 }
 
 Block *Block::previous()
@@ -83,12 +123,30 @@ Block *Block::next()
   return next_;
 }
 
+TrackOutput *Block::track()
+{
+  return track_.load();
+}
+
+void Block::set_track(TrackOutput *track)
+{
+  track_.store(track);
+}
+
 NodeInput *Block::previous_input()
 {
   return previous_input_;
 }
 
-QVariant Block::Value(NodeOutput *output, const rational &time)
+bool Block::AnalyzeTimeInvariance(NodeOutput *output)
+{
+  Q_UNUSED(output)
+
+  // Blocks place their content at specific times, so they're never the same at every time
+  return false;
+}
+
+NodeValue Block::Value(NodeOutput *output, const rational &time)
 {
   Q_UNUSED(time)
 
@@ -124,21 +182,19 @@ void Block::EdgeRemovedSlot(NodeEdgePtr edge)
 }
 
 void Block::Refresh()
-{  
-  // Set in point to the out point of the previous Node
-  if (previous() != nullptr) {
-    in_point_ = previous()->out();
-  } else {
-    in_point_ = 0;
-  }
-
-  // Update out point by adding this clip's length to the just calculated in point
-  out_point_ = in_point_ + length();
+{
+  // Find the track at the end of this chain of Blocks (without recursing, tracks can be very long)
+  Block* end = this;
 
-  emit Refreshed();
+  while (end->track() == nullptr && end->next() != nullptr) {
+    end = end->next();
+  }
 
-  if (next() != nullptr) {
-    next()->Refresh();
+  if (end->track() != nullptr) {
+    end->track()->Refresh();
+  } else {
+    // Not part of a track, nothing else needs to know
+    emit Refreshed();
   }
 }
 
@@ -162,16 +218,32 @@ void Block::DisconnectBlocks(Block *previous, Block *next)
   NodeParam::DisconnectEdge(previous->block_output(), next->previous_input());
 }
 
-const rational &Block::media_in()
+rational Block::media_in()
 {
-  return media_in_;
+  // Render threads read this while the main thread may be changing it
+  Lock();
+
+  rational media_in = media_in_;
+
+  Unlock();
+
+  return media_in;
 }
 
 void Block::set_media_in(const rational &media_in)
 {
-  if (media_in_ != media_in) {
+  if (this->media_in() != media_in) {
+    Lock();
+
     media_in_ = media_in;
 
+    Unlock();
+
+    BumpEditVersion();
+
+    // Memoized hashes were worked out for the old media times
+    ClearHashCache(RATIONAL_MIN, RATIONAL_MAX);
+
     // Signal that this clips contents have changed
     SendInvalidateCache(in(), out());
   }
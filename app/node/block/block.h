@@ -21,8 +21,12 @@
 #ifndef BLOCK_H
 #define BLOCK_H
 
+#include <QAtomicPointer>
+
 #include "node/node.h"
 
+class TrackOutput;
+
 /**
  * @brief A Node that represents a block of time, also displayable on a Timeline
  *
@@ -47,15 +51,42 @@ public:
 
   virtual QString Category() override;
 
-  const rational& in();
-  const rational& out();
+  /**
+   * @brief Return the time this Block starts in the sequence
+   *
+   * If this Block is attached to a track, it's looked up from the track in O(log n). Otherwise it's calculated by
+   * adding up the lengths of every Block before this one.
+   */
+  rational in();
+
+  /**
+   * @brief Return the time this Block ends in the sequence (in() + length())
+   */
+  rational out();
 
-  virtual const rational &length();
+  /**
+   * @brief Return the length of this Block
+   *
+   * This function is thread-safe.
+   */
+  virtual rational length();
   virtual void set_length(const rational &length);
 
   Block* previous();
   Block* next();
 
+  /**
+   * @brief Return the TrackOutput this Block is attached to, or nullptr if it isn't attached to one
+   */
+  TrackOutput* track();
+
+  /**
+   * @brief Set the TrackOutput this Block is attached to
+   *
+   * This is set by TrackOutput itself when Blocks are attached to or detached from it.
+   */
+  void set_track(TrackOutput* track);
+
   NodeInput* previous_input();
 
   NodeOutput* texture_output();
@@ -64,22 +95,21 @@ public:
   static void ConnectBlocks(Block* previous, Block* next);
   static void DisconnectBlocks(Block* previous, Block* next);
 
-  const rational& media_in();
+  /**
+   * @brief Return the media time this Block starts playing from
+   *
+   * This function is thread-safe.
+   */
+  rational media_in();
   void set_media_in(const rational& media_in);
 
 public slots:
   /**
-   * @brief Refreshes internal cache of in/out points up to date
+   * @brief Signals that the Blocks surrounding this one have changed
    *
-   * A block can only know truly know its in point by adding all the lengths of the clips before it. Since this can
-   * become timeconsuming, blocks cache their in and out points for easy access, however this does mean their caches
-   * need to stay up to date to provide accurate results. Whenever this or any surrounding Block is changed, it's
-   * recommended to call Refresh().
-   *
-   * This function specifically sets the in point to the out point of the previous clip and sets its out point to the
-   * in point + this block's length. Therefore, before calling Refresh() on a Block, it's necessary that all the
-   * Blocks before it are accurate and up to date. You may need to traverse through the Block list (using previous())
-   * and run Refresh() on all Blocks sequentially.
+   * Blocks don't store their own in/out points, the TrackOutput at the end of the chain keeps the lengths of all of
+   * its Blocks and calculates them on request. This function finds that TrackOutput (if any) and has it pick up the
+   * change, which also emits Refreshed() for every Block whose in/out points moved.
    */
   virtual void Refresh();
 
@@ -87,12 +117,15 @@ signals:
   /**
    * @brief Signal emitted when this Block is refreshed
    *
-   * Can be used as essentially a "changed" signal for UI widgets to know when to update their views
+   * Can be used as essentially a "changed" signal for UI widgets to know when to update their views. If several Blocks
+   * are edited at once, this is only emitted once for each Block once the whole edit is done.
    */
   void Refreshed();
 
 protected:
-  virtual QVariant Value(NodeOutput* output, const rational& time) override;
+  virtual bool AnalyzeTimeInvariance(NodeOutput* output) override;
+
+  virtual NodeValue Value(NodeOutput* output, const rational& time) override;
 
   rational SequenceToMediaTime(const rational& sequence_time);
 
@@ -104,15 +137,19 @@ private:
 
   NodeOutput* texture_output_;
 
-  rational in_point_;
-  rational out_point_;
-
   rational length_;
 
   rational media_in_;
 
   Block* next_;
 
+  /**
+   * @brief The TrackOutput this Block is attached to
+   *
+   * Atomic since render threads use it to look up in() while the main thread attaches and detaches Blocks.
+   */
+  QAtomicPointer<TrackOutput> track_;
+
 private slots:
   void EdgeAddedSlot(NodeEdgePtr edge);
 
@@ -67,7 +67,7 @@ NodeInput *ClipBlock::texture_input()
   return texture_input_;
 }
 
-QVariant ClipBlock::Value(NodeOutput* param, const rational& time)
+NodeValue ClipBlock::Value(NodeOutput* param, const rational& time)
 {
   if (param == texture_output()) {
     // If the time retrieved is within this block, get texture information
@@ -102,6 +102,22 @@ void ClipBlock::InvalidateCache(const rational &start_range, const rational &end
   }
 }
 
+bool ClipBlock::GetInputTime(NodeOutput *output, NodeInput *input, const rational &time, rational *input_time)
+{
+  if (output == texture_output() && input == texture_input_) {
+    // Same as Value(), the texture is only used within this Block and at media time
+    if (time < in() || time >= out()) {
+      return false;
+    }
+
+    *input_time = SequenceToMediaTime(time);
+
+    return true;
+  }
+
+  return Block::GetInputTime(output, input, time, input_time);
+}
+
 QList<NodeDependency> ClipBlock::RunDependencies(NodeOutput *output, const rational &time)
 {
   QList<NodeDependency> deps;
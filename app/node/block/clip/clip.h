@@ -46,8 +46,10 @@ public:
 
   virtual QList<NodeDependency> RunDependencies(NodeOutput *output, const rational &time) override;
 
+  virtual bool GetInputTime(NodeOutput* output, NodeInput* input, const rational& time, rational* input_time) override;
+
 protected:
-  virtual QVariant Value(NodeOutput* output, const rational& time) override;
+  virtual NodeValue Value(NodeOutput* output, const rational& time) override;
 
 private:
   NodeInput* texture_input_;
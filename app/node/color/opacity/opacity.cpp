@@ -62,7 +62,7 @@ QString OpacityNode::id()
   return "org.olivevideoeditor.Olive.opacity";
 }
 
-QVariant OpacityNode::Value(NodeOutput *output, const rational &time)
+NodeValue OpacityNode::Value(NodeOutput *output, const rational &time)
 {
   // Find the current Renderer instance
   RenderInstance* renderer = RendererProcessor::CurrentInstance();
@@ -108,7 +108,7 @@ QVariant OpacityNode::Value(NodeOutput *output, const rational &time)
 
     input_tex->SwapFrontAndBack();
 
-    return QVariant::fromValue(input_tex);
+    return NodeValue(input_tex);
   }
 
   return 0;
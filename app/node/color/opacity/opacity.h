@@ -36,7 +36,7 @@ public:
 
   virtual QString id() override;
 
-  virtual QVariant Value(NodeOutput *output, const rational &time) override;
+  virtual NodeValue Value(NodeOutput *output, const rational &time) override;
 
   virtual void Retranslate() override;
 
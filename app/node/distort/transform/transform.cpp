@@ -80,7 +80,7 @@ void TransformDistort::Retranslate()
   anchor_input_->set_name(tr("Anchor Point"));
 }
 
-QVariant TransformDistort::Value(NodeOutput *output, const rational &time)
+NodeValue TransformDistort::Value(NodeOutput *output, const rational &time)
 {
   if (output == matrix_output_) {
     QMatrix4x4 mat;
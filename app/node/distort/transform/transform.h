@@ -39,7 +39,7 @@ public:
   virtual void Retranslate() override;
 
 protected:
-  virtual QVariant Value(NodeOutput *output, const rational &time) override;
+  virtual NodeValue Value(NodeOutput *output, const rational &time) override;
 
 private:
   NodeInput* position_input_;
@@ -57,7 +57,7 @@ NodeOutput *SolidGenerator::texture_output()
   return texture_output_;
 }
 
-QVariant SolidGenerator::Value(NodeOutput *output, const rational &time)
+NodeValue SolidGenerator::Value(NodeOutput *output, const rational &time)
 {
   Q_UNUSED(output)
   Q_UNUSED(time)
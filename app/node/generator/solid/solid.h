@@ -42,7 +42,7 @@ public:
   NodeOutput* texture_output();
 
 protected:
-  virtual QVariant Value(NodeOutput* output, const rational& time) override;
+  virtual NodeValue Value(NodeOutput* output, const rational& time) override;
 
 private:
   NodeInput* color_input_;
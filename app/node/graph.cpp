@@ -20,9 +20,13 @@
 
 #include "graph.h"
 
-#include "common/qobjectlistcast.h"
+#include <algorithm>
+#include <QDebug>
 
-NodeGraph::NodeGraph()
+NodeGraph::NodeGraph() :
+  next_order_index_(0),
+  order_valid_(true),
+  edge_version_(0)
 {
 
 }
@@ -35,8 +39,14 @@ void NodeGraph::AddNode(Node *node)
 
   node->setParent(this);
 
+  node_list_.append(node);
+  IndexNode(node);
+
   connect(node, SIGNAL(EdgeAdded(NodeEdgePtr)), this, SIGNAL(EdgeAdded(NodeEdgePtr)));
   connect(node, SIGNAL(EdgeRemoved(NodeEdgePtr)), this, SIGNAL(EdgeRemoved(NodeEdgePtr)));
+  connect(node, SIGNAL(EdgeAdded(NodeEdgePtr)), this, SLOT(IndexEdgeAdded(NodeEdgePtr)));
+  connect(node, SIGNAL(EdgeRemoved(NodeEdgePtr)), this, SLOT(IndexEdgeRemoved(NodeEdgePtr)));
+  connect(node, SIGNAL(destroyed(QObject*)), this, SLOT(NodeDestroyed(QObject*)));
 
   emit NodeAdded(node);
 }
@@ -46,10 +56,19 @@ void NodeGraph::AddNodeWithDependencies(Node *node)
   // Add node and its connected nodes to graph
   AddNode(node);
 
-  // Add all of Block's dependencies
-  QList<Node*> node_dependencies = node->GetDependencies();
-  foreach (Node* dep, node_dependencies) {
+  // Walk through the dependencies, stopping at any that were already in the graph
+  QList<Node*> stack = node->GetImmediateDependencies();
+
+  while (!stack.isEmpty()) {
+    Node* dep = stack.takeLast();
+
+    if (ContainsNode(dep)) {
+      continue;
+    }
+
     AddNode(dep);
+
+    stack.append(dep->GetImmediateDependencies());
   }
 }
 
@@ -61,8 +80,14 @@ void NodeGraph::TakeNode(Node *node, QObject* new_parent)
 
   node->setParent(new_parent);
 
+  node_list_.removeOne(node);
+  UnindexNode(node);
+
   disconnect(node, SIGNAL(EdgeAdded(NodeEdgePtr)), this, SIGNAL(EdgeAdded(NodeEdgePtr)));
   disconnect(node, SIGNAL(EdgeRemoved(NodeEdgePtr)), this, SIGNAL(EdgeRemoved(NodeEdgePtr)));
+  disconnect(node, SIGNAL(EdgeAdded(NodeEdgePtr)), this, SLOT(IndexEdgeAdded(NodeEdgePtr)));
+  disconnect(node, SIGNAL(EdgeRemoved(NodeEdgePtr)), this, SLOT(IndexEdgeRemoved(NodeEdgePtr)));
+  disconnect(node, SIGNAL(destroyed(QObject*)), this, SLOT(NodeDestroyed(QObject*)));
 
   emit NodeRemoved(node);
 }
@@ -73,7 +98,7 @@ QList<Node *> NodeGraph::TakeNodeWithItsDependencies(Node *node, QObject *new_pa
     return QList<Node*>();
   }
 
-  QList<Node*> deps = node->GetExclusiveDependencies();
+  QList<Node*> deps = GetExclusiveUpstream(node);
 
   foreach (Node* d, deps) {
     TakeNode(d, new_parent);
@@ -84,7 +109,7 @@ QList<Node *> NodeGraph::TakeNodeWithItsDependencies(Node *node, QObject *new_pa
 
 QList<Node *> NodeGraph::nodes()
 {
-  return static_qobjectlist_cast<Node>(children());
+  return node_list_;
 }
 
 bool NodeGraph::ContainsNode(Node *n)
@@ -94,9 +119,376 @@ bool NodeGraph::ContainsNode(Node *n)
 
 void NodeGraph::Release()
 {
-  QList<Node*> all_nodes = nodes();
-
-  foreach (Node* n, all_nodes) {
+  foreach (Node* n, node_list_) {
     n->Release();
   }
 }
+
+QSet<Node *> NodeGraph::GetUpstream(Node *node)
+{
+  QHash<Node*, QSet<Node*> >::const_iterator i = upstream_cache_.constFind(node);
+
+  if (i != upstream_cache_.constEnd()) {
+    return i.value();
+  }
+
+  QSet<Node*> upstream = Traverse(node, true);
+
+  upstream_cache_.insert(node, upstream);
+
+  return upstream;
+}
+
+QSet<Node *> NodeGraph::GetDownstream(Node *node)
+{
+  QHash<Node*, QSet<Node*> >::const_iterator i = downstream_cache_.constFind(node);
+
+  if (i != downstream_cache_.constEnd()) {
+    return i.value();
+  }
+
+  QSet<Node*> downstream = Traverse(node, false);
+
+  downstream_cache_.insert(node, downstream);
+
+  return downstream;
+}
+
+QList<Node *> NodeGraph::GetExclusiveUpstream(Node *node)
+{
+  QSet<Node*> upstream = GetUpstream(node);
+
+  // Visit the upstream Nodes in reverse topological order, so every Node's consumers have been decided before it
+  QList<Node*> order = TopologicalOrder();
+
+  QSet<Node*> exclusive;
+  QList<Node*> exclusive_list;
+
+  for (int i=order.size()-1;i>=0;i--) {
+    Node* n = order.at(i);
+
+    if (!upstream.contains(n)) {
+      continue;
+    }
+
+    bool is_exclusive = true;
+
+    // A dependency is only exclusive if everything that uses it is `node` or another exclusive dependency
+    const QHash<Node*, int>& consumers = adjacency_.value(n).downstream;
+
+    for (QHash<Node*, int>::const_iterator j=consumers.constBegin();j!=consumers.constEnd();j++) {
+      if (j.key() != node && !exclusive.contains(j.key())) {
+        is_exclusive = false;
+        break;
+      }
+    }
+
+    if (is_exclusive) {
+      exclusive.insert(n);
+      exclusive_list.append(n);
+    }
+  }
+
+  return exclusive_list;
+}
+
+QList<Node *> NodeGraph::TopologicalOrder()
+{
+  if (!order_valid_) {
+    RebuildOrder();
+  }
+
+  return order_.values();
+}
+
+void NodeGraph::IndexEdgeAdded(NodeEdgePtr edge)
+{
+  Node* upstream = edge->output()->parent();
+  Node* downstream = edge->input()->parent();
+
+  if (ContainsNode(upstream) && ContainsNode(downstream)) {
+    AddAdjacency(upstream, downstream);
+  }
+}
+
+void NodeGraph::IndexEdgeRemoved(NodeEdgePtr edge)
+{
+  Node* upstream = edge->output()->parent();
+  Node* downstream = edge->input()->parent();
+
+  if (ContainsNode(upstream) && ContainsNode(downstream)) {
+    RemoveAdjacency(upstream, downstream);
+  }
+}
+
+void NodeGraph::NodeDestroyed(QObject *object)
+{
+  // The Node is partially destroyed at this point, so only its address is used
+  Node* node = static_cast<Node*>(object);
+
+  node_list_.removeOne(node);
+  UnindexNode(node);
+}
+
+void NodeGraph::IndexNode(Node *node)
+{
+  adjacency_.insert(node, Adjacency());
+
+  // New Nodes go at the end of the order, then get moved forward if anything in the graph depends on them
+  order_index_.insert(node, next_order_index_);
+  order_.insert(next_order_index_, node);
+  next_order_index_++;
+
+  QList<NodeParam*> params = node->parameters();
+
+  foreach (NodeParam* param, params) {
+    QVector<NodeEdgePtr> edges = param->edges();
+
+    foreach (NodeEdgePtr edge, edges) {
+      if (param->type() == NodeParam::kInput) {
+        Node* upstream = edge->output()->parent();
+
+        if (ContainsNode(upstream)) {
+          AddAdjacency(upstream, node);
+        }
+      } else {
+        Node* downstream = edge->input()->parent();
+
+        if (ContainsNode(downstream)) {
+          AddAdjacency(node, downstream);
+        }
+      }
+    }
+  }
+
+  GraphChanged();
+}
+
+void NodeGraph::UnindexNode(Node *node)
+{
+  QHash<Node*, Adjacency>::iterator i = adjacency_.find(node);
+
+  if (i == adjacency_.end()) {
+    return;
+  }
+
+  const Adjacency& adj = i.value();
+
+  for (QHash<Node*, int>::const_iterator j=adj.upstream.constBegin();j!=adj.upstream.constEnd();j++) {
+    adjacency_[j.key()].downstream.remove(node);
+  }
+
+  for (QHash<Node*, int>::const_iterator j=adj.downstream.constBegin();j!=adj.downstream.constEnd();j++) {
+    adjacency_[j.key()].upstream.remove(node);
+  }
+
+  adjacency_.erase(i);
+
+  // Removing a Node never breaks the order of the others
+  order_.remove(order_index_.take(node));
+
+  GraphChanged();
+}
+
+void NodeGraph::AddAdjacency(Node *upstream, Node *downstream)
+{
+  adjacency_[upstream].downstream[downstream]++;
+  int count = ++adjacency_[downstream].upstream[upstream];
+
+  // Another edge between Nodes that were already connected doesn't change the order
+  if (count == 1 && order_valid_ && order_index_.value(upstream) > order_index_.value(downstream)) {
+    ReorderForEdge(upstream, downstream);
+  }
+
+  GraphChanged();
+}
+
+void NodeGraph::RemoveAdjacency(Node *upstream, Node *downstream)
+{
+  QHash<Node*, int>& downstream_edges = adjacency_[upstream].downstream;
+  QHash<Node*, int>& upstream_edges = adjacency_[downstream].upstream;
+
+  if (--downstream_edges[downstream] <= 0) {
+    downstream_edges.remove(downstream);
+  }
+
+  if (--upstream_edges[upstream] <= 0) {
+    upstream_edges.remove(upstream);
+  }
+
+  // Removing an edge never breaks the order
+
+  GraphChanged();
+}
+
+void NodeGraph::ReorderForEdge(Node *upstream, Node *downstream)
+{
+  int lower_bound = order_index_.value(downstream);
+  int upper_bound = order_index_.value(upstream);
+
+  // Find everything after `downstream` (up to `upstream`) that depends on it
+  QList<Node*> forward;
+  QSet<Node*> visited;
+  QList<Node*> stack;
+
+  stack.append(downstream);
+  visited.insert(downstream);
+
+  while (!stack.isEmpty()) {
+    Node* n = stack.takeLast();
+    forward.append(n);
+
+    const QHash<Node*, int>& next = adjacency_.value(n).downstream;
+
+    for (QHash<Node*, int>::const_iterator i=next.constBegin();i!=next.constEnd();i++) {
+      Node* w = i.key();
+      int w_index = order_index_.value(w);
+
+      if (w == upstream) {
+        // This edge created a cycle, there's no valid order anymore
+        qWarning() << "Node graph contains a cycle";
+        order_valid_ = false;
+        return;
+      }
+
+      if (w_index < upper_bound && !visited.contains(w)) {
+        visited.insert(w);
+        stack.append(w);
+      }
+    }
+  }
+
+  // Find everything before `upstream` (down to `downstream`) that it depends on
+  QList<Node*> backward;
+
+  stack.append(upstream);
+  visited.insert(upstream);
+
+  while (!stack.isEmpty()) {
+    Node* n = stack.takeLast();
+    backward.append(n);
+
+    const QHash<Node*, int>& prev = adjacency_.value(n).upstream;
+
+    for (QHash<Node*, int>::const_iterator i=prev.constBegin();i!=prev.constEnd();i++) {
+      Node* w = i.key();
+
+      if (order_index_.value(w) > lower_bound && !visited.contains(w)) {
+        visited.insert(w);
+        stack.append(w);
+      }
+    }
+  }
+
+  // Both sets keep their internal order, but everything in `backward` now goes before everything in `forward`, reusing
+  // the same positions they had between them
+  auto by_order = [this](Node* a, Node* b) {
+    return order_index_.value(a) < order_index_.value(b);
+  };
+
+  std::sort(forward.begin(), forward.end(), by_order);
+  std::sort(backward.begin(), backward.end(), by_order);
+
+  QList<Node*> moved = backward + forward;
+
+  QVector<int> positions;
+  positions.reserve(moved.size());
+
+  foreach (Node* n, moved) {
+    positions.append(order_index_.value(n));
+    order_.remove(order_index_.value(n));
+  }
+
+  std::sort(positions.begin(), positions.end());
+
+  for (int i=0;i<moved.size();i++) {
+    order_index_.insert(moved.at(i), positions.at(i));
+    order_.insert(positions.at(i), moved.at(i));
+  }
+}
+
+void NodeGraph::RebuildOrder()
+{
+  // Kahn's algorithm
+  QHash<Node*, int> remaining_inputs;
+  QList<Node*> ready;
+
+  foreach (Node* n, node_list_) {
+    int count = adjacency_.value(n).upstream.size();
+
+    remaining_inputs.insert(n, count);
+
+    if (count == 0) {
+      ready.append(n);
+    }
+  }
+
+  order_.clear();
+  order_index_.clear();
+  next_order_index_ = 0;
+
+  QSet<Node*> placed;
+
+  while (!ready.isEmpty()) {
+    Node* n = ready.takeFirst();
+
+    order_index_.insert(n, next_order_index_);
+    order_.insert(next_order_index_, n);
+    next_order_index_++;
+    placed.insert(n);
+
+    const QHash<Node*, int>& next = adjacency_.value(n).downstream;
+
+    for (QHash<Node*, int>::const_iterator i=next.constBegin();i!=next.constEnd();i++) {
+      if (--remaining_inputs[i.key()] == 0) {
+        ready.append(i.key());
+      }
+    }
+  }
+
+  // Anything left is part of a cycle, just put it at the end
+  foreach (Node* n, node_list_) {
+    if (!placed.contains(n)) {
+      order_index_.insert(n, next_order_index_);
+      order_.insert(next_order_index_, n);
+      next_order_index_++;
+    }
+  }
+
+  order_valid_ = (placed.size() == node_list_.size());
+}
+
+QSet<Node *> NodeGraph::Traverse(Node *node, bool upstream)
+{
+  QSet<Node*> found;
+  QList<Node*> stack;
+
+  stack.append(node);
+
+  while (!stack.isEmpty()) {
+    const Adjacency& adj = adjacency_.value(stack.takeLast());
+    const QHash<Node*, int>& next = upstream ? adj.upstream : adj.downstream;
+
+    for (QHash<Node*, int>::const_iterator i=next.constBegin();i!=next.constEnd();i++) {
+      if (!found.contains(i.key())) {
+        found.insert(i.key());
+        stack.append(i.key());
+      }
+    }
+  }
+
+  return found;
+}
+
+int NodeGraph::EdgeVersion() const
+{
+  return edge_version_;
+}
+
+void NodeGraph::GraphChanged()
+{
+  upstream_cache_.clear();
+  downstream_cache_.clear();
+
+  edge_version_++;
+}
@@ -21,12 +21,22 @@
 #ifndef NODEGRAPH_H
 #define NODEGRAPH_H
 
+#include <QHash>
+#include <QMap>
 #include <QObject>
+#include <QSet>
 
 #include "node/node.h"
 
 /**
  * @brief A collection of nodes
+ *
+ * The graph keeps an index of which of its Nodes are connected to which, and a topological order of them, both kept
+ * up to date as Nodes are added/removed and edges are connected/disconnected. This makes questions like "what does
+ * this Node depend on?" cheap even in graphs with tens of thousands of Nodes.
+ *
+ * The index only covers edges between Nodes that are both in this graph. It's not thread-safe and should only be used
+ * from the thread the graph belongs to.
  */
 class NodeGraph : public QObject
 {
@@ -50,6 +60,9 @@ public:
    *
    * Adds the Node to the graph and runs through its inputs adding all of its dependencies (and all of their
    * dependencies and so forth). The graph takes ownershi of all Nodes added through this process.
+   *
+   * Dependencies that are already in the graph are assumed to have been added the same way, so their own
+   * dependencies aren't traversed again.
    */
   void AddNodeWithDependencies(Node* node);
 
@@ -85,6 +98,40 @@ public:
    */
   void Release();
 
+  /**
+   * @brief Return every Node in this graph that `node` depends on (directly or indirectly)
+   *
+   * Results are memoized until the graph next changes, so repeated queries are O(1).
+   */
+  QSet<Node*> GetUpstream(Node* node);
+
+  /**
+   * @brief Return every Node in this graph that depends on `node` (directly or indirectly)
+   *
+   * Results are memoized until the graph next changes, so repeated queries are O(1).
+   */
+  QSet<Node*> GetDownstream(Node* node);
+
+  /**
+   * @brief Return the Nodes that `node` depends on that nothing else in the graph depends on
+   *
+   * Equivalent to Node::GetExclusiveDependencies() but using the graph's index.
+   */
+  QList<Node*> GetExclusiveUpstream(Node* node);
+
+  /**
+   * @brief Return every Node in this graph ordered so each Node comes after all of the Nodes it depends on
+   */
+  QList<Node*> TopologicalOrder();
+
+  /**
+   * @brief Return a number that changes every time a Node is added to or removed from this graph, or an edge between
+   * its Nodes is connected or disconnected
+   *
+   * Used to find out whether anything derived from the graph's connections (e.g. a NodePlan) is out of date.
+   */
+  int EdgeVersion() const;
+
 signals:
   /**
    * @brief Signal emitted when a Node is added to the graph
@@ -106,7 +153,79 @@ signals:
    */
   void EdgeRemoved(NodeEdgePtr edge);
 
+private slots:
+  void IndexEdgeAdded(NodeEdgePtr edge);
+
+  void IndexEdgeRemoved(NodeEdgePtr edge);
+
+  void NodeDestroyed(QObject* object);
+
 private:
+  /**
+   * @brief Nodes directly connected to either side of a Node, with the number of edges between them
+   */
+  struct Adjacency {
+    QHash<Node*, int> upstream;
+    QHash<Node*, int> downstream;
+  };
+
+  /**
+   * @brief Add every edge between `node` and other Nodes in the graph to the index
+   */
+  void IndexNode(Node* node);
+
+  /**
+   * @brief Remove `node` and all of its edges from the index
+   */
+  void UnindexNode(Node* node);
+
+  void AddAdjacency(Node* upstream, Node* downstream);
+
+  void RemoveAdjacency(Node* upstream, Node* downstream);
+
+  /**
+   * @brief Restore the topological order after an edge from `upstream` to `downstream` was added
+   *
+   * This is the Pearce-Kelly algorithm: only the Nodes between the two in the current order are visited, and only
+   * those that have to move are given new positions.
+   */
+  void ReorderForEdge(Node* upstream, Node* downstream);
+
+  /**
+   * @brief Rebuild the topological order from scratch (only needed if the graph ever contains a cycle)
+   */
+  void RebuildOrder();
+
+  QSet<Node*> Traverse(Node* node, bool upstream);
+
+  /**
+   * @brief Drop memoized queries because the graph has changed
+   */
+  void GraphChanged();
+
+  QList<Node*> node_list_;
+
+  QHash<Node*, Adjacency> adjacency_;
+
+  /**
+   * @brief Each Node's position in the topological order (positions may have gaps)
+   */
+  QHash<Node*, int> order_index_;
+
+  /**
+   * @brief The topological order, keyed by position
+   */
+  QMap<int, Node*> order_;
+
+  int next_order_index_;
+
+  bool order_valid_;
+
+  int edge_version_;
+
+  QHash<Node*, QSet<Node*> > upstream_cache_;
+
+  QHash<Node*, QSet<Node*> > downstream_cache_;
 };
 
 #endif // NODEGRAPH_H
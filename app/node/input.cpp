@@ -25,13 +25,13 @@
 
 NodeInput::NodeInput(const QString& id) :
   NodeParam(id),
-  keyframing_(false),
+  keyframing_(0),
   dependent_(true),
   has_minimum_(false),
   has_maximum_(false)
 {
   // Have at least one keyframe/value active at any time
-  keyframes_.append(NodeKeyframe());
+  keyframes_ = std::make_shared<const NodeKeyframeTrack>();
 }
 
 NodeParam::Type NodeInput::type()
@@ -51,8 +51,10 @@ bool NodeInput::can_accept_type(const NodeParam::DataType &data_type)
 
 NodeOutput *NodeInput::get_connected_output()
 {
-  if (!edges_.isEmpty()) {
-    return edges_.first()->output();
+  QVector<NodeEdgePtr> edges = this->edges();
+
+  if (!edges.isEmpty()) {
+    return edges.first()->output();
   }
 
   return nullptr;
@@ -69,55 +71,162 @@ Node *NodeInput::get_connected_node()
   return nullptr;
 }
 
-QVariant NodeInput::get_value(const rational& time)
+NodeValue NodeInput::get_value(const rational& time)
 {
-  QVariant v;
+  NodeOutput* connected_output = get_connected_output();
 
-  if (time_ != time || !value_caching_) {
-    // Retrieve the value
-    if (!edges_.isEmpty()) {
-      // A connection - use the output of the connected Node
-      value_ = get_connected_output()->get_value(time);
-    } else {
-      // No connections - use the internal value
-      // FIXME: Re-implement keyframing
-      value_ = keyframes_.first().value();
-    }
+  if (connected_output != nullptr) {
+    // A connection - use the output of the connected Node (which caches its own values)
+    return connected_output->get_value(time);
+  }
 
-    time_ = time;
+  NodeValue v;
+  int epoch = 0;
+
+  if (GetCachedValue(time, &v, &epoch)) {
+    return v;
   }
 
-  v = value_;
+  // No connections - use the internal value
+  std::shared_ptr<const NodeKeyframeTrack> track = keyframe_track();
+
+  if (keyframing()) {
+    v = track->ValueAt(time);
+  } else {
+    v = track->first().value();
+  }
+
+  if (value_caching_) {
+    CacheValue(time, v, epoch);
+  }
 
   return v;
 }
 
-void NodeInput::set_value(const QVariant &value)
+QVector<NodeValue> NodeInput::get_values(const QVector<rational> &times)
 {
-  bool lock_mutex = (parent() != nullptr);
+  if (IsConnected() || !keyframing()) {
+    // Nothing to interpolate, so there's no advantage over getting each value
+    QVector<NodeValue> values;
+    values.reserve(times.size());
 
-  if (lock_mutex) parent()->Lock();
+    foreach (const rational& time, times) {
+      values.append(get_value(time));
+    }
 
+    return values;
+  }
+
+  return keyframe_track()->ValuesAt(times);
+}
+
+void NodeInput::set_value(const NodeValue &value)
+{
   if (keyframing()) {
-    // FIXME: Keyframing code using time()
+    set_value_at_time(0, value);
   } else {
     // Not keyframing, so invalidate entire time length
-    keyframes_.first().set_value(value);
+    QVector<NodeKeyframe> keys = keyframes();
+    keys.first().set_value(value);
+    PublishKeyframes(NodeKeyframeTrack(keys));
 
     emit ValueChanged(RATIONAL_MIN, RATIONAL_MAX);
   }
+}
+
+void NodeInput::set_value_at_time(const rational &time, const NodeValue &value)
+{
+  if (!keyframing()) {
+    set_value(value);
+    return;
+  }
+
+  std::shared_ptr<const NodeKeyframeTrack> track = keyframe_track();
+
+  NodeKeyframe key(time, value);
+
+  int index = track->IndexAt(time);
+
+  if (index >= 0) {
+    const NodeKeyframe& existing = track->keys().at(index);
+
+    if (existing.time() == time) {
+      // Keep the interpolation settings of the keyframe we're replacing
+      key = existing;
+      key.set_value(value);
+    } else {
+      // Continue with the same kind of interpolation as the keyframe before
+      key.set_type(existing.type());
+    }
+  }
 
-  if (lock_mutex) parent()->Unlock();
+  insert_keyframe(key);
+}
+
+void NodeInput::insert_keyframe(const NodeKeyframe &key)
+{
+  NodeKeyframeTrack track = keyframe_track()->Inserted(key);
+
+  PublishKeyframes(track);
+
+  // Only the values between the neighboring keyframes are affected
+  rational start, end;
+  track.GetAffectedRange(key.time(), &start, &end);
+
+  emit ValueChanged(start, end);
+}
+
+void NodeInput::remove_keyframe(const rational &time)
+{
+  std::shared_ptr<const NodeKeyframeTrack> track = keyframe_track();
+
+  rational start, end;
+  track->GetAffectedRange(time, &start, &end);
+
+  PublishKeyframes(track->Removed(time));
+
+  emit ValueChanged(start, end);
+}
+
+QVector<NodeKeyframe> NodeInput::keyframes()
+{
+  return keyframe_track()->keys();
+}
+
+std::shared_ptr<const NodeKeyframeTrack> NodeInput::keyframe_track()
+{
+  return std::atomic_load(&keyframes_);
+}
+
+void NodeInput::PublishKeyframes(const NodeKeyframeTrack &track)
+{
+  std::atomic_store(&keyframes_, std::make_shared<const NodeKeyframeTrack>(track));
+
+  // Let any render that's reading the old keyframes know its result is out of date
+  if (parent() != nullptr) {
+    parent()->BumpEditVersion();
+  }
 }
 
 bool NodeInput::keyframing()
 {
-  return keyframing_;
+  return (keyframing_.load() != 0);
 }
 
 void NodeInput::set_keyframing(bool k)
 {
-  keyframing_ = k;
+  if (keyframing() == k) {
+    return;
+  }
+
+  keyframing_.store(k ? 1 : 0);
+
+  if (parent() != nullptr) {
+    parent()->BumpEditVersion();
+  }
+
+  // Whether this input is keyframed changes whether the Node's output can vary over time
+  emit ValueChanged(RATIONAL_MIN, RATIONAL_MAX);
 }
 
 bool NodeInput::dependent()
@@ -164,9 +273,11 @@ void NodeInput::set_maximum(const QVariant &max)
 
 NodeParam::DataType NodeInput::data_type()
 {
-  if (IsConnected()) {
+  NodeOutput* connected_output = get_connected_output();
+
+  if (connected_output != nullptr) {
     // Return the connected output's data type
-    return edges_.first()->output()->data_type();
+    return connected_output->data_type();
   }
 
   if (inputs_.isEmpty()) {
@@ -186,7 +297,7 @@ const QList<NodeParam::DataType> &NodeInput::inputs()
 void NodeInput::CopyValues(NodeInput *source, NodeInput *dest)
 {
   // Copy values
-  dest->keyframes_ = source->keyframes_;
+  dest->PublishKeyframes(*source->keyframe_track());
 
   // Copy keyframing state
   dest->set_keyframing(source->keyframing());
@@ -21,7 +21,9 @@
 #ifndef NODEINPUT_H
 #define NODEINPUT_H
 
-#include "keyframe.h"
+#include <QAtomicInt>
+
+#include "keyframetrack.h"
 #include "param.h"
 
 /**
@@ -93,17 +95,55 @@ public:
    * If no output is connected, this will return a user-defined value, either a static value if this input is not
    * keyframed, or an interpolated value between the keyframes at this time.
    */
-  QVariant get_value(const rational &time);
+  NodeValue get_value(const rational &time);
+
+  /**
+   * @brief Get the value at several times at once
+   *
+   * Equivalent to calling get_value() for each time, but keyframes are evaluated in a single pass. Sorted times are the
+   * most efficient.
+   */
+  QVector<NodeValue> get_values(const QVector<rational>& times);
+
+  /**
+   * @brief Set the value
+   *
+   * This function will only work if there are no outputs connected. If keyframing is enabled, this sets a keyframe at
+   * time 0 (see set_value_at_time()).
+   */
+  void set_value(const NodeValue& value);
 
   /**
    * @brief Set the value at a given time
    *
-   * This function will only work if there are no outputs connected.
+   * If keyframing is enabled, this adds a keyframe at this time (or changes the one already there). Otherwise it's the
+   * same as set_value().
+   */
+  void set_value_at_time(const rational& time, const NodeValue& value);
+
+  /**
+   * @brief Add a keyframe, replacing any keyframe already at its time
    */
-  void set_value(const QVariant& value);
+  void insert_keyframe(const NodeKeyframe& key);
+
+  /**
+   * @brief Remove the keyframe at this time
+   *
+   * An input always has at least one keyframe, so the last one can't be removed.
+   */
+  void remove_keyframe(const rational& time);
+
+  /**
+   * @brief Return the current keyframe array, sorted by time
+   *
+   * This function is thread-safe.
+   */
+  QVector<NodeKeyframe> keyframes();
 
   /**
    * @brief Return whether keyframing is enabled on this input or not
+   *
+   * This function is thread-safe.
    */
   bool keyframing();
 
@@ -156,17 +196,32 @@ private:
   QList<DataType> inputs_;
 
   /**
-   * @brief Internal keyframe array
+   * @brief Return the current keyframe track (thread-safe)
+   */
+  std::shared_ptr<const NodeKeyframeTrack> keyframe_track();
+
+  /**
+   * @brief Replace the keyframe track
    *
-   * All internal/user-defined data is stored in this array. Even if keyframing is not enabled, this array will contain
+   * Keyframes are never modified in place. Each edit publishes a new, immutable track atomically, so render threads
+   * can read whichever track is current without locking the Node.
+   */
+  void PublishKeyframes(const NodeKeyframeTrack& track);
+
+  /**
+   * @brief Internal keyframe track
+   *
+   * All internal/user-defined data is stored in this track. Even if keyframing is not enabled, this track will contain
    * one entry which will be used, and its time value will be ignored.
    */
-  QList<NodeKeyframe> keyframes_;
+  std::shared_ptr<const NodeKeyframeTrack> keyframes_;
 
   /**
    * @brief Internal keyframing enabled setting
+   *
+   * Atomic since render threads read it while the main thread may be toggling it.
    */
-  bool keyframing_;
+  QAtomicInt keyframing_;
 
   /**
    * @brief Internal dependent setting
@@ -30,6 +30,16 @@
 #include "render/gl/functions.h"
 #include "render/pixelservice.h"
 
+/**
+ * @brief Color space footage is assumed to be in (FIXME: Hardcoded, should be set per footage)
+ */
+const char* kFootageColorspace = "srgb";
+
+/**
+ * @brief Whether footage is assumed to have associated alpha (FIXME: Hardcoded, should be set per footage)
+ */
+const bool kFootageAlphaIsAssociated = false;
+
 MediaInput::MediaInput() :
   decoder_(nullptr),
   color_service_(nullptr),
@@ -73,6 +83,9 @@ QString MediaInput::Description()
 
 void MediaInput::Release()
 {
+  // A render thread may still be using the decoder, wait for it to finish
+  Lock();
+
   internal_tex_.Destroy();
 
   frame_ = nullptr;
@@ -83,6 +96,8 @@ void MediaInput::Release()
   if (ocio_texture_ != 0) {
     ocio_ctx_->functions()->glDeleteTextures(1, &ocio_texture_);
   }
+
+  Unlock();
 }
 
 NodeInput *MediaInput::matrix_input()
@@ -100,179 +115,215 @@ void MediaInput::SetFootage(Footage *f)
   footage_input_->set_value(PtrToValue(f));
 }
 
-void MediaInput::Hash(QCryptographicHash *hash, NodeOutput *from, const rational &time)
+void MediaInput::Hash(FastHash *hash, NodeOutput *from, const rational &time)
 {
   Node::Hash(hash, from, time);
 
-  // Use frame value from Decoder
   if (from == texture_output_) {
-    if (!SetupDecoder()) {
-      qDebug() << "Failed to setup decoder for hashing";
+    Footage* footage = ValueToPtr<Footage>(footage_input_->get_value(0));
+
+    // FIXME: Hardcoded stream 0 (see SetupDecoder())
+    if (footage == nullptr || footage->stream_count() == 0) {
       return;
     }
 
-    int64_t timestamp = decoder_->GetTimestampFromTime(time);
+    StreamPtr stream = footage->stream(0);
+
+    // Hashing happens outside of rendering, so the decoder (which may be opening files or in use by a render thread)
+    // is never touched here. Instead we add the timestamp in the stream's timebase that the decoder is asked for,
+    // since the decoder always retrieves the same frame for the same timestamp.
+    int64_t timestamp = qRound64(time.toDouble() * stream->timebase().flipped().toDouble());
 
     QByteArray pts_bytes;
     pts_bytes.resize(sizeof(int64_t));
     memcpy(pts_bytes.data(), &timestamp, sizeof(int64_t));
 
     hash->addData(pts_bytes);
-    // FIXME: Add OCIO data
-    // FIXME: Add alpha association value
+
+    hash->addData(QByteArray::number(stream->index()));
+
+    // Add everything that affects the color transform
+    hash->addData(OCIO::GetCurrentConfig()->getCacheID());
+    hash->addData(kFootageColorspace);
+    hash->addData(OCIO::ROLE_SCENE_LINEAR);
+    hash->addData(kFootageAlphaIsAssociated ? "1" : "0");
   }
 }
 
-QVariant MediaInput::Value(NodeOutput *output, const rational &time)
+bool MediaInput::AnalyzeTimeInvariance(NodeOutput *output)
 {
-  // FIXME: Hardcoded value
-  bool alpha_is_associated = false;
+  if (output == texture_output_) {
+    Footage* footage = ValueToPtr<Footage>(footage_input_->get_value(0));
+
+    // FIXME: Hardcoded stream 0 (see SetupDecoder())
+    // Only still images are the same on every frame
+    if (footage == nullptr
+        || footage->stream_count() == 0
+        || footage->stream(0)->type() != Stream::kImage) {
+      return false;
+    }
+  }
+
+  return Node::AnalyzeTimeInvariance(output);
+}
 
+NodeValue MediaInput::Value(NodeOutput *output, const rational &time)
+{
   if (output == texture_output_) {
-    // Find the current Renderer instance
-    RenderInstance* renderer = RendererProcessor::CurrentInstance();
+    // Release() can be called from the main thread at any time, so hold our lock while using the decoder
+    Lock();
 
-    // If nothing is available, don't return a texture
-    if (renderer == nullptr) {
-      return 0;
-    }
+    NodeValue texture = ProcessTexture(time);
 
-    // Make sure decoder is set up
-    if (!SetupDecoder()) {
-      return 0;
-    }
+    Unlock();
 
-    // Check if we need to get a frame or not
-    if (frame_ == nullptr || frame_->native_timestamp() != decoder_->GetTimestampFromTime(time)) {
-      // Get frame from Decoder
-      frame_ = decoder_->Retrieve(time);
+    return texture;
+  }
 
-      if (frame_ == nullptr) {
-        qDebug() << "Received a null frame while time was" << time.toDouble();
-        return 0;
-      }
+  return 0;
+}
 
-      if (color_service_ == nullptr) {
-        // FIXME: Hardcoded values for testing
-        color_service_ = std::make_shared<ColorService>("srgb", OCIO::ROLE_SCENE_LINEAR);
-      }
+NodeValue MediaInput::ProcessTexture(const rational &time)
+{
+  // Find the current Renderer instance
+  RenderInstance* renderer = RendererProcessor::CurrentInstance();
 
-      // OpenColorIO v1's color transforms can be done on GPU, which improves performance but reduces accuracy. When
-      // online, we prefer accuracy over performance so we use the CPU path instead:
-      // NOTE: OCIO v2 boasts 1:1 results with the CPU and GPU path so this won't be necessary forever
-      if (renderer->mode() == olive::RenderMode::kOnline) {
-        // Convert to 32F, which is required for OpenColorIO's color transformation
-        frame_ = PixelService::ConvertPixelFormat(frame_, olive::PIX_FMT_RGBA32F);
-
-        if (alpha_is_associated) {
-          // Unassociate alpha here if associated
-          ColorService::DisassociateAlpha(frame_);
-        }
-
-        // Transform color to reference space
-        color_service_->ConvertFrame(frame_);
-
-        if (alpha_is_associated) {
-          // If alpha was associated, reassociate here
-          ColorService::ReassociateAlpha(frame_);
-        } else {
-          // If alpha was not associated, associate here
-          ColorService::AssociateAlpha(frame_);
-        }
-      }
+  // If nothing is available, don't return a texture
+  if (renderer == nullptr) {
+    return 0;
+  }
+
+  // Make sure decoder is set up
+  if (!SetupDecoder()) {
+    return 0;
+  }
+
+  // Check if we need to get a frame or not
+  if (frame_ == nullptr || frame_->native_timestamp() != decoder_->GetTimestampFromTime(time)) {
+    // Get frame from Decoder
+    frame_ = decoder_->Retrieve(time);
+
+    if (frame_ == nullptr) {
+      qDebug() << "Received a null frame while time was" << time.toDouble();
+      return 0;
+    }
+
+    if (color_service_ == nullptr) {
+      color_service_ = std::make_shared<ColorService>(kFootageColorspace, OCIO::ROLE_SCENE_LINEAR);
+    }
 
-      // We use an internal texture to bring the texture into GPU space before performing transformations
+    // OpenColorIO v1's color transforms can be done on GPU, which improves performance but reduces accuracy. When
+    // online, we prefer accuracy over performance so we use the CPU path instead:
+    // NOTE: OCIO v2 boasts 1:1 results with the CPU and GPU path so this won't be necessary forever
+    if (renderer->mode() == olive::RenderMode::kOnline) {
+      // Convert to 32F, which is required for OpenColorIO's color transformation
+      frame_ = PixelService::ConvertPixelFormat(frame_, olive::PIX_FMT_RGBA32F);
 
-      // Ensure the texture is the accurate to the frame
-      if (internal_tex_.width() != frame_->width()
-          || internal_tex_.height() != frame_->height()
-          || internal_tex_.format() != frame_->format()) {
-        internal_tex_.Destroy();
+      if (kFootageAlphaIsAssociated) {
+        // Unassociate alpha here if associated
+        ColorService::DisassociateAlpha(frame_);
       }
 
-      // Create or upload the new data to the texture
-      if (!internal_tex_.IsCreated()) {
-        internal_tex_.Create(renderer->context(),
-                             frame_->width(),
-                             frame_->height(),
-                             static_cast<olive::PixelFormat>(frame_->format()),
-                             frame_->data());
+      // Transform color to reference space
+      color_service_->ConvertFrame(frame_);
+
+      if (kFootageAlphaIsAssociated) {
+        // If alpha was associated, reassociate here
+        ColorService::ReassociateAlpha(frame_);
       } else {
-        internal_tex_.Upload(frame_->data());
+        // If alpha was not associated, associate here
+        ColorService::AssociateAlpha(frame_);
       }
     }
 
-    // Create new texture in reference space to send throughout the rest of the graph
+    // We use an internal texture to bring the texture into GPU space before performing transformations
 
-    RenderTexturePtr output_texture = std::make_shared<RenderTexture>();
+    // Ensure the texture is the accurate to the frame
+    if (internal_tex_.width() != frame_->width()
+        || internal_tex_.height() != frame_->height()
+        || internal_tex_.format() != frame_->format()) {
+      internal_tex_.Destroy();
+    }
 
-    output_texture->Create(renderer->context(),
-                    renderer->width(),
-                    renderer->height(),
-                    renderer->format(),
-                    RenderTexture::kDoubleBuffer);
+    // Create or upload the new data to the texture
+    if (!internal_tex_.IsCreated()) {
+      internal_tex_.Create(renderer->context(),
+                           frame_->width(),
+                           frame_->height(),
+                           static_cast<olive::PixelFormat>(frame_->format()),
+                           frame_->data());
+    } else {
+      internal_tex_.Upload(frame_->data());
+    }
+  }
 
-    // Using the transformation matrix, blit our internal texture (in frame format) to our output texture (in
-    // reference format)
+  // Create new texture in reference space to send throughout the rest of the graph
 
-    if (renderer->mode() == olive::RenderMode::kOffline) {
-      // For offline rendering, OCIO's GPU path is acceptable:
-      // NOTE: OCIO v2 boasts 1:1 results with the CPU and GPU path so this won't be necessary forever
+  RenderTexturePtr output_texture = renderer->image_cache()->Get(renderer->context(),
+                                                                 renderer->width(),
+                                                                 renderer->height(),
+                                                                 renderer->format(),
+                                                                 RenderTexture::kDoubleBuffer);
 
-      // Use an OCIO pipeline shader (which wraps in a default pipeline and will also handle alpha association)
-      if (pipeline_ == nullptr) {
-        pipeline_ = olive::ShaderGenerator::OCIOPipeline(renderer->context(),
-                                                         ocio_texture_, // FIXME: A raw GLuint texture, should wrap this up
-                                                         color_service_->GetProcessor(),
-                                                         alpha_is_associated);
+  // Using the transformation matrix, blit our internal texture (in frame format) to our output texture (in
+  // reference format)
 
-        // Used for cleanup later
-        ocio_ctx_ = renderer->context();
-      }
-    } else if (pipeline_ == nullptr) {
-      // In online, the color transformation was performed on the CPU (see above), so we only need to blit
-      pipeline_ = olive::ShaderGenerator::DefaultPipeline();
-    }
+  if (renderer->mode() == olive::RenderMode::kOffline) {
+    // For offline rendering, OCIO's GPU path is acceptable:
+    // NOTE: OCIO v2 boasts 1:1 results with the CPU and GPU path so this won't be necessary forever
 
-    renderer->context()->functions()->glBlendFunc(GL_ONE, GL_ZERO);
+    // Use an OCIO pipeline shader (which wraps in a default pipeline and will also handle alpha association)
+    if (pipeline_ == nullptr) {
+      pipeline_ = olive::ShaderGenerator::OCIOPipeline(renderer->context(),
+                                                       ocio_texture_, // FIXME: A raw GLuint texture, should wrap this up
+                                                       color_service_->GetProcessor(),
+                                                       kFootageAlphaIsAssociated);
 
-    // Draw onto the output texture using the renderer's framebuffer
-    renderer->buffer()->Attach(output_texture);
-    renderer->buffer()->Bind();
+      // Used for cleanup later
+      ocio_ctx_ = renderer->context();
+    }
+  } else if (pipeline_ == nullptr) {
+    // In online, the color transformation was performed on the CPU (see above), so we only need to blit
+    pipeline_ = olive::ShaderGenerator::DefaultPipeline();
+  }
 
-    // Draw with the internal texture
-    internal_tex_.Bind();
+  renderer->context()->functions()->glBlendFunc(GL_ONE, GL_ZERO);
 
-    QMatrix4x4 transform;
+  // Draw onto the output texture using the renderer's framebuffer (clearing it since it may be recycled and the
+  // frame won't necessarily cover all of it)
+  renderer->buffer()->Attach(output_texture, true);
+  renderer->buffer()->Bind();
 
-    // Scale texture to a square for incoming matrix transformation
-    transform.scale(static_cast<float>(renderer->height()) / static_cast<float>(renderer->width()), 1.0f);
+  // Draw with the internal texture
+  internal_tex_.Bind();
 
-    // Multiply by input transformation
-    transform *= matrix_input_->get_value(time).value<QMatrix4x4>();
+  QMatrix4x4 transform;
 
-    // Scale texture to the media's aspect ratio
-    transform.scale(static_cast<float>(frame_->width()) / static_cast<float>(frame_->height()), 1.0f);
+  // Scale texture to a square for incoming matrix transformation
+  transform.scale(static_cast<float>(renderer->height()) / static_cast<float>(renderer->width()), 1.0f);
 
-    float media_size = static_cast<float>(frame_->height()) / static_cast<float>(renderer->height() * renderer->divider());
-    transform.scale(media_size, media_size);
+  // Multiply by input transformation
+  transform *= matrix_input_->get_value(time).value<QMatrix4x4>();
 
-    // Use pipeline to blit using transformation matrix from input
-    if (renderer->mode() == olive::RenderMode::kOffline) {
-      olive::gl::OCIOBlit(pipeline_, ocio_texture_, false, transform);
-    } else {
-      olive::gl::Blit(pipeline_, false, transform);
-    }
+  // Scale texture to the media's aspect ratio
+  transform.scale(static_cast<float>(frame_->width()) / static_cast<float>(frame_->height()), 1.0f);
 
-    // Release everything
-    internal_tex_.Release();
-    renderer->buffer()->Detach();
-    renderer->buffer()->Release();
+  float media_size = static_cast<float>(frame_->height()) / static_cast<float>(renderer->height() * renderer->divider());
+  transform.scale(media_size, media_size);
 
-    return QVariant::fromValue(output_texture);
+  // Use pipeline to blit using transformation matrix from input
+  if (renderer->mode() == olive::RenderMode::kOffline) {
+    olive::gl::OCIOBlit(pipeline_, ocio_texture_, false, transform);
+  } else {
+    olive::gl::Blit(pipeline_, false, transform);
   }
 
-  return 0;
+  // Release everything
+  internal_tex_.Release();
+  renderer->buffer()->Detach();
+  renderer->buffer()->Release();
+
+  return NodeValue(output_texture);
 }
 
 bool MediaInput::SetupDecoder()
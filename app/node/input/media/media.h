@@ -51,12 +51,21 @@ public:
 
   void SetFootage(Footage* f);
 
-  virtual void Hash(QCryptographicHash *hash, NodeOutput* from, const rational &time) override;
+  virtual void Hash(FastHash *hash, NodeOutput* from, const rational &time) override;
 
 protected:
-  virtual QVariant Value(NodeOutput* output, const rational& time) override;
+  virtual bool AnalyzeTimeInvariance(NodeOutput* output) override;
+
+  virtual NodeValue Value(NodeOutput* output, const rational& time) override;
 
 private:
+  /**
+   * @brief Decode the frame at `time` and draw it into a texture in reference space
+   *
+   * Must be called with this Node locked (see Release()).
+   */
+  NodeValue ProcessTexture(const rational& time);
+
   bool SetupDecoder();
 
   NodeInput* footage_input_;
@@ -67,6 +76,11 @@ private:
 
   RenderTexture internal_tex_;
 
+  /**
+   * @brief Decoder for the current footage
+   *
+   * Used by render threads in Value() and destroyed by the main thread in Release(), both of which lock this Node.
+   */
   DecoderPtr decoder_;
 
   ColorServicePtr color_service_;
@@ -23,12 +23,24 @@
 NodeKeyframe::NodeKeyframe() :
   time_(0),
   value_(0),
-  type_(kLinear)
+  type_(kLinear),
+  bezier_control_in_(-1.0/3.0, -1.0/3.0),
+  bezier_control_out_(1.0/3.0, 1.0/3.0)
 {
 
 }
 
-const rational &NodeKeyframe::time()
+NodeKeyframe::NodeKeyframe(const rational &time, const NodeValue &value, const NodeKeyframe::Type &type) :
+  time_(time),
+  value_(value),
+  type_(type),
+  bezier_control_in_(-1.0/3.0, -1.0/3.0),
+  bezier_control_out_(1.0/3.0, 1.0/3.0)
+{
+
+}
+
+const rational &NodeKeyframe::time() const
 {
   return time_;
 }
@@ -38,17 +50,17 @@ void NodeKeyframe::set_time(const rational &time)
   time_ = time;
 }
 
-const QVariant &NodeKeyframe::value()
+const NodeValue &NodeKeyframe::value() const
 {
   return value_;
 }
 
-void NodeKeyframe::set_value(const QVariant &value)
+void NodeKeyframe::set_value(const NodeValue &value)
 {
   value_ = value;
 }
 
-const NodeKeyframe::Type &NodeKeyframe::type()
+const NodeKeyframe::Type &NodeKeyframe::type() const
 {
   return type_;
 }
@@ -57,3 +69,23 @@ void NodeKeyframe::set_type(const NodeKeyframe::Type &type)
 {
   type_ = type;
 }
+
+const QPointF &NodeKeyframe::bezier_control_in() const
+{
+  return bezier_control_in_;
+}
+
+void NodeKeyframe::set_bezier_control_in(const QPointF &control)
+{
+  bezier_control_in_ = control;
+}
+
+const QPointF &NodeKeyframe::bezier_control_out() const
+{
+  return bezier_control_out_;
+}
+
+void NodeKeyframe::set_bezier_control_out(const QPointF &control)
+{
+  bezier_control_out_ = control;
+}
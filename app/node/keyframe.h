@@ -21,9 +21,10 @@
 #ifndef NODEKEYFRAME_H
 #define NODEKEYFRAME_H
 
-#include <QVariant>
+#include <QPointF>
 
 #include "common/rational.h"
+#include "value.h"
 
 /**
  * @brief A point of data to be used at a certain time and interpolated with other data
@@ -46,30 +47,49 @@ public:
    */
   NodeKeyframe();
 
+  NodeKeyframe(const rational& time, const NodeValue& value, const Type& type = kLinear);
+
   /**
    * @brief The time this keyframe is set at
    */
-  const rational& time();
+  const rational& time() const;
   void set_time(const rational& time);
 
   /**
    * @brief The value of this keyframe (i.e. the value to use at this keyframe's time)
    */
-  const QVariant& value();
-  void set_value(const QVariant &value);
+  const NodeValue& value() const;
+  void set_value(const NodeValue &value);
 
   /**
-   * @brief The method of interpolation to use with this keyframe
+   * @brief The method of interpolation to use between this keyframe and the next one
    */
-  const Type& type();
+  const Type& type() const;
   void set_type(const Type& type);
 
+  /**
+   * @brief Bezier handles used by kBezier segments
+   *
+   * The out handle is used if this keyframe is kBezier, the in handle if the previous one is. Handles are offsets from the keyframe, measured in fractions of the segment they're in. X is time and Y is
+   * progress from one keyframe's value to the next. The out handle is relative to the start of the segment (0, 0) and
+   * the in handle is relative to the end (1, 1). The defaults are a straight line, i.e. linear.
+   */
+  const QPointF& bezier_control_in() const;
+  void set_bezier_control_in(const QPointF& control);
+
+  const QPointF& bezier_control_out() const;
+  void set_bezier_control_out(const QPointF& control);
+
 private:
   rational time_;
 
-  QVariant value_;
+  NodeValue value_;
 
   Type type_;
+
+  QPointF bezier_control_in_;
+
+  QPointF bezier_control_out_;
 };
 
 #endif // NODEKEYFRAME_H
@@ -0,0 +1,294 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "keyframetrack.h"
+
+#include <algorithm>
+#include <QtMath>
+
+/**
+ * @brief Number of Newton-Raphson iterations used to solve a bezier curve for time
+ */
+const int kBezierIterations = 8;
+
+NodeKeyframeTrack::NodeKeyframeTrack() :
+  NodeKeyframeTrack(QVector<NodeKeyframe>())
+{
+}
+
+NodeKeyframeTrack::NodeKeyframeTrack(QVector<NodeKeyframe> keys)
+{
+  if (keys.isEmpty()) {
+    keys.append(NodeKeyframe());
+  }
+
+  std::stable_sort(keys.begin(), keys.end(), [](const NodeKeyframe& a, const NodeKeyframe& b) {
+    return a.time() < b.time();
+  });
+
+  keys_.reserve(keys.size());
+  times_.reserve(keys.size());
+
+  foreach (const NodeKeyframe& key, keys) {
+    if (!times_.isEmpty() && times_.last() == key.time()) {
+      // Later keyframes at the same time replace earlier ones
+      keys_.last() = key;
+    } else {
+      keys_.append(key);
+      times_.append(key.time());
+    }
+  }
+}
+
+const QVector<NodeKeyframe> &NodeKeyframeTrack::keys() const
+{
+  return keys_;
+}
+
+const NodeKeyframe &NodeKeyframeTrack::first() const
+{
+  return keys_.first();
+}
+
+int NodeKeyframeTrack::IndexAt(const rational &time) const
+{
+  QVector<rational>::const_iterator i = std::upper_bound(times_.constBegin(), times_.constEnd(), time);
+
+  return static_cast<int>(i - times_.constBegin()) - 1;
+}
+
+NodeValue NodeKeyframeTrack::ValueAt(const rational &time) const
+{
+  return Evaluate(SegmentAt(IndexAt(time)), time);
+}
+
+QVector<NodeValue> NodeKeyframeTrack::ValuesAt(const QVector<rational> &times) const
+{
+  QVector<NodeValue> values;
+  values.reserve(times.size());
+
+  if (times.isEmpty()) {
+    return values;
+  }
+
+  Segment segment = SegmentAt(IndexAt(times.first()));
+
+  foreach (const rational& time, times) {
+    int index = segment.index;
+
+    if (index >= 0 && time < times_.at(index)) {
+      // Times are going backwards, fall back to searching
+      index = IndexAt(time);
+    } else {
+      // Walk forward through any keyframes we've passed
+      while (index + 1 < times_.size() && times_.at(index + 1) <= time) {
+        index++;
+      }
+    }
+
+    if (index != segment.index) {
+      segment = SegmentAt(index);
+    }
+
+    values.append(Evaluate(segment, time));
+  }
+
+  return values;
+}
+
+NodeKeyframeTrack NodeKeyframeTrack::Inserted(const NodeKeyframe &key) const
+{
+  QVector<NodeKeyframe> keys = keys_;
+
+  keys.append(key);
+
+  return NodeKeyframeTrack(keys);
+}
+
+NodeKeyframeTrack NodeKeyframeTrack::Removed(const rational &time) const
+{
+  int index = IndexAt(time);
+
+  if (keys_.size() == 1 || index < 0 || times_.at(index) != time) {
+    return *this;
+  }
+
+  QVector<NodeKeyframe> keys = keys_;
+
+  keys.remove(index);
+
+  return NodeKeyframeTrack(keys);
+}
+
+void NodeKeyframeTrack::GetAffectedRange(const rational &time, rational *start, rational *end) const
+{
+  int index = IndexAt(time);
+
+  // Skip over a keyframe at this exact time, it's the one being changed
+  int before = (index >= 0 && times_.at(index) == time) ? index - 1 : index;
+  int after = index + 1;
+
+  // With no keyframe before or after, the first/last keyframe's value extends forever
+  *start = (before >= 0) ? times_.at(before) : RATIONAL_MIN;
+  *end = (after < times_.size()) ? times_.at(after) : RATIONAL_MAX;
+}
+
+NodeKeyframeTrack::Segment NodeKeyframeTrack::SegmentAt(int index) const
+{
+  Segment segment;
+
+  segment.index = index;
+
+  if (index >= 0 && index + 1 < times_.size()) {
+    segment.start = times_.at(index).toDouble();
+    segment.length = times_.at(index + 1).toDouble() - segment.start;
+  } else {
+    segment.start = 0;
+    segment.length = 0;
+  }
+
+  return segment;
+}
+
+NodeValue NodeKeyframeTrack::Evaluate(const NodeKeyframeTrack::Segment &segment, const rational &time) const
+{
+  // Before the first keyframe or after the last one, the value is held
+  if (segment.index < 0) {
+    return keys_.first().value();
+  }
+
+  const NodeKeyframe& a = keys_.at(segment.index);
+
+  if (segment.index + 1 == keys_.size() || a.type() == NodeKeyframe::kHold || segment.length <= 0) {
+    return a.value();
+  }
+
+  const NodeKeyframe& b = keys_.at(segment.index + 1);
+
+  double progress = (time.toDouble() - segment.start) / segment.length;
+
+  if (a.type() == NodeKeyframe::kBezier) {
+    progress = BezierProgress(progress, a.bezier_control_out(), b.bezier_control_in());
+  }
+
+  return Lerp(a.value(), b.value(), progress);
+}
+
+double NodeKeyframeTrack::BezierProgress(double x, const QPointF &out, const QPointF &in)
+{
+  // Control points of a curve from (0, 0) to (1, 1). X is clamped to the segment so the curve can't loop back in time.
+  double x1 = qBound(0.0, out.x(), 1.0);
+  double y1 = out.y();
+  double x2 = qBound(0.0, 1.0 + in.x(), 1.0);
+  double y2 = 1.0 + in.y();
+
+  // Cubic bezier polynomial coefficients
+  double cx = 3.0 * x1;
+  double bx = 3.0 * (x2 - x1) - cx;
+  double ax = 1.0 - cx - bx;
+
+  double cy = 3.0 * y1;
+  double by = 3.0 * (y2 - y1) - cy;
+  double ay = 1.0 - cy - by;
+
+  // Find the point on the curve at this time (x). Newton-Raphson converges in a few steps for any sensible handles.
+  double t = x;
+
+  for (int i=0;i<kBezierIterations;i++) {
+    double error = ((ax * t + bx) * t + cx) * t - x;
+    double slope = (3.0 * ax * t + 2.0 * bx) * t + cx;
+
+    if (qAbs(error) < 1e-7) {
+      break;
+    }
+
+    if (qFuzzyIsNull(slope)) {
+      // Flat spot, fall back to bisection
+      double lo = 0.0;
+      double hi = 1.0;
+
+      t = x;
+
+      for (int j=0;j<32;j++) {
+        double value = ((ax * t + bx) * t + cx) * t;
+
+        if (value < x) {
+          lo = t;
+        } else {
+          hi = t;
+        }
+
+        t = (lo + hi) * 0.5;
+      }
+
+      break;
+    }
+
+    t = qBound(0.0, t - error / slope, 1.0);
+  }
+
+  return ((ay * t + by) * t + cy) * t;
+}
+
+NodeValue NodeKeyframeTrack::Lerp(const NodeValue &a, const NodeValue &b, double t)
+{
+  if (a.type() != b.type()) {
+    return a;
+  }
+
+  float tf = static_cast<float>(t);
+
+  switch (a.type()) {
+  case NodeValue::kInt:
+    return qRound(a.toInt() + (b.toInt() - a.toInt()) * t);
+  case NodeValue::kFloat:
+    return a.toDouble() + (b.toDouble() - a.toDouble()) * t;
+  case NodeValue::kVec2:
+  {
+    QVector2D va = a.value<QVector2D>();
+    return va + (b.value<QVector2D>() - va) * tf;
+  }
+  case NodeValue::kVec3:
+  {
+    QVector3D va = a.value<QVector3D>();
+    return va + (b.value<QVector3D>() - va) * tf;
+  }
+  case NodeValue::kVec4:
+  {
+    QVector4D va = a.value<QVector4D>();
+    return va + (b.value<QVector4D>() - va) * tf;
+  }
+  case NodeValue::kColor:
+  {
+    QColor ca = a.value<QColor>();
+    QColor cb = b.value<QColor>();
+
+    return QColor::fromRgbF(ca.redF() + (cb.redF() - ca.redF()) * t,
+                            ca.greenF() + (cb.greenF() - ca.greenF()) * t,
+                            ca.blueF() + (cb.blueF() - ca.blueF()) * t,
+                            ca.alphaF() + (cb.alphaF() - ca.alphaF()) * t);
+  }
+  default:
+    break;
+  }
+
+  // Everything else (strings, pointers, etc.) can't be interpolated
+  return a;
+}
@@ -0,0 +1,127 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef NODEKEYFRAMETRACK_H
+#define NODEKEYFRAMETRACK_H
+
+#include <QVector>
+
+#include "keyframe.h"
+
+/**
+ * @brief An immutable, time-sorted array of keyframes that can be evaluated at any time
+ *
+ * Keyframes are stored contiguously along with a separate array of their times, so finding the segment a time falls
+ * in is a binary search over a small array. ValuesAt() evaluates a whole list of times in one pass, which is much
+ * cheaper than calling ValueAt() for each frame when hashing or caching long stretches of a sequence.
+ *
+ * A track always has at least one keyframe.
+ */
+class NodeKeyframeTrack
+{
+public:
+  /**
+   * @brief Create a track with a single default keyframe
+   */
+  NodeKeyframeTrack();
+
+  /**
+   * @brief Create a track from a list of keyframes in any order
+   *
+   * If more than one keyframe has the same time, the last one is used. An empty list is replaced with a single default
+   * keyframe.
+   */
+  NodeKeyframeTrack(QVector<NodeKeyframe> keys);
+
+  const QVector<NodeKeyframe>& keys() const;
+
+  const NodeKeyframe& first() const;
+
+  /**
+   * @brief Return the index of the last keyframe at or before this time, or -1 if it's before the first keyframe
+   */
+  int IndexAt(const rational& time) const;
+
+  /**
+   * @brief Return the interpolated value at this time
+   */
+  NodeValue ValueAt(const rational& time) const;
+
+  /**
+   * @brief Return the interpolated value at each of these times
+   *
+   * Works with times in any order, but sorted times are evaluated in a single pass without any searching.
+   */
+  QVector<NodeValue> ValuesAt(const QVector<rational>& times) const;
+
+  /**
+   * @brief Return a copy of this track with a keyframe added (or replacing the keyframe already at its time)
+   */
+  NodeKeyframeTrack Inserted(const NodeKeyframe& key) const;
+
+  /**
+   * @brief Return a copy of this track without the keyframe at this time
+   *
+   * The last keyframe can't be removed, so if this is the only keyframe, the track is returned unchanged.
+   */
+  NodeKeyframeTrack Removed(const rational& time) const;
+
+  /**
+   * @brief Return the range of time whose values depend on the keyframe at (or that would be at) this time
+   *
+   * This is from the keyframe before to the keyframe after, or the start/end of time if there isn't one.
+   */
+  void GetAffectedRange(const rational& time, rational* start, rational* end) const;
+
+private:
+  /**
+   * @brief Pre-computed values for evaluating times between two keyframes
+   */
+  struct Segment {
+    int index;
+    double start;
+    double length;
+  };
+
+  Segment SegmentAt(int index) const;
+
+  NodeValue Evaluate(const Segment& segment, const rational& time) const;
+
+  /**
+   * @brief Convert linear progress through a kBezier segment into eased progress
+   */
+  static double BezierProgress(double x, const QPointF& out, const QPointF& in);
+
+  /**
+   * @brief Interpolate between two values of the same type
+   *
+   * Types that can't be interpolated hold `a` until the next keyframe.
+   */
+  static NodeValue Lerp(const NodeValue& a, const NodeValue& b, double t);
+
+  QVector<NodeKeyframe> keys_;
+
+  /**
+   * @brief The time of each keyframe, kept separately so searches only touch this array
+   */
+  QVector<rational> times_;
+};
+
+#endif // NODEKEYFRAMETRACK_H
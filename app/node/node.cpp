@@ -21,11 +21,16 @@
 #include "node.h"
 
 #include <QDebug>
+#include <QSet>
 
-#include "common/qobjectlistcast.h"
+/**
+ * @brief Maximum number of memoized hashes kept per output
+ */
+const int kNodeHashCacheSize = 4096;
 
 Node::Node() :
-  last_processed_time_(-1)
+  last_processed_time_(-1),
+  cache_epoch_(0)
 {
 }
 
@@ -56,6 +61,8 @@ void Node::AddParameter(NodeParam *param)
 
   param->setParent(this);
 
+  params_.append(param);
+
   connect(param, SIGNAL(EdgeAdded(NodeEdgePtr)), this, SIGNAL(EdgeAdded(NodeEdgePtr)));
   connect(param, SIGNAL(EdgeRemoved(NodeEdgePtr)), this, SIGNAL(EdgeRemoved(NodeEdgePtr)));
 
@@ -68,6 +75,8 @@ void Node::AddParameter(NodeParam *param)
 
 void Node::RemoveParameter(NodeParam *param)
 {
+  params_.removeAll(param);
+
   delete param;
 }
 
@@ -77,6 +86,14 @@ void Node::InvalidateCache(const rational &start_range, const rational &end_rang
 
   ClearCachedValuesInParameters(start_range, end_range);
 
+  ClearHashCache(start_range, end_range);
+
+  // Whatever changed may have been a connection or keyframe
+  hash_cache_lock_.lock();
+  time_invariant_cache_.clear();
+  cache_epoch_++;
+  hash_cache_lock_.unlock();
+
   SendInvalidateCache(start_range, end_range);
 }
 
@@ -102,6 +119,16 @@ void Node::SendInvalidateCache(const rational &start_range, const rational &end_
   }
 }
 
+int Node::EditVersion()
+{
+  return edit_version_.load();
+}
+
+void Node::BumpEditVersion()
+{
+  edit_version_.fetchAndAddOrdered(1);
+}
+
 void Node::Lock()
 {
   lock_.lock();
@@ -160,24 +187,19 @@ NodeOutput *Node::LastProcessedOutput()
 
 void Node::ClearCachedValuesInParameters(const rational &start_range, const rational &end_range)
 {
-  Q_UNUSED(start_range)
-  Q_UNUSED(end_range)
-
   QList<NodeParam *> params = parameters();
 
   // Loop through all parameters and clear cached values
   foreach (NodeParam* param, params) {
-    //if (param->LastRequestedTime() >= start_range && param->LastRequestedTime() <= end_range) {
-      param->ClearCachedValue();
-    //}
+    param->ClearCachedValues(start_range, end_range);
   }
 }
 
-QVariant Node::Run(NodeOutput* output, const rational& time)
+NodeValue Node::Run(NodeOutput* output, const rational& time)
 {
   run_lock_.lock();
 
-  QVariant v = Value(output, time);
+  NodeValue v = Value(output, time);
 
   run_lock_.unlock();
 
@@ -186,89 +208,126 @@ QVariant Node::Run(NodeOutput* output, const rational& time)
 
 NodeParam *Node::ParamAt(int index)
 {
-  return static_cast<NodeParam*>(children().at(index));
+  return params_.at(index);
 }
 
 QList<NodeParam *> Node::parameters()
 {
-  return static_qobjectlist_cast<NodeParam>(children());
+  return params_;
 }
 
 int Node::ParameterCount()
 {
-  return children().size();
+  return params_.size();
 }
 
 int Node::IndexOfParameter(NodeParam *param)
 {
-  return children().indexOf(param);
+  return params_.indexOf(param);
 }
 
 /**
  * @brief Recursively collects dependencies of Node `n` and appends them to QList `list`
  *
+ * @param visited
+ *
+ * Set of Nodes already in `list`, used to avoid a linear search of `list` for every edge
+ *
  * @param traverse
  *
  * TRUE to recursively traverse each node for a complete dependency graph. FALSE to return only the immediate
  * dependencies.
  */
-void GetDependenciesInternal(Node* n, QList<Node*>& list, bool traverse) {
+void GetDependenciesInternal(Node* n, QList<Node*>& list, QSet<Node*>& visited, bool traverse) {
   QList<NodeParam*> params = n->parameters();
 
   foreach (NodeParam* p, params) {
     if (p->type() == NodeParam::kInput) {
       Node* connected = static_cast<NodeInput*>(p)->get_connected_node();
 
-      if (connected != nullptr && !list.contains(connected)) {
+      if (connected != nullptr && !visited.contains(connected)) {
+        visited.insert(connected);
         list.append(connected);
 
         if (traverse) {
-          GetDependenciesInternal(connected, list, traverse);
+          GetDependenciesInternal(connected, list, visited, traverse);
         }
       }
     }
   }
 }
 
+/**
+ * @brief Appends the dependencies of Node `n` to `list` so that each Node comes after every Node it depends on
+ */
+void GetDependenciesPostOrder(Node* n, QList<Node*>& list, QSet<Node*>& visited) {
+  QList<NodeParam*> params = n->parameters();
+
+  foreach (NodeParam* p, params) {
+    if (p->type() == NodeParam::kInput) {
+      Node* connected = static_cast<NodeInput*>(p)->get_connected_node();
+
+      if (connected != nullptr && !visited.contains(connected)) {
+        visited.insert(connected);
+
+        GetDependenciesPostOrder(connected, list, visited);
+
+        list.append(connected);
+      }
+    }
+  }
+}
+
 QList<Node *> Node::GetDependencies()
 {
   QList<Node *> node_list;
+  QSet<Node*> visited;
 
-  GetDependenciesInternal(this, node_list, true);
+  GetDependenciesInternal(this, node_list, visited, true);
 
   return node_list;
 }
 
 QList<Node *> Node::GetExclusiveDependencies()
 {
-  QList<Node*> deps = GetDependencies();
+  QList<Node*> post_order;
+  QSet<Node*> visited;
+
+  GetDependenciesPostOrder(this, post_order, visited);
 
-  // Filter out any dependencies that are used elsewhere
-  for (int i=0;i<deps.size();i++) {
-    QList<NodeParam*> params = deps.at(i)->parameters();
+  // Walk backwards so every Node that uses a dependency has been checked before the dependency itself
+  QSet<Node*> exclusive;
+  QList<Node*> deps;
 
-    // See if any of this Node's outputs are used outside of this dep list
-    for (int j=0;j<params.size();j++) {
+  for (int i=post_order.size()-1;i>=0;i--) {
+    Node* dep = post_order.at(i);
+    QList<NodeParam*> params = dep->parameters();
+    bool is_exclusive = true;
+
+    // See if any of this Node's outputs are used outside of this Node's exclusive dependencies
+    for (int j=0;j<params.size() && is_exclusive;j++) {
       NodeParam* p = params.at(j);
 
       if (p->type() == NodeParam::kOutput) {
         QVector<NodeEdgePtr> edges = p->edges();
 
         for (int k=0;k<edges.size();k++) {
-          NodeEdgePtr edge = edges.at(k);
-
-          // If any edge goes to from an output here to an input of a Node that isn't in this dep list, it's NOT an
-          // exclusive dependency
-          if (deps.contains(edge->input()->parent())) {
-            deps.removeAt(i);
+          Node* consumer = edges.at(k)->input()->parent();
 
-            i--;                // -1 since we just removed a Node in this list
-            j = params.size();  // No need to keep looking at this Node's params
-            break;              // Or this param's edges
+          // If any edge goes from an output here to an input of a Node that isn't this one or another exclusive
+          // dependency, it's NOT an exclusive dependency
+          if (consumer != this && !exclusive.contains(consumer)) {
+            is_exclusive = false;
+            break;
           }
         }
       }
     }
+
+    if (is_exclusive) {
+      exclusive.insert(dep);
+      deps.append(dep);
+    }
   }
 
   return deps;
@@ -277,8 +336,9 @@ QList<Node *> Node::GetExclusiveDependencies()
 QList<Node *> Node::GetImmediateDependencies()
 {
   QList<Node *> node_list;
+  QSet<Node*> visited;
 
-  GetDependenciesInternal(this, node_list, false);
+  GetDependenciesInternal(this, node_list, visited, false);
 
   return node_list;
 }
@@ -308,6 +368,15 @@ QList<NodeDependency> Node::RunDependencies(NodeOutput *output, const rational &
   return run_deps;
 }
 
+bool Node::GetInputTime(NodeOutput *output, NodeInput *input, const rational &time, rational *input_time)
+{
+  Q_UNUSED(output)
+
+  *input_time = time;
+
+  return input->dependent();
+}
+
 bool Node::OutputsTo(Node *n)
 {
   QList<NodeParam*> params = parameters();
@@ -327,10 +396,108 @@ bool Node::OutputsTo(Node *n)
   return false;
 }
 
-void Node::Hash(QCryptographicHash *hash, NodeOutput* from, const rational &time)
+bool Node::IsTimeInvariant(NodeOutput *output)
+{
+  hash_cache_lock_.lock();
+
+  QHash<NodeOutput*, bool>::const_iterator cached = time_invariant_cache_.constFind(output);
+  bool has_cached = (cached != time_invariant_cache_.constEnd());
+  bool invariant = has_cached && cached.value();
+  int epoch = cache_epoch_;
+
+  hash_cache_lock_.unlock();
+
+  if (!has_cached) {
+    invariant = AnalyzeTimeInvariance(output);
+
+    hash_cache_lock_.lock();
+
+    // Don't store a result that was worked out from values that have since been invalidated
+    if (epoch == cache_epoch_) {
+      time_invariant_cache_.insert(output, invariant);
+    }
+
+    hash_cache_lock_.unlock();
+  }
+
+  return invariant;
+}
+
+bool Node::AnalyzeTimeInvariance(NodeOutput *output)
+{
+  Q_UNUSED(output)
+
+  QList<NodeParam*> params = parameters();
+
+  foreach (NodeParam* param, params) {
+    if (param->type() != NodeParam::kInput) {
+      continue;
+    }
+
+    NodeInput* input = static_cast<NodeInput*>(param);
+
+    if (input->IsConnected()) {
+      NodeOutput* connected = input->get_connected_output();
+
+      if (!connected->parent()->IsTimeInvariant(connected)) {
+        return false;
+      }
+    } else if (input->dependent() && input->keyframing()) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+QByteArray Node::GetHash(NodeOutput *from, const rational &time_in)
+{
+  // A time-invariant output has the same hash at every time, so hash (and memoize) it at one time only
+  rational time = IsTimeInvariant(from) ? rational(0) : time_in;
+
+  hash_cache_lock_.lock();
+
+  QByteArray result = hash_cache_.value(from).value(time);
+
+  if (id_bytes_.isEmpty()) {
+    id_bytes_ = id().toUtf8();
+  }
+
+  int epoch = cache_epoch_;
+
+  hash_cache_lock_.unlock();
+
+  if (!result.isEmpty()) {
+    return result;
+  }
+
+  FastHash hasher;
+  Hash(&hasher, from, time);
+  result = hasher.result();
+
+  hash_cache_lock_.lock();
+
+  // If this Node was invalidated while we were hashing, the hash may have been worked out from old values
+  if (epoch == cache_epoch_) {
+    QMap<rational, QByteArray>& output_cache = hash_cache_[from];
+
+    // Rather than tracking usage, just start again if the cache gets too big
+    if (output_cache.size() >= kNodeHashCacheSize) {
+      output_cache.clear();
+    }
+
+    output_cache.insert(time, result);
+  }
+
+  hash_cache_lock_.unlock();
+
+  return result;
+}
+
+void Node::Hash(FastHash *hash, NodeOutput* from, const rational &time)
 {
-  // Add this Node's ID
-  hash->addData(id().toUtf8());
+  // Add this Node's ID (set by GetHash() before this is called)
+  hash->addData(id_bytes_);
 
   // Add each value
   QList<NodeParam*> params = parameters();
@@ -339,7 +506,7 @@ void Node::Hash(QCryptographicHash *hash, NodeOutput* from, const rational &time
         && !param->IsConnected()
         && static_cast<NodeInput*>(param)->dependent()) {
       // Get the value at this time
-      QVariant v = static_cast<NodeInput*>(param)->get_value(time);
+      NodeValue v = static_cast<NodeInput*>(param)->get_value(time);
 
       hash->addData(NodeParam::ValueToBytes(param->data_type(), v));
     }
@@ -349,13 +516,33 @@ void Node::Hash(QCryptographicHash *hash, NodeOutput* from, const rational &time
   QList<NodeDependency> deps = RunDependencies(from, time);
   foreach (const NodeDependency& dep, deps) {
     // Hash the connected node
-    dep.node()->parent()->Hash(hash, dep.node(), dep.time());
+    hash->addData(dep.node()->parent()->GetHash(dep.node(), dep.time()));
+  }
+}
+
+void Node::ClearHashCache(const rational &start_range, const rational &end_range)
+{
+  hash_cache_lock_.lock();
+
+  for (QHash<NodeOutput*, QMap<rational, QByteArray> >::iterator i=hash_cache_.begin();i!=hash_cache_.end();i++) {
+    QMap<rational, QByteArray>& output_cache = i.value();
+
+    QMap<rational, QByteArray>::iterator j = output_cache.lowerBound(start_range);
+
+    while (j != output_cache.end() && j.key() <= end_range) {
+      j = output_cache.erase(j);
+    }
   }
+
+  // Make sure any hash that's being calculated right now isn't memoized once it's done
+  cache_epoch_++;
+
+  hash_cache_lock_.unlock();
 }
 
-QVariant Node::PtrToValue(void *ptr)
+NodeValue Node::PtrToValue(void *ptr)
 {
-  return reinterpret_cast<quintptr>(ptr);
+  return NodeValue(static_cast<const void*>(ptr));
 }
 
 bool Node::HasParamWithID(const QString &id)
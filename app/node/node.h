@@ -21,10 +21,12 @@
 #ifndef NODE_H
 #define NODE_H
 
-#include <QCryptographicHash>
+#include <QHash>
+#include <QMap>
 #include <QMutex>
 #include <QObject>
 
+#include "common/fasthash.h"
 #include "common/rational.h"
 #include "node/dependency.h"
 #include "node/input.h"
@@ -139,7 +141,7 @@ public:
    *
    * It's recommended to call this directly over Value(), yet in derivatives of Node, override Value().
    */
-  QVariant Run(NodeOutput* output, const rational& time);
+  NodeValue Run(NodeOutput* output, const rational& time);
 
   /**
    * @brief For nodes that have different dependencies at different times, this function can be used for that purpose
@@ -148,25 +150,77 @@ public:
    */
   virtual QList<NodeDependency> RunDependencies(NodeOutput* output, const rational& time);
 
+  /**
+   * @brief Return whether the connected `input` is used when `output` is evaluated at `time`, and if so at what time
+   *
+   * NodePlan uses this to work out in advance which of the Nodes it contains to evaluate and when. By default every
+   * dependent input is used at the same time as the output. Nodes that transform time or skip inputs should override
+   * this consistently with Value().
+   */
+  virtual bool GetInputTime(NodeOutput* output, NodeInput* input, const rational& time, rational* input_time);
+
   /**
    * @brief Returns whether this Node outputs data to the Node `n` in any way
    */
   bool OutputsTo(Node* n);
 
   /**
-   * @brief Add's unique information about this Node at the given time to a QCryptographicHash
+   * @brief Returns whether `output` produces the same value at every time
+   *
+   * By default an output is time-invariant if none of this Node's inputs are keyframed and every connected input is
+   * itself fed by a time-invariant output. Subclasses that use time directly (e.g. footage or Blocks) should override
+   * this. Results are memoized until the next InvalidateCache().
+   *
+   * Time-invariant outputs are hashed once for all time and their values are reused across frames, so a static
+   * sub-graph (e.g. a title card) only renders once.
+   *
+   * This function is thread-safe.
    */
-  virtual void Hash(QCryptographicHash* hash, NodeOutput *from, const rational& time);
+  bool IsTimeInvariant(NodeOutput* output);
+
+  /**
+   * @brief Return a hash of this Node's output `from` at the given time, including everything it depends on
+   *
+   * Results are memoized until InvalidateCache() is called with a range containing `time`, so hashing the same
+   * sub-graph repeatedly (e.g. once per frame, or from several downstream nodes) only does the work once.
+   *
+   * This function is thread-safe.
+   */
+  QByteArray GetHash(NodeOutput* from, const rational& time);
+
+  /**
+   * @brief Clear any memoized hashes between start_range and end_range
+   *
+   * InvalidateCache() does this already, call this directly when something that affects this Node's hashes changes
+   * without its content being invalidated (e.g. a Block moving in a track).
+   */
+  void ClearHashCache(const rational& start_range, const rational& end_range);
+
+  /**
+   * @brief Add's unique information about this Node at the given time to a hash
+   *
+   * Dependencies should be added using their GetHash() so their results are memoized.
+   *
+   * Hashes are calculated on the main thread while render threads may be running this Node, so overrides must not do
+   * any I/O (e.g. decoding) or modify the Node.
+   */
+  virtual void Hash(FastHash* hash, NodeOutput *from, const rational& time);
 
   /**
    * @brief Convert a pointer to a value that can be sent between NodeParams
    */
-  static QVariant PtrToValue(void* ptr);
+  static NodeValue PtrToValue(void* ptr);
 
   template<class T>
   /**
    * @brief Convert a NodeParam value to a pointer of any kind
    */
+  static T* ValueToPtr(const NodeValue& ptr);
+
+  template<class T>
+  /**
+   * @brief Convert a pointer that was passed through the UI (see NodeValue::ToVariant()) back to a pointer
+   */
   static T* ValueToPtr(const QVariant& ptr);
 
   /**
@@ -180,6 +234,22 @@ public:
    */
   virtual void InvalidateCache(const rational& start_range, const rational& end_range, NodeInput* from = nullptr);
 
+  /**
+   * @brief Return a number that changes every time one of this Node's inputs is edited or reconnected
+   *
+   * Render threads only lock each value for as long as it takes to read it, so an edit can still land part way through
+   * a render. Comparing this before and after a render tells them whether that happened (so the result may mix old and
+   * new values).
+   *
+   * This function is thread-safe.
+   */
+  int EditVersion();
+
+  /**
+   * @brief Signal that one of this Node's inputs has been edited (see EditVersion())
+   */
+  void BumpEditVersion();
+
   /**
    * @brief Lock mutex (for thread safety)
    */
@@ -227,7 +297,7 @@ protected:
    * corresponding output if it's connected to one. If your node doesn't directly deal with time, the default behavior
    * of the NodeParam objects will handle everything related to it automatically.
    */
-  virtual QVariant Value(NodeOutput* output, const rational& time) = 0;
+  virtual NodeValue Value(NodeOutput* output, const rational& time) = 0;
 
   /**
    * @brief Retrieve the last timecode Process() was called with
@@ -243,6 +313,11 @@ protected:
 
   void SendInvalidateCache(const rational& start_range, const rational& end_range);
 
+  /**
+   * @brief Analysis function behind IsTimeInvariant(), override this rather than IsTimeInvariant() itself
+   */
+  virtual bool AnalyzeTimeInvariance(NodeOutput* output);
+
 public slots:
 
 signals:
@@ -280,11 +355,40 @@ private:
    */
   NodeOutput* last_processed_parameter_;
 
+  /**
+   * @brief Parameters in the order they were added, stored so parameters() doesn't need to cast children() each time
+   */
+  QList<NodeParam*> params_;
+
   /**
    * @brief Used for thread safety from main thread
    */
   QMutex lock_;
 
+  /**
+   * @brief Memoized results of GetHash() for each output
+   */
+  QHash<NodeOutput*, QMap<rational, QByteArray> > hash_cache_;
+
+  /**
+   * @brief id() as bytes, stored so it doesn't need converting every time this Node is hashed
+   */
+  QByteArray id_bytes_;
+
+  /**
+   * @brief Memoized results of IsTimeInvariant() for each output
+   */
+  QHash<NodeOutput*, bool> time_invariant_cache_;
+
+  /**
+   * @brief Incremented whenever the memoized caches above are invalidated
+   */
+  int cache_epoch_;
+
+  QAtomicInt edit_version_;
+
+  QMutex hash_cache_lock_;
+
   /**
    * @brief Used for thread safety between multiple threads
    */
@@ -297,6 +401,12 @@ private slots:
 
 };
 
+template<class T>
+T* Node::ValueToPtr(const NodeValue &ptr)
+{
+  return static_cast<T*>(const_cast<void*>(ptr.value<const void*>()));
+}
+
 template<class T>
 T* Node::ValueToPtr(const QVariant &ptr)
 {
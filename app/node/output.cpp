@@ -21,6 +21,7 @@
 #include "output.h"
 
 #include "node/node.h"
+#include "node/plan.h"
 
 NodeOutput::NodeOutput(const QString &id) :
   NodeParam(id),
@@ -46,42 +47,48 @@ void NodeOutput::set_data_type(const NodeParam::DataType &type)
 
   data_type_ = type;
 
+  SetValueCacheSize(DefaultValueCacheSize(data_type_));
+
   // If this output is connected to other inputs, check if they're compatible with this new data type
   if (IsConnected()) {
-    for (int i=0;i<edges_.size();i++) {
-      NodeEdgePtr edge = edges_.at(i);
+    // Disconnecting publishes a new edge list, so iterate over a copy of the current one
+    QVector<NodeEdgePtr> edges = this->edges();
 
+    foreach (NodeEdgePtr edge, edges) {
       if (!AreDataTypesCompatible(this, edge->input())) {
         DisconnectEdge(edge);
-        i--;
       }
     }
   }
 }
 
-QVariant NodeOutput::get_value(const rational& time)
+NodeValue NodeOutput::get_value(const rational& time)
 {
-  mutex_.lock();
+  NodeValue v;
 
-  QVariant v;
+  // If a plan running on this thread has already evaluated this output, use its result
+  if (NodePlan::GetRunningValue(this, time, &v)) {
+    return v;
+  }
 
-  if (time_ != time || !value_caching_) {
-    // Update the value
-    value_ = parent()->Run(this, time);
+  int epoch = 0;
 
-    time_ = time;
+  // A time-invariant value can be reused at any time, as long as there is one
+  if (GetCachedValue(time, &v, &epoch, parent()->IsTimeInvariant(this))) {
+    return v;
   }
 
-  v = value_;
+  v = parent()->Run(this, time);
 
-  mutex_.unlock();
+  if (value_caching_) {
+    CacheValue(time, v, epoch);
+  }
 
   return v;
 }
 
-void NodeOutput::push_value(const QVariant &v, const rational &time)
+void NodeOutput::push_value(const NodeValue &v, const rational &time)
 {
-  value_ = v;
-  time_ = time;
+  CacheValue(time, v);
 }
 
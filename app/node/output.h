@@ -61,15 +61,13 @@ public:
    * In many cases for efficiency, the Node can also ignore this request if it knows the output data will not change
    * (i.e. if the time has not changed from the last Process()).
    */
-  virtual QVariant get_value(const rational &time);
+  virtual NodeValue get_value(const rational &time);
 
-  void push_value(const QVariant& v, const rational& time);
+  void push_value(const NodeValue& v, const rational& time);
 
 private:
   DataType data_type_;
 
-  QMutex mutex_;
-
 };
 
 #endif // NODEOUTPUT_H
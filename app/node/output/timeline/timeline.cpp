@@ -22,12 +22,16 @@
 
 #include <QDebug>
 
-#include "node/blend/alphaover/alphaover.h"
+#include "node/blend/compositor/compositor.h"
 #include "node/block/gap/gap.h"
 #include "node/graph.h"
+#include "undo/undostack.h"
 
 TimelineOutput::TimelineOutput() :
-  attached_timeline_(nullptr)
+  attached_timeline_(nullptr),
+  compositor_(nullptr),
+  edit_depth_(0),
+  restoring_(false)
 {
   track_input_ = new NodeInput("track_in");
   track_input_->add_data_input(NodeParam::kTrack);
@@ -35,6 +39,9 @@ TimelineOutput::TimelineOutput() :
 
   length_output_ = new NodeOutput("length_out");
   length_output_->set_data_type(NodeParam::kRational);
+
+  // The length doesn't depend on time, so it wouldn't be cleared by time-ranged invalidations if it were cached
+  length_output_->SetValueCachingEnabled(false);
   AddParameter(length_output_);
 
   connect(this, SIGNAL(EdgeAdded(NodeEdgePtr)), this, SLOT(TrackConnectionAdded(NodeEdgePtr)));
@@ -70,6 +77,8 @@ void TimelineOutput::AttachTimeline(TimelinePanel *timeline)
     disconnect(view, SIGNAL(RequestPlaceBlock(Block*, rational, int)), this, SLOT(PlaceBlock(Block*, rational, int)));
     disconnect(view, SIGNAL(RequestReplaceBlock(Block*, Block*, int)), this, SLOT(ReplaceBlock(Block*, Block*, int)));
     disconnect(view, SIGNAL(RequestSplitAtTime(rational, int)), this, SLOT(SplitAtTime(rational, int)));
+    disconnect(view, SIGNAL(RequestBeginEdit()), this, SLOT(BeginEdit()));
+    disconnect(view, SIGNAL(RequestCommitEdit()), this, SLOT(CommitEdit()));
 
     // Remove existing UI objects from TimelinePanel
     attached_timeline_->Clear();
@@ -93,6 +102,8 @@ void TimelineOutput::AttachTimeline(TimelinePanel *timeline)
     connect(view, SIGNAL(RequestPlaceBlock(Block*, rational, int)), this, SLOT(PlaceBlock(Block*, rational, int)));
     connect(view, SIGNAL(RequestReplaceBlock(Block*, Block*, int)), this, SLOT(ReplaceBlock(Block*, Block*, int)));
     connect(view, SIGNAL(RequestSplitAtTime(rational, int)), this, SLOT(SplitAtTime(rational, int)));
+    connect(view, SIGNAL(RequestBeginEdit()), this, SLOT(BeginEdit()));
+    connect(view, SIGNAL(RequestCommitEdit()), this, SLOT(CommitEdit()));
   }
 }
 
@@ -106,7 +117,7 @@ NodeOutput *TimelineOutput::length_output()
   return length_output_;
 }
 
-QVariant TimelineOutput::Value(NodeOutput *output, const rational &time)
+NodeValue TimelineOutput::Value(NodeOutput *output, const rational &time)
 {
   if (output == length_output_) {
     Q_UNUSED(time)
@@ -118,7 +129,7 @@ QVariant TimelineOutput::Value(NodeOutput *output, const rational &time)
       length = qMax(track->in(), length);
     }
 
-    return QVariant::fromValue(length);
+    return NodeValue(length);
   }
 
   return 0;
@@ -158,6 +169,11 @@ void TimelineOutput::AttachTrack(TrackOutput *track)
 
     track_cache_.append(current_track);
 
+    // Tracks created in the middle of an edit (e.g. by PlaceBlock()) join it
+    if (edit_depth_ > 0) {
+      BeginTrackEdit(current_track);
+    }
+
     // This function must be called after the track is added to track_cache_, since it uses track_cache_ to determine
     // the track's index
     current_track->GenerateBlockWidgets();
@@ -209,12 +225,21 @@ void TimelineOutput::AddTrack()
     NodeParam::ConnectEdge(track->track_output(), current_last_track->track_input());
 
     // FIXME: Test code only
-    AlphaOverBlend* blend = new AlphaOverBlend();
-    static_cast<NodeGraph*>(parent())->AddNode(blend);
+    if (compositor_ == nullptr) {
+      // All tracks are composited in one pass by a single compositor, which starts with layers for the first two
+      compositor_ = new CompositorNode();
+      static_cast<NodeGraph*>(parent())->AddNode(compositor_);
 
-    NodeParam::ConnectEdge(track->texture_output(), blend->blend_input());
-    NodeParam::ConnectEdge(current_last_track->texture_output(), blend->base_input());
-    NodeParam::ConnectEdge(blend->texture_output(), current_last_track->texture_output()->edges().first()->input());
+      NodeInput* texture_destination = current_last_track->texture_output()->edges().first()->input();
+
+      NodeParam::ConnectEdge(current_last_track->texture_output(), compositor_->layer_texture_input(0));
+      NodeParam::ConnectEdge(track->texture_output(), compositor_->layer_texture_input(1));
+      NodeParam::ConnectEdge(compositor_->texture_output(), texture_destination);
+    } else {
+      int layer = compositor_->AddLayer();
+
+      NodeParam::ConnectEdge(track->texture_output(), compositor_->layer_texture_input(layer));
+    }
     // End test code
   }
 }
@@ -314,3 +339,183 @@ void TimelineOutput::ResizeBlock(Block *block, rational new_length)
 {
   block->set_length(new_length);
 }
+
+void TimelineOutput::BeginEdit()
+{
+  if (edit_depth_ == 0) {
+    edit_tracks_.clear();
+    edit_before_.clear();
+
+    foreach (TrackOutput* track, track_cache_) {
+      BeginTrackEdit(track);
+    }
+  }
+
+  edit_depth_++;
+}
+
+void TimelineOutput::CommitEdit()
+{
+  if (edit_depth_ == 0) {
+    qWarning() << "CommitEdit() called without BeginEdit()";
+    return;
+  }
+
+  edit_depth_--;
+
+  if (edit_depth_ > 0) {
+    return;
+  }
+
+  // Merge every track's invalidated area into one range
+  TimeRange invalidate_range;
+  QVector<TrackOutput*> invalidate_tracks;
+  QVector<TrackState> after;
+
+  foreach (TrackOutput* track, edit_tracks_) {
+    TimeRange track_range;
+
+    if (track->TakePendingInvalidation(&track_range)) {
+      if (invalidate_tracks.isEmpty()) {
+        invalidate_range = track_range;
+      } else {
+        invalidate_range = invalidate_range.CombineWith(track_range);
+      }
+
+      invalidate_tracks.append(track);
+    }
+
+    after.append(SaveTrackState(track));
+
+    // Sends each track's Refreshed() signals
+    track->UnblockInvalidateCache();
+  }
+
+  foreach (TrackOutput* track, invalidate_tracks) {
+    track->InvalidateCache(invalidate_range.in(), invalidate_range.out());
+  }
+
+  if (!restoring_ && after != edit_before_) {
+    olive::undo_stack.push(new EditCommand(this, edit_before_, after));
+  }
+
+  edit_tracks_.clear();
+  edit_before_.clear();
+}
+
+void TimelineOutput::BeginTrackEdit(TrackOutput *track)
+{
+  edit_tracks_.append(track);
+  edit_before_.append(SaveTrackState(track));
+
+  track->BlockInvalidateCache();
+}
+
+TimelineOutput::TrackState TimelineOutput::SaveTrackState(TrackOutput *track)
+{
+  TrackState state;
+
+  state.track = track;
+  state.blocks = track->Blocks();
+
+  state.lengths.resize(state.blocks.size());
+  state.media_ins.resize(state.blocks.size());
+
+  for (int i=0;i<state.blocks.size();i++) {
+    state.lengths[i] = state.blocks.at(i)->length();
+    state.media_ins[i] = state.blocks.at(i)->media_in();
+  }
+
+  return state;
+}
+
+void TimelineOutput::RestoreTrackStates(const QVector<TrackState> &states)
+{
+  restoring_ = true;
+
+  BeginEdit();
+
+  QVector<rational> old_ends(states.size());
+
+  // Detach every Block first, since Blocks may be moving between tracks
+  for (int i=0;i<states.size();i++) {
+    TrackOutput* track = states.at(i).track;
+    QVector<Block*> current = track->Blocks();
+
+    old_ends[i] = track->in();
+
+    if (!current.isEmpty()) {
+      // Start from the end, so each disconnection only has to refresh the Block that was just cut off
+      Block::DisconnectBlocks(current.last(), track);
+
+      for (int j=current.size()-1;j>0;j--) {
+        Block::DisconnectBlocks(current.at(j-1), current.at(j));
+      }
+    }
+  }
+
+  for (int i=0;i<states.size();i++) {
+    const TrackState& state = states.at(i);
+
+    for (int j=0;j<state.blocks.size();j++) {
+      Block* b = state.blocks.at(j);
+
+      b->set_length(state.lengths.at(j));
+      b->set_media_in(state.media_ins.at(j));
+
+      if (j > 0) {
+        Block::ConnectBlocks(state.blocks.at(j-1), b);
+      }
+    }
+
+    // Connect to the track last so it only has to rebuild its Block list once
+    if (!state.blocks.isEmpty()) {
+      Block::ConnectBlocks(state.blocks.last(), state.track);
+    }
+
+    state.track->InvalidateCache(0, qMax(old_ends.at(i), state.track->in()));
+  }
+
+  CommitEdit();
+
+  restoring_ = false;
+}
+
+bool TimelineOutput::TrackState::operator==(const TrackState &other) const
+{
+  return track == other.track
+      && blocks == other.blocks
+      && lengths == other.lengths
+      && media_ins == other.media_ins;
+}
+
+TimelineOutput::EditCommand::EditCommand(TimelineOutput *timeline,
+                                         const QVector<TrackState> &before,
+                                         const QVector<TrackState> &after,
+                                         QUndoCommand *parent) :
+  QUndoCommand(parent),
+  timeline_(timeline),
+  before_(before),
+  after_(after),
+  done_(true)
+{
+}
+
+void TimelineOutput::EditCommand::redo()
+{
+  // The edit was already made before this command was pushed
+  if (done_) {
+    return;
+  }
+
+  timeline_->RestoreTrackStates(after_);
+
+  done_ = true;
+}
+
+void TimelineOutput::EditCommand::undo()
+{
+  timeline_->RestoreTrackStates(before_);
+
+  done_ = false;
+}
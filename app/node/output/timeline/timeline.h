@@ -21,6 +21,9 @@
 #ifndef TIMELINEOUTPUT_H
 #define TIMELINEOUTPUT_H
 
+#include <QUndoCommand>
+
+#include "node/blend/compositor/compositor.h"
 #include "node/block/block.h"
 #include "node/output/track/track.h"
 #include "panel/timeline/timeline.h"
@@ -47,10 +50,75 @@ public:
 
   NodeOutput* length_output();
 
+public slots:
+  /**
+   * @brief Start a transaction of Block edits across all tracks
+   *
+   * Until the matching CommitEdit(), tracks hold onto their cache invalidations and Refreshed() signals instead of
+   * sending them after every edit. Calls can be nested, only the outermost CommitEdit() commits.
+   */
+  void BeginEdit();
+
+  /**
+   * @brief Commit a transaction started with BeginEdit()
+   *
+   * Every track is refreshed once, the areas invalidated by all tracks are merged into one range that's invalidated
+   * once, and the whole transaction is pushed to the undo stack as a single command.
+   */
+  void CommitEdit();
+
 protected:
-  virtual QVariant Value(NodeOutput* output, const rational& time) override;
+  virtual NodeValue Value(NodeOutput* output, const rational& time) override;
 
 private:
+  /**
+   * @brief The order, lengths and media in points of a track's Blocks at a certain moment
+   */
+  struct TrackState {
+    TrackOutput* track;
+    QVector<Block*> blocks;
+    QVector<rational> lengths;
+    QVector<rational> media_ins;
+
+    bool operator==(const TrackState& other) const;
+  };
+
+  /**
+   * @brief A QUndoCommand for a committed edit transaction
+   */
+  class EditCommand : public QUndoCommand {
+  public:
+    EditCommand(TimelineOutput* timeline,
+                const QVector<TrackState>& before,
+                const QVector<TrackState>& after,
+                QUndoCommand* parent = nullptr);
+
+    virtual void redo() override;
+    virtual void undo() override;
+  private:
+    TimelineOutput* timeline_;
+
+    QVector<TrackState> before_;
+    QVector<TrackState> after_;
+
+    /**
+     * @brief Whether the edit has been made already (it has been when the command is first pushed)
+     */
+    bool done_;
+  };
+
+  /**
+   * @brief Include a track in the current edit transaction
+   */
+  void BeginTrackEdit(TrackOutput* track);
+
+  TrackState SaveTrackState(TrackOutput* track);
+
+  /**
+   * @brief Put tracks' Blocks back into a saved state (used for undo/redo)
+   */
+  void RestoreTrackStates(const QVector<TrackState>& states);
+
   int GetTrackIndex(TrackOutput* track);
 
   rational GetSequenceLength();
@@ -76,6 +144,31 @@ private:
 
   rational timebase_;
 
+  /**
+   * @brief Node compositing the textures of all tracks, created when a second track is added
+   */
+  CompositorNode* compositor_;
+
+  /**
+   * @brief Number of BeginEdit() calls without a matching CommitEdit()
+   */
+  int edit_depth_;
+
+  /**
+   * @brief Tracks taking part in the current edit transaction
+   */
+  QVector<TrackOutput*> edit_tracks_;
+
+  /**
+   * @brief State of each track in edit_tracks_ when it joined the transaction
+   */
+  QVector<TrackState> edit_before_;
+
+  /**
+   * @brief Set while undoing/redoing so restoring doesn't push another undo command
+   */
+  bool restoring_;
+
 private slots:
   /**
    * @brief Slot for when the track connection is added
@@ -20,15 +20,20 @@
 
 #include "track.h"
 
+#include <algorithm>
 #include <QDebug>
 
 #include "node/block/gap/gap.h"
 #include "node/graph.h"
 
 TrackOutput::TrackOutput() :
-  current_block_(this),
-  block_invalidate_cache_stack_(0)
+  block_invalidate_cache_stack_(0),
+  has_pending_invalidation_(false),
+  pending_refresh_index_(-1)
 {
+  // The TrackOutput is the end of its own chain of Blocks
+  set_track(this);
+
   track_input_ = new NodeInput("track_in");
   track_input_->add_data_input(NodeParam::kTrack);
   track_input_->set_dependent(false);
@@ -36,9 +41,20 @@ TrackOutput::TrackOutput() :
 
   track_output_ = new NodeOutput("track_out");
   track_output_->set_data_type(NodeParam::kTrack);
+  track_output_->SetValueCachingEnabled(false);
   AddParameter(track_output_);
 }
 
+TrackOutput::~TrackOutput()
+{
+  // Blocks outliving this track shouldn't ask it for their in points anymore
+  foreach (Block* b, block_cache_) {
+    if (b->track() == this) {
+      b->set_track(nullptr);
+    }
+  }
+}
+
 Block::Type TrackOutput::type()
 {
   return kEnd;
@@ -78,32 +94,75 @@ void TrackOutput::set_length(const rational &)
 void TrackOutput::Refresh()
 {
   QVector<Block*> detect_attached_blocks;
+  QHash<Block*, int> detect_block_index;
 
+  // Walk backwards from the end, then reverse the list so it's in order
   Block* prev = previous();
   while (prev != nullptr) {
-    detect_attached_blocks.prepend(prev);
-
-    if (!block_cache_.contains(prev)) {
-      emit BlockAdded(prev);
-    }
+    detect_attached_blocks.append(prev);
 
     prev = prev->previous();
   }
 
-  foreach (Block* b, block_cache_) {
-    if (!detect_attached_blocks.contains(b)) {
-      // If the current block was removed, stop referencing it
-      if (current_block_ == b) {
-        current_block_ = this;
-      }
+  std::reverse(detect_attached_blocks.begin(), detect_attached_blocks.end());
 
-      emit BlockRemoved(b);
+  QVector<rational> lengths(detect_attached_blocks.size());
+  QVector<Block*> added_blocks;
+
+  for (int i=0;i<detect_attached_blocks.size();i++) {
+    Block* b = detect_attached_blocks.at(i);
+
+    detect_block_index.insert(b, i);
+    lengths[i] = b->length();
+
+    if (!block_index_.contains(b)) {
+      added_blocks.append(b);
+    }
+  }
+
+  QVector<Block*> removed_blocks;
+
+  foreach (Block* b, block_cache_) {
+    if (!detect_block_index.contains(b)) {
+      removed_blocks.append(b);
     }
   }
 
+  // Blocks before the first difference haven't moved
+  int first_changed = 0;
+  while (first_changed < block_cache_.size()
+         && first_changed < detect_attached_blocks.size()
+         && block_cache_.at(first_changed) == detect_attached_blocks.at(first_changed)) {
+    first_changed++;
+  }
+
+  // Render threads may be looking up Blocks in the old layout
+  layout_lock_.lock();
+
   block_cache_ = detect_attached_blocks;
+  block_index_ = detect_block_index;
+  lengths_.Build(lengths);
+
+  layout_lock_.unlock();
+
+  BumpEditVersion();
+
+  foreach (Block* b, removed_blocks) {
+    if (b->track() == this) {
+      b->set_track(nullptr);
+    }
+
+    emit BlockRemoved(b);
+  }
+
+  foreach (Block* b, added_blocks) {
+    b->set_track(this);
+
+    emit BlockAdded(b);
+  }
+
+  QueueRefresh(first_changed);
 
-  Block::Refresh();
   qDebug() << "Refreshed with in point" << in().toDouble() << "(from connected block" << previous() << ")";
 }
 
@@ -112,10 +171,10 @@ QList<NodeDependency> TrackOutput::RunDependencies(NodeOutput* output, const rat
   QList<NodeDependency> deps;
 
   if (output == texture_output()) {
-    ValidateCurrentBlock(time);
+    Block* block = BlockAtTime(time);
 
-    if (current_block_ != this) {
-      deps.append(NodeDependency(current_block_->texture_output(), time));
+    if (block != nullptr) {
+      deps.append(NodeDependency(block->texture_output(), time));
     }
   }
 
@@ -153,8 +212,24 @@ NodeOutput* TrackOutput::track_output()
 
 void TrackOutput::InvalidateCache(const rational &start_range, const rational &end_range, NodeInput *from)
 {
-  // We intercept IC signals from Blocks since we may be performing several options and they may over-signal
-  if (from == previous_input() && block_invalidate_cache_stack_ == 0) {
+  if (block_invalidate_cache_stack_ > 0 && from != track_input_) {
+    // We intercept IC signals from Blocks since we may be performing several options and they may over-signal. Each
+    // edit invalidates the exact area it changed instead, which we hold onto until all edits are done.
+    if (from != previous_input()) {
+      TimeRange range(start_range, end_range);
+
+      if (has_pending_invalidation_) {
+        range = range.CombineWith(pending_invalidation_);
+      }
+
+      pending_invalidation_ = range;
+      has_pending_invalidation_ = true;
+    }
+
+    return;
+  }
+
+  if (from == previous_input()) {
     qDebug() << "Received IC Signal:" << start_range.toDouble() << "to" << end_range.toDouble();
     qDebug() << "Limiting IC Signal To:" << qMax(start_range, rational(0)).toDouble() << "to" << qMin(end_range, in()).toDouble();
 
@@ -164,17 +239,17 @@ void TrackOutput::InvalidateCache(const rational &start_range, const rational &e
   }
 }
 
-QVariant TrackOutput::Value(NodeOutput *output, const rational &time)
+NodeValue TrackOutput::Value(NodeOutput *output, const rational &time)
 {
   if (output == track_output_) {
     // Set track output correctly
     return PtrToValue(this);
   } else if (output == texture_output()) {
-    ValidateCurrentBlock(time);
+    Block* block = BlockAtTime(time);
 
-    if (current_block_ != this) {
+    if (block != nullptr) {
       // At this point, we must have found the correct block so we use its texture output to produce the image
-      return current_block_->texture_output()->get_value(time);
+      return block->texture_output()->get_value(time);
     }
 
     // No texture is valid
@@ -189,9 +264,16 @@ void TrackOutput::InsertBlockBetweenBlocks(Block *block, Block *before, Block *a
 {
   AddBlockToGraph(block);
 
+  BlockInvalidateCache();
+
   Block::DisconnectBlocks(before, after);
   Block::ConnectBlocks(before, block);
   Block::ConnectBlocks(block, after);
+
+  // Everything from this Block onwards has moved
+  InvalidateCache(block->in(), in());
+
+  UnblockInvalidateCache();
 }
 
 void TrackOutput::InsertBlockBefore(Block* block, Block* after)
@@ -204,8 +286,14 @@ void TrackOutput::InsertBlockBefore(Block* block, Block* after)
   } else {
     AddBlockToGraph(block);
 
+    BlockInvalidateCache();
+
     // Otherwise, just connect the block since there's no before clip to insert between
     Block::ConnectBlocks(block, after);
+
+    InvalidateCache(0, in());
+
+    UnblockInvalidateCache();
   }
 }
 
@@ -221,7 +309,7 @@ void TrackOutput::PrependBlock(Block *block)
   if (block_cache_.isEmpty()) {
     ConnectBlockInternal(block);
   } else {
-    Block::ConnectBlocks(block, block_cache_.first());
+    InsertBlockBefore(block, block_cache_.first());
   }
 }
 
@@ -264,17 +352,23 @@ void TrackOutput::AppendBlock(Block *block)
     InsertBlockBetweenBlocks(block, block_cache_.last(), this);
   }
 
-  UnblockInvalidateCache();
-
   // Invalidate area that block was added to
   InvalidateCache(block->in(), in());
+
+  UnblockInvalidateCache();
 }
 
 void TrackOutput::ConnectBlockInternal(Block *block)
 {
   AddBlockToGraph(block);
 
+  BlockInvalidateCache();
+
   Block::ConnectBlocks(block, this);
+
+  InvalidateCache(0, in());
+
+  UnblockInvalidateCache();
 }
 
 void TrackOutput::AddBlockToGraph(Block *block)
@@ -284,45 +378,86 @@ void TrackOutput::AddBlockToGraph(Block *block)
   graph->AddNodeWithDependencies(block);
 }
 
-void TrackOutput::ValidateCurrentBlock(const rational &time)
+void TrackOutput::BlockInvalidateCache()
 {
-  // This node representso the end of the timeline, so being beyond its in point is considered the end of the sequence
-  if (time >= in()) {
-    current_block_ = this;
-    return;
-  }
+  block_invalidate_cache_stack_++;
+}
+
+void TrackOutput::UnblockInvalidateCache()
+{
+  block_invalidate_cache_stack_--;
 
-  // If we're here, we need to find the current clip to display
+  if (block_invalidate_cache_stack_ == 0) {
+    FlushRefresh();
 
-  // If the time requested is an earlier Block, traverse earlier until we find it
-  while (time < current_block_->in()) {
-    current_block_ = current_block_->previous();
+    if (has_pending_invalidation_) {
+      has_pending_invalidation_ = false;
+
+      InvalidateCache(pending_invalidation_.in(), pending_invalidation_.out());
+    }
   }
+}
 
-  // If the time requested is in a later Block, traverse later
-  while (time >= current_block_->out()) {
-    current_block_ = current_block_->next();
+bool TrackOutput::TakePendingInvalidation(TimeRange *range)
+{
+  if (!has_pending_invalidation_) {
+    return false;
   }
+
+  *range = pending_invalidation_;
+  has_pending_invalidation_ = false;
+
+  return true;
 }
 
-void TrackOutput::BlockInvalidateCache()
+const QVector<Block *> &TrackOutput::Blocks()
 {
-  block_invalidate_cache_stack_++;
+  return block_cache_;
 }
 
-void TrackOutput::UnblockInvalidateCache()
+void TrackOutput::QueueRefresh(int index)
 {
-  block_invalidate_cache_stack_--;
+  if (pending_refresh_index_ == -1 || index < pending_refresh_index_) {
+    pending_refresh_index_ = index;
+  }
+
+  if (block_invalidate_cache_stack_ == 0) {
+    FlushRefresh();
+  }
+}
+
+void TrackOutput::FlushRefresh()
+{
+  if (pending_refresh_index_ == -1) {
+    return;
+  }
+
+  int from = pending_refresh_index_;
+  pending_refresh_index_ = -1;
+
+  for (int i=from;i<block_cache_.size();i++) {
+    Block* b = block_cache_.at(i);
+
+    // This Block has moved, so hashes memoized at its old position no longer apply (the track's own area is
+    // invalidated by the edit itself)
+    b->ClearHashCache(RATIONAL_MIN, RATIONAL_MAX);
+
+    emit b->Refreshed();
+  }
+
+  emit Refreshed();
 }
 
 void TrackOutput::PlaceBlock(Block *block, rational start)
 {
-  if (block_cache_.contains(block) && block->in() == start) {
+  if (block_index_.contains(block) && block->in() == start) {
     return;
   }
 
   AddBlockToGraph(block);
 
+  BlockInvalidateCache();
+
   // Check if the placement location is past the end of the timeline
   if (start >= in()) {
     if (start > in()) {
@@ -333,15 +468,18 @@ void TrackOutput::PlaceBlock(Block *block, rational start)
     }
 
     AppendBlock(block);
-    return;
+  } else {
+    // Place the Block at this point
+    RippleRemoveArea(start, start + block->length(), block);
   }
 
-  // Place the Block at this point
-  RippleRemoveArea(start, start + block->length(), block);
+  UnblockInvalidateCache();
 }
 
 void TrackOutput::RemoveBlock(Block *block)
 {
+  BlockInvalidateCache();
+
   GapBlock* gap = new GapBlock();
   gap->set_length(block->length());
 
@@ -357,6 +495,8 @@ void TrackOutput::RemoveBlock(Block *block)
   } else {
     InsertBlockBetweenBlocks(gap, previous, next);
   }
+
+  UnblockInvalidateCache();
 }
 
 void TrackOutput::RippleRemoveBlock(Block *block)
@@ -365,6 +505,9 @@ void TrackOutput::RippleRemoveBlock(Block *block)
 
   rational remove_in = block->in();
 
+  // Everything after the Block moves earlier, up to the current end of the track
+  rational remove_out = in();
+
   Block* previous = block->previous();
   Block* next = block->next();
 
@@ -380,9 +523,9 @@ void TrackOutput::RippleRemoveBlock(Block *block)
     Block::ConnectBlocks(previous, next);
   }
 
-  UnblockInvalidateCache();
+  InvalidateCache(remove_in, remove_out);
 
-  InvalidateCache(remove_in, in());
+  UnblockInvalidateCache();
 
   // FIXME: Should there be removing the Blocks from the graph?
 }
@@ -415,17 +558,11 @@ Block* TrackOutput::SplitBlock(Block *block, rational time)
 void TrackOutput::SplitAtTime(rational time)
 {
   // Find Block that contains this time
-  for (int i=0;i<block_cache_.size();i++) {
-    Block* b = block_cache_.at(i);
+  Block* b = BlockAtTime(time);
 
-    if (b->out() == time) {
-      // This time is between blocks, no split needs to occur
-      return;
-    } else if (b->in() < time && b->out() > time) {
-      // We found the Block, split it
-      SplitBlock(b, time);
-      return;
-    }
+  // If this time is between blocks, no split needs to occur
+  if (b != nullptr && b->in() < time) {
+    SplitBlock(b, time);
   }
 }
 
@@ -443,8 +580,10 @@ void TrackOutput::RippleRemoveArea(rational in, rational out, Block *insert)
   // Blocks that are entirely within the area and need removing
   QList<Block*> remove;
 
-  // Iterate through blocks determining which need trimming/removing/splitting
-  foreach (Block* block, block_cache_) {
+  // Iterate through blocks around this area determining which need trimming/removing/splitting
+  QVector<Block*> area_blocks = BlocksInRange(in, out);
+
+  foreach (Block* block, area_blocks) {
     if (block->in() < in && block->out() > out) {
       // The area entirely within this Block
       splice = block;
@@ -512,9 +651,9 @@ void TrackOutput::RippleRemoveArea(rational in, rational out, Block *insert)
     }
   }
 
-  UnblockInvalidateCache();
-
   InvalidateCache(in, out);
+
+  UnblockInvalidateCache();
 }
 
 void TrackOutput::ReplaceBlock(Block *old, Block *replace)
@@ -539,7 +678,99 @@ void TrackOutput::ReplaceBlock(Block *old, Block *replace)
     Block::ConnectBlocks(replace, next);
   }
 
+  InvalidateCache(replace->in(), replace->out());
+
   UnblockInvalidateCache();
+}
 
-  InvalidateCache(replace->in(), replace->out());
+Block *TrackOutput::BlockAtTime(const rational &time)
+{
+  Block* block = nullptr;
+
+  layout_lock_.lock();
+
+  int index = GetBlockIndexAtTime(time);
+
+  if (index != -1) {
+    block = block_cache_.at(index);
+  }
+
+  layout_lock_.unlock();
+
+  return block;
+}
+
+QVector<Block *> TrackOutput::BlocksInRange(const rational &in, const rational &out)
+{
+  QVector<Block*> blocks;
+
+  for (int i=GetFirstBlockIndexEndingAtOrAfter(in);i<block_cache_.size();i++) {
+    Block* b = block_cache_.at(i);
+
+    if (b->in() > out) {
+      break;
+    }
+
+    blocks.append(b);
+  }
+
+  return blocks;
+}
+
+int TrackOutput::GetBlockIndexAtTime(const rational &time)
+{
+  if (time < 0 || time >= lengths_.Total()) {
+    return -1;
+  }
+
+  // The number of Blocks that end at or before this time is the index of the Block playing at it (this also skips any
+  // zero-length Blocks at this time)
+  return lengths_.UpperBound(time);
+}
+
+int TrackOutput::GetFirstBlockIndexEndingAtOrAfter(const rational &time)
+{
+  return lengths_.LowerBound(time);
+}
+
+rational TrackOutput::GetBlockInPoint(Block *block)
+{
+  rational in_point;
+
+  layout_lock_.lock();
+
+  if (block == this) {
+    in_point = lengths_.Total();
+  } else {
+    in_point = lengths_.PrefixSum(block_index_.value(block));
+  }
+
+  layout_lock_.unlock();
+
+  return in_point;
+}
+
+void TrackOutput::BlockLengthChanged(Block *block)
+{
+  // Only the main thread changes the layout so it can be read here without locking
+  QHash<Block*, int>::const_iterator i = block_index_.constFind(block);
+
+  if (i == block_index_.constEnd()) {
+    return;
+  }
+
+  int index = i.value();
+
+  // Block::length() takes the Block's own lock, so don't hold both at once
+  rational length = block->length();
+
+  layout_lock_.lock();
+
+  lengths_.Set(index, length);
+
+  layout_lock_.unlock();
+
+  BumpEditVersion();
+
+  QueueRefresh(index);
 }
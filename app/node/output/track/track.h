@@ -21,6 +21,8 @@
 #ifndef TRACKOUTPUT_H
 #define TRACKOUTPUT_H
 
+#include "common/fenwicktree.h"
+#include "common/timerange.h"
 #include "node/block/block.h"
 #include "panel/timeline/timeline.h"
 
@@ -33,6 +35,8 @@ class TrackOutput : public Block
 public:
   TrackOutput();
 
+  virtual ~TrackOutput() override;
+
   virtual Type type() override;
 
   virtual Block* copy() override;
@@ -47,7 +51,10 @@ public:
   virtual void Refresh() override;
 
   /**
-   * @brief Override swaps "attached block" with "current block"
+   * @brief Override swaps "attached block" with the Block playing at `time`
+   *
+   * The Block is looked up on every call rather than remembered, so hashing and rendering (possibly on several threads
+   * at once) never modify the track.
    */
   virtual QList<NodeDependency> RunDependencies(NodeOutput* param, const rational& time) override;
 
@@ -151,6 +158,67 @@ public:
    */
   void ReplaceBlock(Block* old, Block* replace);
 
+  /**
+   * @brief Return the Block playing at `time`, or nullptr if there isn't one
+   *
+   * This is a search of the Block lengths in O(log n).
+   *
+   * This function is thread-safe.
+   */
+  Block* BlockAtTime(const rational& time);
+
+  /**
+   * @brief Return all Blocks that touch the area between `in` and `out` (inclusive), in order
+   *
+   * This function is NOT thread-safe and should only be called in the main thread.
+   */
+  QVector<Block*> BlocksInRange(const rational& in, const rational& out);
+
+  /**
+   * @brief Return the in point of an attached Block in O(log n)
+   *
+   * The in point of the TrackOutput itself is the end of the last Block.
+   *
+   * This function is thread-safe.
+   */
+  rational GetBlockInPoint(Block* block);
+
+  /**
+   * @brief Update the position of every Block after `block` when its length changes
+   *
+   * Called by Block::set_length().
+   */
+  void BlockLengthChanged(Block* block);
+
+  /**
+   * @brief Start a group of edits that should only invalidate the cache (and emit Refreshed()) once
+   *
+   * Calls can be nested, nothing is sent until the outermost UnblockInvalidateCache(). While blocked, invalidations
+   * coming from the Blocks themselves are ignored (Block edges over-signal), each edit function invalidates the exact
+   * area it changed instead and those areas are merged into one.
+   */
+  void BlockInvalidateCache();
+
+  /**
+   * @brief End a group of edits started with BlockInvalidateCache()
+   */
+  void UnblockInvalidateCache();
+
+  /**
+   * @brief Take the area waiting to be invalidated, so the caller can invalidate it itself
+   *
+   * Used by TimelineOutput to merge the invalidations of several tracks into one. Returns false if there is nothing
+   * waiting.
+   */
+  bool TakePendingInvalidation(TimeRange* range);
+
+  /**
+   * @brief Return the Blocks attached to this track in order
+   *
+   * This function is NOT thread-safe and should only be called in the main thread.
+   */
+  const QVector<Block*>& Blocks();
+
 signals:
   /**
    * @brief Signal emitted when a Block is added to this Track
@@ -163,7 +231,7 @@ signals:
   void BlockRemoved(Block* block);
 
 protected:
-  virtual QVariant Value(NodeOutput* output, const rational& time) override;
+  virtual NodeValue Value(NodeOutput* output, const rational& time) override;
 
 private:
   /**
@@ -184,16 +252,56 @@ private:
   void AddBlockToGraph(Block* block);
 
   /**
-   * @brief Sets current_block_ to the correct attached Block based on `time`
+   * @brief Return the index in block_cache_ of the Block playing at `time`, or -1 if there isn't one
+   *
+   * Must be called with layout_lock_ held.
    */
-  void ValidateCurrentBlock(const rational& time);
+  int GetBlockIndexAtTime(const rational& time);
 
-  void BlockInvalidateCache();
-  void UnblockInvalidateCache();
+  /**
+   * @brief Return the index in block_cache_ of the first Block whose out point is at or after `time`
+   */
+  int GetFirstBlockIndexEndingAtOrAfter(const rational& time);
 
+  /**
+   * @brief Mark every Block from `index` onwards as moved
+   *
+   * Their Refreshed() signals are emitted once the current edit is done (see UnblockInvalidateCache()).
+   */
+  void QueueRefresh(int index);
+
+  /**
+   * @brief Emit Refreshed() for every Block that moved since the last call
+   *
+   * Also clears those Blocks' memoized hashes, since they were worked out for the Blocks' old positions.
+   */
+  void FlushRefresh();
+
+  /**
+   * @brief Attached Blocks in order
+   */
   QVector<Block*> block_cache_;
 
-  Block* current_block_;
+  /**
+   * @brief The lengths of the Blocks in block_cache_
+   *
+   * Each Block's in point is the sum of the lengths of all the Blocks before it, so keeping them in a Fenwick tree
+   * makes both changing a length and looking up an in/out point O(log n).
+   */
+  FenwickTree<rational> lengths_;
+
+  /**
+   * @brief Each attached Block's index in block_cache_
+   */
+  QHash<Block*, int> block_index_;
+
+  /**
+   * @brief Protects block_cache_, lengths_ and block_index_
+   *
+   * Render threads look up Blocks and in points while the main thread edits the track. Only the main thread ever
+   * changes them, so it takes this lock to write but can read them without it.
+   */
+  QMutex layout_lock_;
 
   NodeInput* track_input_;
 
@@ -201,6 +309,18 @@ private:
 
   int block_invalidate_cache_stack_;
 
+  /**
+   * @brief Area to invalidate once the outermost UnblockInvalidateCache() is reached
+   */
+  TimeRange pending_invalidation_;
+
+  bool has_pending_invalidation_;
+
+  /**
+   * @brief The first index in block_cache_ waiting for FlushRefresh(), or -1 if none are
+   */
+  int pending_refresh_index_;
+
 private slots:
 
 };
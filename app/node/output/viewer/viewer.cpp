@@ -69,7 +69,7 @@ void ViewerOutput::AttachViewer(ViewerPanel *viewer)
     disconnect(attached_viewer_, SIGNAL(TimeChanged(const rational&)), this, SLOT(ViewerTimeChanged(const rational&)));
 
     // Clear any existing texture
-    attached_viewer_->SetTexture(0);
+    attached_viewer_->SetTexture(nullptr);
   }
 
   // FIXME: Currently this attaches to ViewerPanels, but should it attached to Viewers instead?
@@ -102,7 +102,7 @@ void ViewerOutput::ForceUpdateViewer()
   ViewerTimeChanged(attached_viewer_->GetTime());
 }
 
-QVariant ViewerOutput::Value(NodeOutput *output, const rational &time)
+NodeValue ViewerOutput::Value(NodeOutput *output, const rational &time)
 {
   Q_UNUSED(output)
   Q_UNUSED(time)
@@ -116,9 +116,5 @@ void ViewerOutput::ViewerTimeChanged(const rational &t)
   RenderTexturePtr current_texture = texture_input_->get_value(t).value<RenderTexturePtr>();
 
   // Send the texture to the Viewer
-  if (current_texture != nullptr) {
-    attached_viewer_->SetTexture(current_texture->texture());
-  } else {
-    attached_viewer_->SetTexture(0);
-  }
+  attached_viewer_->SetTexture(current_texture);
 }
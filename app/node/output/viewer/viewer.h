@@ -50,7 +50,7 @@ public:
   virtual void InvalidateCache(const rational &start_range, const rational &end_range, NodeInput *from = nullptr) override;
 
 protected:
-  virtual QVariant Value(NodeOutput* output, const rational& time) override;
+  virtual NodeValue Value(NodeOutput* output, const rational& time) override;
 
 private:
   void ForceUpdateViewer();
@@ -30,10 +30,27 @@
 #include "node/node.h"
 #include "node/input.h"
 #include "node/output.h"
+#include "project/item/footage/footage.h"
+
+/**
+ * @brief Default number of values each parameter keeps cached
+ */
+const int kValueCacheSize = 8;
+
+/**
+ * @brief Number of values each texture parameter keeps cached
+ *
+ * Every cached texture is a full frame kept alive on the GPU (and out of the ImageCache pool), so only the newest one
+ * is kept.
+ */
+const int kTextureValueCacheSize = 1;
 
 NodeParam::NodeParam(const QString &id) :
-  time_(-1),
+  edges_(std::make_shared<const QVector<NodeEdgePtr> >()),
   value_caching_(true),
+  value_cache_size_(kValueCacheSize),
+  value_cache_epoch_(0),
+  time_(-1),
   id_(id)
 {
   Q_ASSERT(!id_.isEmpty());
@@ -70,12 +87,17 @@ int NodeParam::index()
 
 bool NodeParam::IsConnected()
 {
-  return !edges_.isEmpty();
+  return !edges().isEmpty();
 }
 
-const QVector<NodeEdgePtr> &NodeParam::edges()
+QVector<NodeEdgePtr> NodeParam::edges()
 {
-  return edges_;
+  return *std::atomic_load(&edges_);
+}
+
+void NodeParam::PublishEdges(const QVector<NodeEdgePtr> &edges)
+{
+  std::atomic_store(&edges_, std::make_shared<const QVector<NodeEdgePtr> >(edges));
 }
 
 bool NodeParam::AreDataTypesCompatible(NodeParam *a, NodeParam *b)
@@ -159,17 +181,13 @@ NodeEdgePtr NodeParam::ConnectEdge(NodeOutput *output, NodeInput *input)
 
   NodeEdgePtr edge = std::make_shared<NodeEdge>(output, input);
 
-  output->parent()->Lock();
-  input->parent()->Lock();
+  output->PublishEdges(output->edges() << edge);
+  input->PublishEdges(input->edges() << edge);
 
-  output->edges_.append(edge);
-  input->edges_.append(edge);
+  input->parent()->BumpEditVersion();
 
   input->ClearCachedValue();
 
-  output->parent()->Unlock();
-  input->parent()->Unlock();
-
   // Emit a signal than an edge was added (only one signal needs emitting)
   emit input->EdgeAdded(edge);
 
@@ -181,24 +199,27 @@ void NodeParam::DisconnectEdge(NodeEdgePtr edge)
   NodeOutput* output = edge->output();
   NodeInput* input = edge->input();
 
-  output->parent()->Lock();
-  input->parent()->Lock();
+  QVector<NodeEdgePtr> output_edges = output->edges();
+  output_edges.removeAll(edge);
+  output->PublishEdges(output_edges);
 
-  output->edges_.removeAll(edge);
-  input->edges_.removeAll(edge);
+  QVector<NodeEdgePtr> input_edges = input->edges();
+  input_edges.removeAll(edge);
+  input->PublishEdges(input_edges);
 
-  input->ClearCachedValue();
+  input->parent()->BumpEditVersion();
 
-  output->parent()->Unlock();
-  input->parent()->Unlock();
+  input->ClearCachedValue();
 
   emit input->EdgeRemoved(edge);
 }
 
 void NodeParam::DisconnectEdge(NodeOutput *output, NodeInput *input)
 {
-  for (int i=0;i<output->edges_.size();i++) {
-    NodeEdgePtr edge = output->edges_.at(i);
+  QVector<NodeEdgePtr> edges = output->edges();
+
+  for (int i=0;i<edges.size();i++) {
+    NodeEdgePtr edge = edges.at(i);
     if (edge->input() == input) {
       DisconnectEdge(edge);
       break;
@@ -209,8 +230,10 @@ void NodeParam::DisconnectEdge(NodeOutput *output, NodeInput *input)
 NodeEdgePtr NodeParam::DisconnectForNewOutput(NodeInput *input)
 {
   // If the input can only accept one input (the default) and has one already, disconnect it
-  if (!input->edges_.isEmpty()) {
-    NodeEdgePtr edge = input->edges_.first();
+  QVector<NodeEdgePtr> edges = input->edges();
+
+  if (!edges.isEmpty()) {
+    NodeEdgePtr edge = edges.first();
 
     DisconnectEdge(edge);
 
@@ -246,23 +269,26 @@ QString NodeParam::GetDefaultDataTypeName(const DataType& type)
   return QString();
 }
 
-QByteArray NodeParam::ValueToBytes(const NodeParam::DataType &type, const QVariant &value)
+QByteArray NodeParam::ValueToBytes(const NodeParam::DataType &type, const NodeValue &value)
 {
   switch (type) {
   case kInt: return ValueToBytesInternal<int>(value);
   case kFloat: return ValueToBytesInternal<float>(value);
   case kColor: return ValueToBytesInternal<QColor>(value);
-  case kString: return ValueToBytesInternal<QString>(value);
   case kBoolean: return ValueToBytesInternal<bool>(value);
-  case kFont: return ValueToBytesInternal<QString>(value); // FIXME: This should probably be a QFont?
-  case kFile: return ValueToBytesInternal<QString>(value);
   case kMatrix: return ValueToBytesInternal<QMatrix4x4>(value);
-  case kFootage: return ValueToBytesInternal<float>(value); // FIXME: Unsustainble, find some other way to match Footage
+  case kFootage: return FootageToBytes(value);
   case kRational: return ValueToBytesInternal<rational>(value);
   case kVec2: return ValueToBytesInternal<QVector2D>(value);
   case kVec3: return ValueToBytesInternal<QVector3D>(value);
   case kVec4: return ValueToBytesInternal<QVector4D>(value);
 
+  // Strings have to be hashed by their contents rather than their bytes
+  case kString:
+  case kFont: // FIXME: This should probably be a QFont?
+  case kFile:
+    return value.toString().toUtf8();
+
   // These types have no persistent input
   case kNone:
   case kTexture:
@@ -275,15 +301,96 @@ QByteArray NodeParam::ValueToBytes(const NodeParam::DataType &type, const QVaria
   return QByteArray();
 }
 
+QByteArray NodeParam::FootageToBytes(const NodeValue &value)
+{
+  Footage* footage = static_cast<Footage*>(const_cast<void*>(value.value<const void*>()));
+
+  if (footage == nullptr) {
+    return QByteArray();
+  }
+
+  // Identify the file rather than the Footage's address, so hashes stay valid in later sessions and never match a
+  // different file that happens to be allocated at the same address
+  QByteArray bytes = footage->filename().toUtf8();
+  bytes.append('\0');
+  bytes.append(QByteArray::number(footage->file_size()));
+  bytes.append('\0');
+  bytes.append(QByteArray::number(footage->timestamp().toMSecsSinceEpoch()));
+
+  return bytes;
+}
+
 void NodeParam::ClearCachedValue()
 {
-  // Since get_value() will (read: should) never receive a negative number, this will effectively invalidate any value
-  // currently cached
-  time_ = -1;
+  value_cache_lock_.lock();
+
+  value_cache_.clear();
+  value_cache_epoch_++;
+
+  value_cache_lock_.unlock();
+}
+
+void NodeParam::ClearCachedValues(const rational &start_range, const rational &end_range)
+{
+  value_cache_lock_.lock();
+
+  QMap<rational, NodeValue>::iterator i = value_cache_.lowerBound(start_range);
+
+  while (i != value_cache_.end() && i.key() <= end_range) {
+    i = value_cache_.erase(i);
+  }
+
+  value_cache_epoch_++;
+
+  value_cache_lock_.unlock();
+}
+
+bool NodeParam::GetCachedValue(const rational &time, NodeValue *value, int *epoch, bool any_time)
+{
+  QMutexLocker locker(&value_cache_lock_);
+
+  time_ = time;
+
+  QMap<rational, NodeValue>::const_iterator i = value_cache_.constFind(time);
+
+  if (i == value_cache_.constEnd() && any_time && !value_cache_.isEmpty()) {
+    i = value_cache_.constBegin();
+  }
+
+  if (i != value_cache_.constEnd()) {
+    *value = i.value();
+    return true;
+  }
+
+  *epoch = value_cache_epoch_;
+
+  return false;
+}
+
+void NodeParam::CacheValue(const rational &time, const NodeValue &value, int epoch)
+{
+  QMutexLocker locker(&value_cache_lock_);
+
+  if (epoch != -1 && epoch != value_cache_epoch_) {
+    return;
+  }
+
+  value_cache_.insert(time, value);
+
+  // Drop whichever end is furthest from the value we just added
+  while (value_cache_.size() > value_cache_size_) {
+    if (qAbs(time - value_cache_.firstKey()) > qAbs(value_cache_.lastKey() - time)) {
+      value_cache_.erase(value_cache_.begin());
+    } else {
+      value_cache_.erase(--value_cache_.end());
+    }
+  }
 }
 
-const rational &NodeParam::LastRequestedTime()
+rational NodeParam::LastRequestedTime()
 {
+  QMutexLocker locker(&value_cache_lock_);
+
   return time_;
 }
 
@@ -295,10 +402,36 @@ bool NodeParam::ValueCachingEnabled()
 void NodeParam::SetValueCachingEnabled(bool enabled)
 {
   value_caching_ = enabled;
+
+  if (!value_caching_) {
+    ClearCachedValue();
+  }
+}
+
+int NodeParam::DefaultValueCacheSize(const NodeParam::DataType &type)
+{
+  if (type == kTexture) {
+    return kTextureValueCacheSize;
+  }
+
+  return kValueCacheSize;
+}
+
+void NodeParam::SetValueCacheSize(int size)
+{
+  value_cache_lock_.lock();
+
+  value_cache_size_ = qMax(1, size);
+
+  while (value_cache_.size() > value_cache_size_) {
+    value_cache_.erase(value_cache_.begin());
+  }
+
+  value_cache_lock_.unlock();
 }
 
 template<typename T>
-QByteArray NodeParam::ValueToBytesInternal(const QVariant &v)
+QByteArray NodeParam::ValueToBytesInternal(const NodeValue &v)
 {
   QByteArray bytes;
 
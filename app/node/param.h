@@ -21,6 +21,8 @@
 #ifndef NODEPARAM_H
 #define NODEPARAM_H
 
+#include <memory>
+#include <QMap>
 #include <QMutex>
 #include <QObject>
 #include <QVariant>
@@ -28,6 +30,7 @@
 
 #include "common/rational.h"
 #include "node/edge.h"
+#include "node/value.h"
 
 class Node;
 
@@ -155,7 +158,7 @@ public:
    *
    * This list can't be modified directly. Use ConnectEdge() and DisconnectEdge() instead for that.
    */
-  const QVector<NodeEdgePtr>& edges();
+  QVector<NodeEdgePtr> edges();
 
   /**
    * @brief Determine whether two DataTypes are compatible and therefore whether two NodeParams can be connected
@@ -243,21 +246,39 @@ public:
   /**
    * @brief Convert a value from a NodeParam into bytes
    */
-  static QByteArray ValueToBytes(const DataType &type, const QVariant& value);
+  static QByteArray ValueToBytes(const DataType &type, const NodeValue& value);
 
   /**
-   * @brief Clear the cached value
+   * @brief Clear all cached values
    */
   void ClearCachedValue();
 
+  /**
+   * @brief Clear any cached values between start_range and end_range (inclusive)
+   */
+  void ClearCachedValues(const rational& start_range, const rational& end_range);
+
   /**
    * @brief Retrieve the last time this parameter had a value requested from
    */
-  const rational& LastRequestedTime();
+  rational LastRequestedTime();
 
   bool ValueCachingEnabled();
   void SetValueCachingEnabled(bool enabled);
 
+  /**
+   * @brief Set how many values (at different times) this parameter keeps cached
+   *
+   * Defaults to enough that several threads evaluating this parameter at different times don't evict each other, except
+   * for textures which only keep one (see DefaultValueCacheSize()).
+   */
+  void SetValueCacheSize(int size);
+
+  /**
+   * @brief Return how many values a parameter of this type keeps cached unless SetValueCacheSize() is called
+   */
+  static int DefaultValueCacheSize(const DataType& type);
+
   virtual DataType data_type() = 0;
 
 signals:
@@ -279,19 +300,36 @@ signals:
 
 protected:
   /**
-   * @brief Internal list of edges
+   * @brief Replace this parameter's edges
+   *
+   * Edges are never modified in place. A new list is published atomically so render threads can read the current
+   * one without locking.
    */
-  QVector<NodeEdgePtr> edges_;
+  void PublishEdges(const QVector<NodeEdgePtr>& edges);
 
   /**
-   * @brief Currently cached value
+   * @brief Internal list of edges (see PublishEdges())
    */
-  QVariant value_;
+  std::shared_ptr<const QVector<NodeEdgePtr> > edges_;
 
   /**
-   * @brief Last timecode that a value was requested with
+   * @brief Retrieve a cached value at this time
+   *
+   * This function is thread-safe and also records `time` as the last requested time. If nothing is cached, `epoch` is
+   * set to the current cache epoch, which should be passed to CacheValue() once the value has been worked out.
+   *
+   * If `any_time` is true and nothing is cached at this time, a value cached at any other time is returned instead
+   * (for values that are the same at every time).
    */
-  rational time_;
+  bool GetCachedValue(const rational& time, NodeValue* value, int* epoch, bool any_time = false);
+
+  /**
+   * @brief Cache a value at this time
+   *
+   * If the cache was cleared since `epoch` was retrieved from GetCachedValue(), the value may have been worked out from
+   * data that's now out of date, so it's not stored. An epoch of -1 always stores the value.
+   */
+  void CacheValue(const rational& time, const NodeValue& value, int epoch = -1);
 
   /**
    * @brief Internal value for whether value caching is enabled
@@ -303,7 +341,34 @@ private:
    * @brief Internal function for returning a value in the form of bytes
    */
   template<typename T>
-  static QByteArray ValueToBytesInternal(const QVariant& v);
+  static QByteArray ValueToBytesInternal(const NodeValue& v);
+
+  /**
+   * @brief Internal function for identifying a Footage by its file (path, size and modification time)
+   */
+  static QByteArray FootageToBytes(const NodeValue& value);
+
+  /**
+   * @brief Cached values keyed by time, protected by value_cache_lock_
+   */
+  QMap<rational, NodeValue> value_cache_;
+
+  QMutex value_cache_lock_;
+
+  /**
+   * @brief Maximum size of value_cache_
+   */
+  int value_cache_size_;
+
+  /**
+   * @brief Incremented every time value_cache_ is cleared (see CacheValue())
+   */
+  int value_cache_epoch_;
+
+  /**
+   * @brief Last timecode that a value was requested with
+   */
+  rational time_;
 
   /**
    * @brief Internal name string
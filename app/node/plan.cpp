@@ -0,0 +1,205 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "plan.h"
+
+namespace {
+
+enum StepState {
+  kStepUnused,
+  kStepNeeded,
+
+  /// Needed at more than one time, so it can't be evaluated in advance
+  kStepConflict,
+
+  /// Evaluated, its value is in its slot
+  kStepDone
+};
+
+/**
+ * @brief Per-run state of a NodePlan, kept on the stack of the thread running it
+ */
+struct RunState {
+  const NodePlan* plan;
+  QVector<NodeValue> slots;
+  QVector<rational> times;
+  QVector<int> states;
+};
+
+/**
+ * @brief The run in progress on this thread, if any
+ */
+thread_local const RunState* running_state = nullptr;
+
+}
+
+NodePlan::NodePlan(NodeOutput *root) :
+  root_(root),
+  graph_(qobject_cast<NodeGraph*>(root->parent()->parent())),
+  edge_version_(graph_ ? graph_->EdgeVersion() : 0)
+{
+  AddStep(root_);
+
+  dependencies_ = root_->parent()->GetDependencies();
+}
+
+NodeOutput *NodePlan::root() const
+{
+  return root_;
+}
+
+const QList<Node *> &NodePlan::dependencies() const
+{
+  return dependencies_;
+}
+
+bool NodePlan::IsValid() const
+{
+  // Without a graph there's nothing telling us when the connections change, so never reuse the plan
+  return (graph_ != nullptr && edge_version_ == graph_->EdgeVersion());
+}
+
+int NodePlan::EditVersion() const
+{
+  int version = root_->parent()->EditVersion();
+
+  foreach (Node* dep, dependencies_) {
+    version += dep->EditVersion();
+  }
+
+  return version;
+}
+
+NodeValue NodePlan::Run(const rational &time) const
+{
+  int count = steps_.size();
+
+  RunState state;
+  state.plan = this;
+  state.slots.resize(count);
+  state.times.resize(count);
+  state.states.fill(kStepUnused, count);
+
+  // The root is always the last step
+  state.times[count - 1] = time;
+  state.states[count - 1] = kStepNeeded;
+
+  // Work out which steps are needed and at what time. Every step's dependents come after it, so by the time we reach
+  // a step, everything that could need it has already been visited.
+  for (int i=count-1;i>=0;i--) {
+    if (state.states.at(i) != kStepNeeded) {
+      continue;
+    }
+
+    const Step& step = steps_.at(i);
+    Node* node = step.output->parent();
+
+    foreach (const StepInput& input, step.inputs) {
+      rational input_time;
+
+      if (!node->GetInputTime(step.output, input.input, state.times.at(i), &input_time)) {
+        continue;
+      }
+
+      if (state.states.at(input.step) == kStepUnused) {
+        state.states[input.step] = kStepNeeded;
+        state.times[input.step] = input_time;
+      } else if (state.times.at(input.step) != input_time) {
+        state.states[input.step] = kStepConflict;
+      }
+    }
+  }
+
+  // Evaluate from the leaves up. While this plan is running, each step's inputs are read from the slots of the steps
+  // before it (see GetRunningValue()).
+  const RunState* outer_state = running_state;
+  running_state = &state;
+
+  for (int i=0;i<count;i++) {
+    if (state.states.at(i) == kStepNeeded) {
+      state.slots[i] = steps_.at(i).output->get_value(state.times.at(i));
+      state.states[i] = kStepDone;
+    }
+  }
+
+  running_state = outer_state;
+
+  return state.slots.at(count - 1);
+}
+
+bool NodePlan::GetRunningValue(NodeOutput *output, const rational &time, NodeValue *value)
+{
+  if (running_state == nullptr) {
+    return false;
+  }
+
+  int index = running_state->plan->step_index_.value(output, -1);
+
+  if (index < 0
+      || running_state->states.at(index) != kStepDone
+      || running_state->times.at(index) != time) {
+    return false;
+  }
+
+  *value = running_state->slots.at(index);
+
+  return true;
+}
+
+void NodePlan::AddStep(NodeOutput *output)
+{
+  if (step_index_.contains(output)) {
+    return;
+  }
+
+  // Mark as visited before recursing in case there's a cycle
+  step_index_.insert(output, -1);
+
+  Step step;
+  step.output = output;
+
+  QList<NodeParam*> params = output->parent()->parameters();
+
+  foreach (NodeParam* param, params) {
+    if (param->type() != NodeParam::kInput) {
+      continue;
+    }
+
+    NodeInput* input = static_cast<NodeInput*>(param);
+    NodeOutput* connected = input->get_connected_output();
+
+    // Inputs that aren't dependent (e.g. links between Blocks) are only read on demand
+    if (connected == nullptr || !input->dependent()) {
+      continue;
+    }
+
+    AddStep(connected);
+
+    // Still -1 if this input is part of a cycle
+    int connected_index = step_index_.value(connected);
+
+    if (connected_index >= 0) {
+      step.inputs.append({input, connected_index});
+    }
+  }
+
+  step_index_.insert(output, steps_.size());
+  steps_.append(step);
+}
@@ -0,0 +1,124 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef NODEPLAN_H
+#define NODEPLAN_H
+
+#include <memory>
+#include <QHash>
+#include <QPointer>
+#include <QVector>
+
+#include "node/graph.h"
+#include "node/node.h"
+
+/**
+ * @brief A compiled, flat execution plan for the sub-graph feeding an output
+ *
+ * Compiling walks the graph once and stores every output the root depends on in topological order (dependencies
+ * before dependents, the root last), along with which earlier step feeds each of their inputs. Running the plan works
+ * out which of those steps are needed at a given time from the root down, then evaluates them from the leaves up into
+ * one slot per step. Every input connected to a step reads that step's slot, so nothing is traversed recursively per
+ * frame.
+ *
+ * Plans only depend on the graph's connections, so they stay valid until an edge in the root's graph is added or
+ * removed (see IsValid()).
+ */
+class NodePlan
+{
+public:
+  NodePlan(NodeOutput* root);
+
+  NodeOutput* root() const;
+
+  /**
+   * @brief Every Node the root's Node depends on, in the same order as Node::GetDependencies()
+   */
+  const QList<Node*>& dependencies() const;
+
+  /**
+   * @brief Returns FALSE if the graph's connections have changed since this plan was compiled
+   */
+  bool IsValid() const;
+
+  /**
+   * @brief Return the combined edit version of every Node in this plan (see Node::EditVersion())
+   *
+   * This only ever increases, so if it's different after running the plan than before, something was edited while
+   * it ran.
+   */
+  int EditVersion() const;
+
+  /**
+   * @brief Evaluate the root at the given time and return its value
+   *
+   * Steps that turn out to be needed at more than one time, and outputs that aren't part of the plan (e.g. the Block a
+   * TrackOutput picks at `time`), are evaluated on demand as usual.
+   *
+   * This function is thread-safe, several threads can run the same plan at once.
+   */
+  NodeValue Run(const rational& time) const;
+
+  /**
+   * @brief Retrieve the value of `output` at `time` if a plan running on this thread has already evaluated it
+   *
+   * Called by NodeOutput::get_value() so that inputs read the slots of a running plan.
+   */
+  static bool GetRunningValue(NodeOutput* output, const rational& time, NodeValue* value);
+
+private:
+  /**
+   * @brief A connected input of a step and the index of the step that feeds it
+   */
+  struct StepInput {
+    NodeInput* input;
+    int step;
+  };
+
+  struct Step {
+    NodeOutput* output;
+    QVector<StepInput> inputs;
+  };
+
+  void AddStep(NodeOutput* output);
+
+  NodeOutput* root_;
+
+  /**
+   * @brief Every output the root depends on in topological order
+   */
+  QVector<Step> steps_;
+
+  QHash<NodeOutput*, int> step_index_;
+
+  QList<Node*> dependencies_;
+
+  /**
+   * @brief The graph the root belongs to, whose EdgeVersion() was `edge_version_` when this plan was compiled
+   */
+  QPointer<NodeGraph> graph_;
+
+  int edge_version_;
+
+};
+
+using NodePlanPtr = std::shared_ptr<NodePlan>;
+
+#endif // NODEPLAN_H
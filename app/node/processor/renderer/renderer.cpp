@@ -20,23 +20,33 @@
 
 #include "renderer.h"
 
-#include <OpenImageIO/imageio.h>
 #include <QApplication>
 #include <QCryptographicHash>
-#include <QDateTime>
 #include <QDebug>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QtMath>
 
 #include "common/filefunctions.h"
+#include "config/config.h"
+#include "render/gl/shadercache.h"
 #include "render/pixelservice.h"
 
+/**
+ * @brief Maximum time (in milliseconds) the hashing pass may run for before returning to the event loop
+ */
+const qint64 kHashPassSliceMs = 10;
+
 RendererProcessor::RendererProcessor() :
   started_(false),
   width_(0),
   height_(0),
   divider_(1),
-  caching_(false)
+  caching_(false),
+  interactive_caching_(false),
+  memory_cache_(kFrameMemoryCacheBudget),
+  playback_direction_(1),
+  generation_(0)
 {
   texture_input_ = new NodeInput("tex_in");
   texture_input_->add_data_input(NodeInput::kTexture);
@@ -48,7 +58,18 @@ RendererProcessor::RendererProcessor() :
 
   texture_output_ = new NodeOutput("tex_out");
   texture_output_->set_data_type(NodeInput::kTexture);
+
+  // Frames are pushed to this output as they're loaded (and a placeholder may be returned until then), so only the
+  // frame at the playhead is kept
+  texture_output_->SetValueCacheSize(1);
   AddParameter(texture_output_);
+
+  hash_timer_.setInterval(0);
+  connect(&hash_timer_, SIGNAL(timeout()), this, SLOT(HashNext()));
+
+  invalidate_timer_.setInterval(0);
+  invalidate_timer_.setSingleShot(true);
+  connect(&invalidate_timer_, SIGNAL(timeout()), this, SLOT(FlushInvalidations()));
 }
 
 QString RendererProcessor::Name()
@@ -71,15 +92,25 @@ QString RendererProcessor::id()
   return "org.olivevideoeditor.Olive.renderervenus";
 }
 
-void RendererProcessor::SetCacheName(const QString &s)
+const QString &RendererProcessor::cache_id() const
 {
-  cache_name_ = s;
-  cache_time_ = QDateTime::currentMSecsSinceEpoch();
+  return cache_id_;
+}
 
-  GenerateCacheIDInternal();
+FrameMemoryCache *RendererProcessor::memory_cache()
+{
+  return &memory_cache_;
 }
 
-QVariant RendererProcessor::Value(NodeOutput* output, const rational& time)
+bool RendererProcessor::AnalyzeTimeInvariance(NodeOutput *output)
+{
+  Q_UNUSED(output)
+
+  // Even if the content is static, frames are cached, loaded and pushed to the output per time
+  return false;
+}
+
+NodeValue RendererProcessor::Value(NodeOutput* output, const rational& time)
 {
   if (output == texture_output_) {
     if (!texture_input_->IsConnected()) {
@@ -97,25 +128,39 @@ QVariant RendererProcessor::Value(NodeOutput* output, const rational& time)
       return 0;
     }
 
-    // Find frame in map
-    if (time_hash_map_.contains(time)) {
-      QString fn = CachePathName(time_hash_map_[time]);
+    memory_cache_.SetPlayhead(time, timebase_);
 
-      if (QFileInfo::exists(fn)) {
-        auto in = OIIO::ImageInput::open(fn.toStdString());
+    // Work out which way the playhead is moving so we know which way to prefetch
+    if (time != last_value_time_) {
+      playback_direction_ = (time > last_value_time_) ? 1 : -1;
+      last_value_time_ = time;
+    }
 
-        if (in) {
-          in->read_image(PixelService::GetPixelFormatInfo(format_).oiio_desc, cache_frame_load_buffer_.data());
+    // Find frame in map (a frame waiting to be re-hashed may be mapped to content that's out of date)
+    if (time_hash_map_.contains(time) && !hash_queue_.contains(time)) {
+      // Make sure the loaders have started
+      Start();
 
-          in->close();
+      QByteArray hash = time_hash_map_.value(time);
 
-          master_texture_->Upload(cache_frame_load_buffer_.data());
+      QMap<rational, LoadedFrame>::const_iterator loaded = loaded_frames_.constFind(time);
 
-          return QVariant::fromValue(master_texture_);
-        } else {
-          qWarning() << "OIIO Error:" << OIIO::geterror().c_str();
-        }
+      if (loaded != loaded_frames_.constEnd() && loaded->hash == hash) {
+        shown_texture_ = loaded->texture;
+      } else {
+        // Nothing is read or decoded here, the frame will be pushed to the output once a loader has it ready
+        LoadFrame(time, hash, true);
+      }
+
+      PrefetchFrom(time);
+
+      // Until the requested frame is ready, keep showing the last one
+      if (shown_texture_ != nullptr) {
+        return NodeValue(shown_texture_);
       }
+    } else if (time >= 0 && time < length_input_->get_value(0).value<rational>()) {
+      // This frame hasn't been cached yet and the user is waiting on it, so render it ahead of anything else
+      RequestInteractive(time);
     }
   }
 
@@ -135,66 +180,182 @@ void RendererProcessor::InvalidateCache(const rational &start_range, const ratio
   texture_input_->ClearCachedValue();
   length_input_->ClearCachedValue();
 
-  // Adjust range to min/max values
-  rational start_range_adj = qMax(rational(0), start_range);
-  rational end_range_adj = qMin(length_input()->get_value(0).value<rational>(), end_range);
+  // Edits like dragging a slider invalidate many times in a row, so collect them and deal with them all at once when
+  // control returns to the event loop
+  pending_invalidations_.InsertTimeRange(TimeRange(start_range, end_range));
 
-  qDebug() << "Cache invalidated between"
-           << start_range_adj.toDouble()
-           << "and"
-           << end_range_adj.toDouble();
-
-  // Snap start_range to timebase
-  double start_range_dbl = start_range_adj.toDouble();
-  double start_range_numf = start_range_dbl * static_cast<double>(timebase_.denominator());
-  int64_t start_range_numround = qFloor(start_range_numf/static_cast<double>(timebase_.numerator())) * timebase_.numerator();
-  rational true_start_range(start_range_numround, timebase_.denominator());
+  if (!invalidate_timer_.isActive()) {
+    invalidate_timer_.start();
+  }
+}
 
-  for (rational r=true_start_range;r<=end_range_adj;r+=timebase_) {
-    // Try to order the queue from closest to the playhead to furthest
-    rational last_time = texture_output()->LastRequestedTime();
+void RendererProcessor::FlushInvalidations()
+{
+  invalidate_timer_.stop();
 
-    rational diff = r - last_time;
+  if (pending_invalidations_.isEmpty()) {
+    return;
+  }
 
-    if (diff < 0) {
-      // FIXME: Hardcoded number
-      // If the number is before the playhead, we still prioritize its closeness but not nearly as much (5:1 in this
-      // example)
-      diff = qAbs(diff) * 5;
+  QVector<TimeRange> ranges = pending_invalidations_.ranges();
+  pending_invalidations_.clear();
+
+  rational length = length_input()->get_value(0).value<rational>();
+
+  // Any job started before now for a frame in these ranges is stale
+  generation_lock_.lock();
+  generation_++;
+  generation_lock_.unlock();
+
+  foreach (const TimeRange& range, ranges) {
+    // Adjust range to min/max values
+    rational start_range_adj = qMax(rational(0), range.in());
+    rational end_range_adj = qMin(length, range.out());
+
+    qDebug() << "Cache invalidated between"
+             << start_range_adj.toDouble()
+             << "and"
+             << end_range_adj.toDouble();
+
+    // Snap start_range to timebase
+    double start_range_dbl = start_range_adj.toDouble();
+    double start_range_numf = start_range_dbl * static_cast<double>(timebase_.denominator());
+    int64_t start_range_numround = qFloor(start_range_numf/static_cast<double>(timebase_.numerator())) * timebase_.numerator();
+    rational true_start_range(start_range_numround, timebase_.denominator());
+
+    // Most edits (e.g. a ripple) only move existing content in time, so hash every frame first and only queue frames
+    // whose content doesn't exist yet for rendering
+    rational r;
+    for (r=true_start_range;r<=end_range_adj;r+=timebase_) {
+      hash_queue_.insert(r, true);
     }
 
-    bool contains = false;
-    bool added = false;
-    QLinkedList<rational>::iterator insert_iterator;
+    // `r` is now the first frame after the range
+    generation_lock_.lock();
+    SetInvalidatedGeneration(true_start_range, r, generation_);
+    generation_lock_.unlock();
+  }
 
-    for (QLinkedList<rational>::iterator i = cache_queue_.begin();i != cache_queue_.end();i++) {
-      rational compare = *i;
+  if (!hash_queue_.isEmpty() && !hash_timer_.isActive()) {
+    hash_timer_.start();
+  }
+}
 
-      if (!added) {
-        rational compare_diff = compare - last_time;
+void RendererProcessor::QueueCacheFrame(const rational &r)
+{
+  // Try to order the queue from closest to the playhead to furthest
+  rational last_time = texture_output()->LastRequestedTime();
 
-        if (compare_diff > diff) {
-          insert_iterator = i;
-          added = true;
-        }
-      }
+  rational diff = r - last_time;
+
+  if (diff < 0) {
+    // FIXME: Hardcoded number
+    // If the number is before the playhead, we still prioritize its closeness but not nearly as much (5:1 in this
+    // example)
+    diff = qAbs(diff) * 5;
+  }
+
+  bool contains = false;
+  bool added = false;
+  QLinkedList<rational>::iterator insert_iterator;
+
+  for (QLinkedList<rational>::iterator i = cache_queue_.begin();i != cache_queue_.end();i++) {
+    rational compare = *i;
+
+    if (!added) {
+      rational compare_diff = compare - last_time;
 
-      if (compare == r) {
-        contains = true;
-        break;
+      if (compare_diff > diff) {
+        insert_iterator = i;
+        added = true;
       }
     }
 
-    if (!contains) {
-      if (added) {
-        cache_queue_.insert(insert_iterator, r);
+    if (compare == r) {
+      contains = true;
+      break;
+    }
+  }
+
+  if (!contains) {
+    if (added) {
+      cache_queue_.insert(insert_iterator, r);
+    } else {
+      cache_queue_.append(r);
+    }
+  }
+}
+
+void RendererProcessor::HashNext()
+{
+  if (hash_queue_.isEmpty()) {
+    hash_timer_.stop();
+    return;
+  }
+
+  if (!texture_input_->IsConnected() || cache_id_.isEmpty()) {
+    // Nothing to hash against, these frames will be invalidated again once there is
+    hash_queue_.clear();
+    hash_timer_.stop();
+    return;
+  }
+
+  NodeOutput* output = texture_input_->get_connected_output();
+  rational playhead = texture_output_->LastRequestedTime();
+
+  bool queued_render = false;
+
+  QElapsedTimer elapsed;
+  elapsed.start();
+
+  // Hash in slices so a long invalidation doesn't freeze the UI
+  while (!hash_queue_.isEmpty() && elapsed.elapsed() < kHashPassSliceMs) {
+    // Start from the playhead so the frames the user is most likely to see next are remapped first
+    QMap<rational, bool>::iterator it = hash_queue_.lowerBound(playhead);
+    if (it == hash_queue_.end()) {
+      it = hash_queue_.begin();
+    }
+
+    rational time = it.key();
+    hash_queue_.erase(it);
+
+    // Hashing never decodes anything or modifies any Node, so it's cheap and safe to do here while render threads
+    // are busy
+    FastHash hasher;
+    hasher.addData(cache_id_.toUtf8());
+    hasher.addData(output->parent()->GetHash(output, time));
+    QByteArray hash = hasher.result();
+
+    if (HasHash(hash)) {
+      // This content already exists (most likely it was just moved), so just point this time at it
+      time_hash_map_.insert(time, hash);
+
+      if (texture_output_->IsConnected()
+          && texture_output_->LastRequestedTime() == time) {
+        texture_output_->ClearCachedValue();
+        SendInvalidateCache(time, time);
+      }
+    } else {
+      // The content at this time has changed and doesn't exist yet, so stop showing (and prefetching) the old frame
+      time_hash_map_.remove(time);
+      loaded_frames_.remove(time);
+
+      if (IsCaching(hash)) {
+        // Another frame is rendering this content right now, map it once it's done
+        DeferMap(time, hash, generation_, true);
+      } else if (time == texture_output_->LastRequestedTime()) {
+        // The user is looking at this frame, so render it ahead of the background queue
+        RequestInteractive(time);
       } else {
-        cache_queue_.append(r);
+        QueueCacheFrame(time);
+        queued_render = true;
       }
     }
   }
 
-  CacheNext();
+  if (queued_render) {
+    CacheNext();
+  }
 }
 
 void RendererProcessor::SetTimebase(const rational &timebase)
@@ -252,12 +413,21 @@ void RendererProcessor::Start()
 
   QOpenGLContext* ctx = QOpenGLContext::currentContext();
 
+  // Time thread startup (mostly creating contexts and their shader programs) to see how much the shader cache helps
+  QElapsedTimer start_timer;
+  start_timer.start();
+  olive::ShaderCacheStats shaders_before = olive::ShaderCache::GetStats();
+
   int background_thread_count = QThread::idealThreadCount();
 
   // Some OpenGL implementations (notably wgl) require the context not to be current before sharing
   QSurface* old_surface = ctx->surface();
   ctx->doneCurrent();
 
+  // Create the thread reserved for interactive requests
+  interactive_thread_ = std::make_shared<RendererProcessThread>(this, ctx, effective_width_, effective_height_, divider_, format_, mode_);
+  interactive_thread_->StartThread(QThread::NormalPriority);
+
   threads_.resize(background_thread_count);
 
   for (int i=0;i<threads_.size();i++) {
@@ -273,42 +443,117 @@ void RendererProcessor::Start()
             Qt::QueuedConnection);
   }
 
-  // Connect first thread (master thread) to the callback
-  connect(threads_.first().get(),
-          SIGNAL(CachedFrame(RenderTexturePtr, const rational&, const QByteArray&)),
-          this,
-          SLOT(ThreadCallback(RenderTexturePtr, const rational&, const QByteArray&)),
-          Qt::QueuedConnection);
-  connect(threads_.first().get(),
-          SIGNAL(FrameSkipped(const rational&, const QByteArray&)),
+  // Connect first thread (master thread) and the interactive thread to the callback
+  QList<RendererProcessThread*> callback_threads = {threads_.first().get(), interactive_thread_.get()};
+
+  foreach (RendererProcessThread* callback_thread, callback_threads) {
+    connect(callback_thread,
+            SIGNAL(CachedFrame(RenderTexturePtr, const rational&, const QByteArray&, int)),
+            this,
+            SLOT(ThreadCallback(RenderTexturePtr, const rational&, const QByteArray&, int)),
+            Qt::QueuedConnection);
+    connect(callback_thread,
+            SIGNAL(FrameSkipped(const rational&, const QByteArray&, int)),
+            this,
+            SLOT(ThreadSkippedFrame(const rational&, const QByteArray&, int)),
+            Qt::QueuedConnection);
+    connect(callback_thread,
+            SIGNAL(FrameDiscarded(const QByteArray&)),
+            this,
+            SLOT(ThreadDiscardedFrame(const QByteArray&)),
+            Qt::QueuedConnection);
+  }
+
+  connect(interactive_thread_.get(),
+          SIGNAL(RequestSibling(NodeDependency)),
           this,
-          SLOT(ThreadSkippedFrame(const rational&, const QByteArray&)),
+          SLOT(ThreadRequestSibling(NodeDependency)),
           Qt::QueuedConnection);
 
+  // Frames go from the download threads to the encoder pool and then to the write thread, each stage is bounded so a
+  // slow stage can't pile up an unlimited amount of frames in memory
+  encode_queue_ = std::make_shared<CacheFrameQueue>(kCacheQueueSize);
+  write_queue_ = std::make_shared<CacheFrameQueue>(kCacheQueueSize);
+
   download_threads_.resize(background_thread_count);
 
   for (int i=0;i<download_threads_.size();i++) {
     // Create download thread
-    download_threads_[i] = std::make_shared<RendererDownloadThread>(ctx, effective_width_, effective_height_, divider_, format_, mode_);
+    download_threads_[i] = std::make_shared<RendererDownloadThread>(this, encode_queue_, ctx, effective_width_, effective_height_, divider_, format_, mode_);
     download_threads_[i]->StartThread(QThread::LowPriority);
 
     connect(download_threads_[i].get(),
-            SIGNAL(Downloaded(const QByteArray&)),
+            SIGNAL(Discarded(const QByteArray&)),
             this,
-            SLOT(DownloadThreadComplete(const QByteArray&)),
+            SLOT(CacheStageDiscarded(const QByteArray&)),
             Qt::QueuedConnection);
   }
 
+  encode_threads_.resize(kCacheEncoderThreads > 0 ? kCacheEncoderThreads : QThread::idealThreadCount());
+
+  for (int i=0;i<encode_threads_.size();i++) {
+    encode_threads_[i] = std::make_shared<RendererEncodeThread>(this,
+                                                                encode_queue_,
+                                                                write_queue_,
+                                                                kCacheCodec,
+                                                                effective_width_,
+                                                                effective_height_,
+                                                                format_);
+    encode_threads_[i]->start(QThread::LowPriority);
+
+    connect(encode_threads_[i].get(),
+            SIGNAL(Discarded(const QByteArray&)),
+            this,
+            SLOT(CacheStageDiscarded(const QByteArray&)),
+            Qt::QueuedConnection);
+  }
+
+  write_thread_ = std::make_shared<RendererWriteThread>(this, write_queue_, frame_store_);
+  write_thread_->start(QThread::LowPriority);
+
+  connect(write_thread_.get(),
+          SIGNAL(Written(const QByteArray&)),
+          this,
+          SLOT(DownloadThreadComplete(const QByteArray&)),
+          Qt::QueuedConnection);
+
+  connect(write_thread_.get(),
+          SIGNAL(Discarded(const QByteArray&)),
+          this,
+          SLOT(CacheStageDiscarded(const QByteArray&)),
+          Qt::QueuedConnection);
+
   last_download_thread_ = 0;
 
+  load_threads_.resize(kCacheLoaderThreads);
+
+  for (int i=0;i<load_threads_.size();i++) {
+    load_threads_[i] = std::make_shared<RendererLoadThread>(this, frame_store_, ctx, effective_width_, effective_height_, divider_, format_, mode_);
+    load_threads_[i]->StartThread(QThread::NormalPriority);
+
+    connect(load_threads_[i].get(),
+            SIGNAL(Loaded(RenderTexturePtr, const rational&, const QByteArray&)),
+            this,
+            SLOT(LoadThreadComplete(RenderTexturePtr, const rational&, const QByteArray&)),
+            Qt::QueuedConnection);
+
+    connect(load_threads_[i].get(),
+            SIGNAL(LoadFailed(const rational&, const QByteArray&)),
+            this,
+            SLOT(LoadThreadFailed(const rational&, const QByteArray&)),
+            Qt::QueuedConnection);
+  }
+
+  last_load_thread_ = 0;
+
   // Restore context now that thread creation is complete
   ctx->makeCurrent(old_surface);
 
-  // Create master texture (the one sent to the viewer)
-  master_texture_ = std::make_shared<RenderTexture>();
-  master_texture_->Create(ctx, effective_width_, effective_height_, format_);
+  olive::ShaderCacheStats shaders_after = olive::ShaderCache::GetStats();
 
-  cache_frame_load_buffer_.resize(PixelService::GetBufferSize(format_, effective_width_, effective_height_));
+  qDebug() << "Renderer started in" << start_timer.elapsed() << "ms,"
+           << (shaders_after.compiled - shaders_before.compiled) << "shader programs compiled,"
+           << (shaders_after.loaded - shaders_before.loaded) << "loaded from cache";
 
   started_ = true;
 }
@@ -321,43 +566,106 @@ void RendererProcessor::Stop()
 
   started_ = false;
 
+  // Cancel the queues first so no thread is left blocking on one
+  encode_queue_->Cancel();
+  write_queue_->Cancel();
+
   foreach (RendererDownloadThreadPtr download_thread_, download_threads_) {
     download_thread_->Cancel();
   }
   download_threads_.clear();
 
+  foreach (RendererEncodeThreadPtr encode_thread, encode_threads_) {
+    encode_thread->wait();
+  }
+  encode_threads_.clear();
+
+  write_thread_->wait();
+  write_thread_ = nullptr;
+
+  encode_queue_ = nullptr;
+  write_queue_ = nullptr;
+
   foreach (RendererProcessThreadPtr process_thread, threads_) {
     process_thread->Cancel();
   }
   threads_.clear();
 
-  master_texture_ = nullptr;
+  interactive_thread_->Cancel();
+  interactive_thread_ = nullptr;
+
+  foreach (RendererLoadThreadPtr load_thread, load_threads_) {
+    load_thread->Cancel();
+  }
+  load_threads_.clear();
+
+  loading_frames_.clear();
+  loaded_frames_.clear();
+
+  // Any frames that were in progress have been abandoned
+  caching_ = false;
+  interactive_caching_ = false;
+
+  cache_hash_list_mutex_.lock();
+  cache_hash_list_.clear();
+  cache_hash_list_mutex_.unlock();
 
-  cache_frame_load_buffer_.clear();
+  deferred_maps_.clear();
+
+  shown_texture_ = nullptr;
+
+  // Parameters are probably changing, so none of these frames will be requested again
+  memory_cache_.Clear();
 }
 
 void RendererProcessor::GenerateCacheIDInternal()
 {
-  if (cache_name_.isEmpty() || effective_width_ == 0 || effective_height_ == 0) {
+  if (effective_width_ == 0 || effective_height_ == 0) {
     return;
   }
 
-  // Generate an ID that is more or less guaranteed to be unique to this Sequence
+  // The cache is shared by every sequence and frames are addressed by content, so the ID only needs to capture the
+  // parameters that change what a frame looks like. It's used to seed every frame hash.
   QCryptographicHash hash(QCryptographicHash::Sha1);
-  hash.addData(cache_name_.toUtf8());
-  hash.addData(QString::number(cache_time_).toUtf8());
   hash.addData(QString::number(width_).toUtf8());
   hash.addData(QString::number(height_).toUtf8());
   hash.addData(QString::number(format_).toUtf8());
+  hash.addData(QString::number(mode_).toUtf8());
   hash.addData(QString::number(divider_).toUtf8());
 
   QByteArray bytes = hash.result();
   cache_id_ = bytes.toHex();
+
+  if (frame_store_ == nullptr) {
+    frame_store_ = FrameStore::Shared();
+  }
 }
 
 void RendererProcessor::CacheNext()
 {
-  if (cache_queue_.isEmpty() || !texture_input_->IsConnected() || caching_) {
+  if (!texture_input_->IsConnected()) {
+    return;
+  }
+
+  if (!interactive_queue_.isEmpty() && !interactive_caching_) {
+    // Make sure cache has started
+    Start();
+
+    interactive_time_ = interactive_queue_.takeFirst();
+
+    qDebug() << "Interactively caching" << interactive_time_.toDouble();
+
+    interactive_thread_->Queue(NodeDependency(texture_input_->get_connected_output(), interactive_time_),
+                               Plan(),
+                               generation_,
+                               true,
+                               false);
+
+    interactive_caching_ = true;
+  }
+
+  // Background caching yields to any interactive requests
+  if (cache_queue_.isEmpty() || caching_ || interactive_caching_ || !interactive_queue_.isEmpty()) {
     return;
   }
 
@@ -368,29 +676,169 @@ void RendererProcessor::CacheNext()
 
   qDebug() << "Caching" << cache_frame.toDouble();
 
-  threads_.first()->Queue(NodeDependency(texture_input_->get_connected_output(), cache_frame), true, false);
+  threads_.first()->Queue(NodeDependency(texture_input_->get_connected_output(), cache_frame),
+                          Plan(),
+                          generation_,
+                          true,
+                          false);
 
   caching_ = true;
 }
 
-QString RendererProcessor::CachePathName(const QByteArray &hash)
+NodePlanPtr RendererProcessor::Plan()
+{
+  NodeOutput* root = texture_input_->get_connected_output();
+
+  // Plans only need recompiling when the graph's connections change
+  if (plan_ == nullptr || plan_->root() != root || !plan_->IsValid()) {
+    plan_ = std::make_shared<NodePlan>(root);
+  }
+
+  return plan_;
+}
+
+void RendererProcessor::RequestInteractive(const rational &time)
+{
+  // No need to request a frame that's already being rendered
+  if (interactive_caching_ && interactive_time_ == time) {
+    return;
+  }
+
+  // If this was requested before, we move it back to the front below
+  interactive_queue_.removeAll(time);
+
+  // This frame no longer needs to wait in the background queue
+  cache_queue_.removeAll(time);
+
+  // Newest requests take priority over older ones since that's what the user is looking at now
+  interactive_queue_.prepend(time);
+
+  CacheNext();
+}
+
+void RendererProcessor::LoadFrame(const rational &time, const QByteArray &hash, bool urgent)
+{
+  QMap<rational, LoadedFrame>::const_iterator loaded = loaded_frames_.constFind(time);
+
+  if ((loaded != loaded_frames_.constEnd() && loaded->hash == hash)
+      || loading_frames_.value(time) == hash) {
+    // Already loaded or on its way
+    return;
+  }
+
+  if (urgent) {
+    // The user has jumped somewhere we haven't prefetched, so anything queued so far is probably useless now
+    foreach (RendererLoadThreadPtr load_thread, load_threads_) {
+      foreach (const rational& dropped, load_thread->ClearQueue()) {
+        loading_frames_.remove(dropped);
+      }
+    }
+  }
+
+  loading_frames_.insert(time, hash);
+
+  load_threads_[last_load_thread_%load_threads_.size()]->Queue(time, hash, urgent);
+
+  last_load_thread_++;
+}
+
+void RendererProcessor::PrefetchFrom(const rational &time)
 {
-  QDir this_cache_dir = QDir(GetMediaCacheLocation()).filePath(cache_id_);
-  this_cache_dir.mkpath(".");
+  rational step = (playback_direction_ > 0) ? timebase_ : -timebase_;
+  rational prefetch_time = time;
 
-  QString filename = QString("%1.exr").arg(QString(hash.toHex()));
+  for (int i=0;i<kCacheLoaderPrefetch;i++) {
+    prefetch_time += step;
 
-  return this_cache_dir.filePath(filename);
+    if (time_hash_map_.contains(prefetch_time)) {
+      LoadFrame(prefetch_time, time_hash_map_.value(prefetch_time), false);
+    }
+  }
 }
 
-void RendererProcessor::DeferMap(const rational &time, const QByteArray &hash)
+bool RendererProcessor::IsInteractiveThread(QObject *sender)
 {
-  deferred_maps_.append({time, hash});
+  return (interactive_thread_ != nullptr && sender == interactive_thread_.get());
+}
+
+void RendererProcessor::DeferMap(const rational &time, const QByteArray &hash, int generation, bool notify)
+{
+  deferred_maps_.append({time, hash, generation, notify});
+}
+
+void RendererProcessor::DiscardHash(const QByteArray &hash)
+{
+  cache_hash_list_mutex_.lock();
+  cache_hash_list_.removeAll(hash);
+  cache_hash_list_mutex_.unlock();
+
+  // Frames that were waiting on this hash will never receive it now, so they'll have to be cached themselves
+  for (int i=0;i<deferred_maps_.size();i++) {
+    const HashTimeMapping& deferred = deferred_maps_.at(i);
+
+    if (deferred.hash == hash) {
+      if (!IsGenerationStale(deferred.time, deferred.generation)) {
+        if (deferred.notify) {
+          RequestInteractive(deferred.time);
+        } else if (!cache_queue_.contains(deferred.time)) {
+          cache_queue_.prepend(deferred.time);
+        }
+      }
+
+      deferred_maps_.removeAt(i);
+      i--;
+    }
+  }
+}
+
+bool RendererProcessor::IsGenerationStale(const rational &time, int generation)
+{
+  generation_lock_.lock();
+
+  bool stale = (InvalidatedGeneration(time) > generation);
+
+  generation_lock_.unlock();
+
+  return stale;
+}
+
+int RendererProcessor::InvalidatedGeneration(const rational &time) const
+{
+  QMap<rational, int>::const_iterator it = invalidated_generations_.upperBound(time);
+
+  if (it == invalidated_generations_.constBegin()) {
+    return 0;
+  }
+
+  return (--it).value();
+}
+
+void RendererProcessor::SetInvalidatedGeneration(const rational &in, const rational &out, int generation)
+{
+  // Whatever was in effect at `out` continues after this span
+  int after = InvalidatedGeneration(out);
+
+  // Everything inside the span is replaced by it
+  QMap<rational, int>::iterator it = invalidated_generations_.lowerBound(in);
+  while (it != invalidated_generations_.end() && it.key() <= out) {
+    it = invalidated_generations_.erase(it);
+  }
+
+  // Merge with the span before if it's from the same generation (e.g. an adjacent range in the same flush)
+  it = invalidated_generations_.lowerBound(in);
+  if (it == invalidated_generations_.begin() || (it - 1).value() != generation) {
+    invalidated_generations_.insert(in, generation);
+  }
+
+  if (after != generation) {
+    invalidated_generations_.insert(out, after);
+  }
 }
 
 bool RendererProcessor::HasHash(const QByteArray &hash)
 {
-  return QFileInfo::exists(CachePathName(hash));
+  // This is only used to decide whether a frame needs rendering, which shouldn't count towards the hit rate
+  return (frame_store_ != nullptr && frame_store_->Probe(hash));
 }
 
 bool RendererProcessor::IsCaching(const QByteArray &hash)
@@ -425,20 +873,30 @@ void RendererProcessor::CalculateEffectiveDimensions()
   effective_height_ = height_ / divider_;
 }
 
-void RendererProcessor::ThreadCallback(RenderTexturePtr texture, const rational& time, const QByteArray& hash)
+void RendererProcessor::ThreadCallback(RenderTexturePtr texture, const rational& time, const QByteArray& hash, int generation)
 {
   // Threads are all done now, time to proceed
-  caching_ = false;
+  if (IsInteractiveThread(sender())) {
+    interactive_caching_ = false;
+  } else {
+    caching_ = false;
+  }
+
+  // The frame may have been invalidated while this signal was waiting in the event queue
+  if (IsGenerationStale(time, generation)) {
+    DiscardHash(hash);
+    CacheNext();
+    return;
+  }
 
-  DeferMap(time, hash);
+  DeferMap(time, hash, generation);
 
   if (texture != nullptr) {
     // We received a texture, time to start downloading it
-    QString fn = CachePathName(hash);
-
     download_threads_[last_download_thread_%download_threads_.size()]->Queue(texture,
-                                                                             fn,
-                                                                             hash);
+                                                                             hash,
+                                                                             time,
+                                                                             generation);
 
     last_download_thread_++;
   } else {
@@ -449,30 +907,107 @@ void RendererProcessor::ThreadCallback(RenderTexturePtr texture, const rational&
   // If the connected output is using this time, signal it to update
   if (texture_output_->IsConnected()
       && texture_output_->LastRequestedTime() == time) {
-    texture_output_->push_value(QVariant::fromValue(texture), time);
+    texture_output_->push_value(NodeValue(texture), time);
     SendInvalidateCache(time, time);
   }
 
   CacheNext();
 }
 
+void RendererProcessor::LoadThreadComplete(RenderTexturePtr texture, const rational &time, const QByteArray &hash)
+{
+  // This may have been waiting in the event queue since before the renderer was stopped
+  if (!started_) {
+    return;
+  }
+
+  if (loading_frames_.value(time) == hash) {
+    loading_frames_.remove(time);
+  }
+
+  // The frame may have changed while it was loading
+  if (time_hash_map_.value(time) != hash) {
+    return;
+  }
+
+  loaded_frames_.insert(time, {hash, texture});
+
+  // Only keep loaded frames around the playhead, dropping whichever end is furthest from it
+  while (loaded_frames_.size() > kCacheLoaderPrefetch * 2 + 1) {
+    if (qAbs(last_value_time_ - loaded_frames_.firstKey()) > qAbs(loaded_frames_.lastKey() - last_value_time_)) {
+      loaded_frames_.erase(loaded_frames_.begin());
+    } else {
+      loaded_frames_.erase(--loaded_frames_.end());
+    }
+  }
+
+  // If the connected output is waiting on this time, signal it to update
+  if (texture_output_->IsConnected()
+      && texture_output_->LastRequestedTime() == time) {
+    shown_texture_ = texture;
+    texture_output_->push_value(NodeValue(texture), time);
+    SendInvalidateCache(time, time);
+  }
+}
+
+void RendererProcessor::LoadThreadFailed(const rational &time, const QByteArray &hash)
+{
+  if (!started_) {
+    return;
+  }
+
+  if (loading_frames_.value(time) == hash) {
+    loading_frames_.remove(time);
+  }
+
+  if (time_hash_map_.value(time) != hash) {
+    return;
+  }
+
+  // The frame has either been evicted from the cache since it was mapped or couldn't be decoded (in which case the
+  // load thread has already removed it from the FrameStore), so it'll have to be rendered again
+  time_hash_map_.remove(time);
+
+  if (texture_output_->IsConnected()
+      && texture_output_->LastRequestedTime() == time) {
+    RequestInteractive(time);
+  }
+}
+
 void RendererProcessor::ThreadRequestSibling(NodeDependency dep)
 {
+  // Background frames don't get extra threads while the user is waiting on an interactive frame
+  if (interactive_caching_ && !IsInteractiveThread(sender())) {
+    return;
+  }
+
   // Try to queue another thread to run this dep in advance
   for (int i=1;i<threads_.size();i++) {
-    if (threads_.at(i)->Queue(dep, false, true)) {
+    if (threads_.at(i)->Queue(dep, nullptr, generation_, false, true)) {
       return;
     }
   }
 }
 
-void RendererProcessor::ThreadSkippedFrame(const rational& time, const QByteArray& hash)
+void RendererProcessor::ThreadSkippedFrame(const rational& time, const QByteArray& hash, int generation)
 {
-  caching_ = false;
+  if (IsInteractiveThread(sender())) {
+    interactive_caching_ = false;
+  } else {
+    caching_ = false;
+  }
+
+  if (IsGenerationStale(time, generation)) {
+    CacheNext();
+    return;
+  }
 
-  DeferMap(time, hash);
+  bool is_caching = IsCaching(hash);
 
-  if (!IsCaching(hash)) {
+  // If this hash is still being cached by another frame, the output will need updating once it's ready
+  DeferMap(time, hash, generation, is_caching);
+
+  if (!is_caching) {
     DownloadThreadComplete(hash);
 
     // Signal output to update value
@@ -495,16 +1030,53 @@ void RendererProcessor::DownloadThreadComplete(const QByteArray &hash)
   for (int i=0;i<deferred_maps_.size();i++) {
     const HashTimeMapping& deferred = deferred_maps_.at(i);
 
-    if (deferred_maps_.at(i).hash == hash) {
+    if (deferred.hash == hash) {
+      if (IsGenerationStale(deferred.time, deferred.generation)) {
+        // This mapping was superseded while it waited, a newer job will provide the correct hash
+        deferred_maps_.removeAt(i);
+        i--;
+        continue;
+      }
+
       // Insert into hash map
       time_hash_map_.insert(deferred.time, deferred.hash);
 
+      // If the user is waiting on this frame (e.g. it was already being cached when requested), update it now
+      if (deferred.notify
+          && texture_output_->IsConnected()
+          && texture_output_->LastRequestedTime() == deferred.time) {
+        texture_output_->ClearCachedValue();
+        SendInvalidateCache(deferred.time, deferred.time);
+      }
+
       deferred_maps_.removeAt(i);
       i--;
     }
   }
 }
 
+void RendererProcessor::ThreadDiscardedFrame(const QByteArray &hash)
+{
+  if (IsInteractiveThread(sender())) {
+    interactive_caching_ = false;
+  } else {
+    caching_ = false;
+  }
+
+  if (!hash.isEmpty()) {
+    DiscardHash(hash);
+  }
+
+  CacheNext();
+}
+
+void RendererProcessor::CacheStageDiscarded(const QByteArray &hash)
+{
+  DiscardHash(hash);
+
+  CacheNext();
+}
+
 RendererThreadBase* RendererProcessor::CurrentThread()
 {
   return dynamic_cast<RendererThreadBase*>(QThread::currentThread());
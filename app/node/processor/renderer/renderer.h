@@ -23,12 +23,18 @@
 
 #include <QLinkedList>
 #include <QOpenGLTexture>
+#include <QTimer>
 
+#include "common/timerange.h"
 #include "node/node.h"
+#include "render/framememorycache.h"
 #include "render/pixelformat.h"
 #include "render/rendermodes.h"
 #include "rendererdownloadthread.h"
+#include "rendererencodethread.h"
+#include "rendererloadthread.h"
 #include "rendererprocessthread.h"
+#include "rendererwritethread.h"
 
 /**
  * @brief A multithreaded OpenGL based renderer for node systems
@@ -50,10 +56,27 @@ public:
   virtual QString Description() override;
   virtual QString id() override;
 
-  void SetCacheName(const QString& s);
+  /**
+   * @brief Return an ID representing the parameters this Renderer renders with
+   *
+   * Every frame hash is seeded with this ID so that the same content rendered with different parameters (e.g. at a
+   * different resolution) never shares a cached frame.
+   */
+  const QString& cache_id() const;
+
+  /**
+   * @brief Return the RAM tier of this Renderer's cache
+   */
+  FrameMemoryCache* memory_cache();
 
   virtual void Release() override;
 
+  /**
+   * @brief Queue a range of frames to be re-hashed and re-rendered
+   *
+   * Ranges are merged and only processed once control returns to the event loop (or FlushInvalidations() is called),
+   * so several invalidations in quick succession only cost one pass over the affected frames.
+   */
   virtual void InvalidateCache(const rational &start_range, const rational &end_range, NodeInput *from = nullptr) override;
 
   void SetTimebase(const rational& timebase);
@@ -99,6 +122,17 @@ public:
    */
   bool TryCache(const QByteArray& hash);
 
+  /**
+   * @brief Returns whether a job for this frame started in `generation` has since been superseded
+   *
+   * Every flush of InvalidateCache()'s ranges bumps the generation and records it against each invalidated frame. Any job that
+   * was started before the frame's most recent invalidation is stale and its result would be wrong (or at best
+   * redundant), so threads use this to abandon work at each stage boundary.
+   *
+   * This function is thread-safe.
+   */
+  bool IsGenerationStale(const rational& time, int generation);
+
   /**
    * @brief Return current instance of a RenderThread (or nullptr if there is none)
    *
@@ -116,12 +150,21 @@ public:
   NodeOutput* texture_output();
 
 protected:
-  virtual QVariant Value(NodeOutput* output, const rational& time) override;
+  virtual bool AnalyzeTimeInvariance(NodeOutput* output) override;
+
+  virtual NodeValue Value(NodeOutput* output, const rational& time) override;
 
 private:
+  struct LoadedFrame {
+    QByteArray hash;
+    RenderTexturePtr texture;
+  };
+
   struct HashTimeMapping {
     rational time;
     QByteArray hash;
+    int generation;
+    bool notify;
   };
 
   /**
@@ -139,27 +182,92 @@ private:
    */
   void GenerateCacheIDInternal();
 
+  /**
+   * @brief Insert a frame into the render queue, ordered by its distance from the playhead
+   */
+  void QueueCacheFrame(const rational& r);
+
   /**
    * @brief Function called when there are frames in the queue to cache
    *
+   * Interactive requests are always dispatched first (on the reserved interactive thread). Background frames are only
+   * dispatched while no interactive request is pending or in progress.
+   *
    * This function is NOT thread-safe and should only be called in the main thread.
    */
   void CacheNext();
 
+  /**
+   * @brief Return the compiled plan for the connected texture output, recompiling it if the graph has changed
+   */
+  NodePlanPtr Plan();
+
+  /**
+   * @brief Request a frame the user is currently waiting on
+   *
+   * Places the frame at the front of the interactive queue so that it's rendered ahead of any background caching.
+   *
+   * This function is NOT thread-safe and should only be called in the main thread.
+   */
+  void RequestInteractive(const rational& time);
+
+  /**
+   * @brief Queue a cached frame to be loaded into a texture by the load threads
+   *
+   * @param urgent
+   *
+   * Set this if the user is waiting on this frame. Any prefetches still queued are dropped so it's loaded next.
+   */
+  void LoadFrame(const rational& time, const QByteArray& hash, bool urgent);
+
+  /**
+   * @brief Queue loads for the cached frames following `time` in the direction of playback
+   */
+  void PrefetchFrom(const rational& time);
+
+  /**
+   * @brief Returns whether a signal was sent by the reserved interactive thread
+   */
+  bool IsInteractiveThread(QObject* sender);
+
   bool ShouldPushTexture(const rational &time);
 
+  void DeferMap(const rational &time, const QByteArray &hash, int generation, bool notify = false);
+
   /**
-   * @brief Return the path of the cached image at this time
+   * @brief Return the generation `time` was last invalidated in
+   *
+   * Must be called with generation_lock_ held.
    */
-  QString CachePathName(const QByteArray &hash);
+  int InvalidatedGeneration(const rational& time) const;
 
-  void DeferMap(const rational &time, const QByteArray &hash);
+  /**
+   * @brief Record that every time from `in` up to (but not including) `out` was invalidated in `generation`
+   *
+   * `generation` must be the newest generation. Must be called with generation_lock_ held.
+   */
+  void SetInvalidatedGeneration(const rational& in, const rational& out, int generation);
+
+  /**
+   * @brief Release a hash reservation whose job was discarded
+   *
+   * Any frames that were waiting on this hash to finish caching are queued again so that they get cached themselves.
+   */
+  void DiscardHash(const QByteArray& hash);
 
   /**
    * @brief Internal list of RenderProcessThreads
    */
   QVector<RendererProcessThreadPtr> threads_;
 
+  /**
+   * @brief Render thread reserved for interactive requests
+   *
+   * Background caching never runs on this thread, so a frame requested by the user never has to wait for the
+   * background queue to drain.
+   */
+  RendererProcessThreadPtr interactive_thread_;
+
   /**
    * @brief Internal variable that contains whether the Renderer has started or not
    */
@@ -188,17 +296,82 @@ private:
   double timebase_dbl_;
 
   QLinkedList<rational> cache_queue_;
-  QString cache_name_;
-  qint64 cache_time_;
+
+  /**
+   * @brief Invalidated frames waiting to be hashed
+   *
+   * Only frames whose hash doesn't exist in the cache yet move on to `cache_queue_`.
+   */
+  QMap<rational, bool> hash_queue_;
+
+  QTimer hash_timer_;
+
+  /**
+   * @brief Ranges passed to InvalidateCache() that haven't been processed yet
+   */
+  TimeRangeList pending_invalidations_;
+
+  QTimer invalidate_timer_;
+
+  QLinkedList<rational> interactive_queue_;
   QString cache_id_;
 
   bool caching_;
-  QVector<uchar*> cache_frame_load_buffer_;
+  bool interactive_caching_;
+  rational interactive_time_;
+
+  /**
+   * @brief Decoded frames held in memory so they don't need to be read from the FrameStore again
+   */
+  FrameMemoryCache memory_cache_;
+
+  /**
+   * @brief Compiled plan for whatever is connected to the texture input
+   */
+  NodePlanPtr plan_;
 
   QVector<RendererDownloadThreadPtr> download_threads_;
   int last_download_thread_;
 
-  RenderTexturePtr master_texture_;
+  /**
+   * @brief Frames that have been downloaded and are waiting to be compressed
+   */
+  CacheFrameQueuePtr encode_queue_;
+
+  /**
+   * @brief Frames that have been compressed and are waiting to be written to disk
+   */
+  CacheFrameQueuePtr write_queue_;
+
+  QVector<RendererEncodeThreadPtr> encode_threads_;
+
+  RendererWriteThreadPtr write_thread_;
+
+  QVector<RendererLoadThreadPtr> load_threads_;
+  int last_load_thread_;
+
+  /**
+   * @brief Frames that have been queued on a load thread but haven't arrived yet
+   */
+  QMap<rational, QByteArray> loading_frames_;
+
+  /**
+   * @brief Frames around the playhead that have been loaded into textures and are ready to show
+   */
+  QMap<rational, LoadedFrame> loaded_frames_;
+
+  /**
+   * @brief The last texture sent to the output, shown until the requested frame has loaded
+   */
+  RenderTexturePtr shown_texture_;
+
+  rational last_value_time_;
+  int playback_direction_;
+
+  /**
+   * @brief Where this Renderer's cached frames are stored
+   */
+  FrameStorePtr frame_store_;
 
   QMap<rational, QByteArray> time_hash_map_;
 
@@ -207,15 +380,50 @@ private:
 
   QList<HashTimeMapping> deferred_maps_;
 
+  /**
+   * @brief Incremented every time the cache is invalidated
+   */
+  int generation_;
+
+  /**
+   * @brief The generation each span of time was last invalidated in
+   *
+   * Each key is the start of a span that lasts until the next key, so this only grows with the number of distinct
+   * ranges that have been invalidated rather than the number of frames. Times before the first key have never been
+   * invalidated (generation 0). Use InvalidatedGeneration() and SetInvalidatedGeneration().
+   */
+  QMap<rational, int> invalidated_generations_;
+
+  QMutex generation_lock_;
+
+public slots:
+  /**
+   * @brief Process any invalidations collected by InvalidateCache() immediately
+   */
+  void FlushInvalidations();
+
 private slots:
-  void ThreadCallback(RenderTexturePtr texture, const rational& time, const QByteArray& hash);
+  /**
+   * @brief Hash a slice of the invalidated frames, remapping any whose content is already cached
+   */
+  void HashNext();
+
+  void ThreadCallback(RenderTexturePtr texture, const rational& time, const QByteArray& hash, int generation);
 
   void ThreadRequestSibling(NodeDependency dep);
 
-  void ThreadSkippedFrame(const rational &time, const QByteArray &hash);
+  void ThreadSkippedFrame(const rational &time, const QByteArray &hash, int generation);
+
+  void ThreadDiscardedFrame(const QByteArray &hash);
 
   void DownloadThreadComplete(const QByteArray &hash);
 
+  void LoadThreadComplete(RenderTexturePtr texture, const rational& time, const QByteArray& hash);
+
+  void LoadThreadFailed(const rational& time, const QByteArray& hash);
+
+  void CacheStageDiscarded(const QByteArray &hash);
+
 };
 
 #endif // RENDERER_H
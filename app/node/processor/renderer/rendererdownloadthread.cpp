@@ -1,28 +1,38 @@
 #include "rendererdownloadthread.h"
 
-#include <QFile>
-#include <QFloat16>
-#include <OpenImageIO/imageio.h>
+#include <QDebug>
 
-#include "common/define.h"
 #include "render/pixelservice.h"
+#include "renderer.h"
 
-RendererDownloadThread::RendererDownloadThread(QOpenGLContext *share_ctx,
+/**
+ * @brief Number of readbacks that can be in flight at once
+ */
+const int kReadbackRingSize = 3;
+
+RendererDownloadThread::RendererDownloadThread(RendererProcessor *parent,
+                                               CacheFrameQueuePtr encode_queue,
+                                               QOpenGLContext *share_ctx,
                                                const int &width,
                                                const int &height,
                                                const int &divider,
                                                const olive::PixelFormat &format,
                                                const olive::RenderMode &mode) :
   RendererThreadBase(share_ctx, width, height, divider, format, mode),
+  parent_(parent),
+  encode_queue_(encode_queue),
   cancelled_(false)
 {
 }
 
-void RendererDownloadThread::Queue(RenderTexturePtr texture, const QString& fn, const QByteArray &hash)
+void RendererDownloadThread::Queue(RenderTexturePtr texture,
+                                   const QByteArray &hash,
+                                   const rational &time,
+                                   int generation)
 {
   texture_queue_lock_.lock();
 
-  texture_queue_.append({texture, fn, hash});
+  texture_queue_.append({texture, hash, time, generation});
 
   wait_cond_.wakeAll();
 
@@ -42,31 +52,38 @@ void RendererDownloadThread::Cancel()
 
 void RendererDownloadThread::ProcessLoop()
 {
-  QOpenGLFunctions* f = render_instance()->context()->functions();
-  QOpenGLExtraFunctions* xf = render_instance()->context()->extraFunctions();
+  QOpenGLContext* ctx = render_instance()->context();
+  QOpenGLFunctions* f = ctx->functions();
 
   f->glGenFramebuffers(1, &read_buffer_);
 
-  DownloadQueueEntry entry;
+  buffer_size_ = PixelService::GetBufferSize(render_instance()->format(),
+                                             render_instance()->width(),
+                                             render_instance()->height());
 
-  int buffer_size = PixelService::GetBufferSize(render_instance()->format(),
-                                                render_instance()->width(),
-                                                render_instance()->height());
+  // Asynchronous readback requires sync objects and pixel pack buffers, otherwise we download synchronously
+  bool async = RenderTexture::SyncSupported(ctx);
 
-  QVector<uchar> data_buffer;
-  data_buffer.resize(buffer_size);
+  if (async) {
+    free_pixel_buffers_.resize(kReadbackRingSize);
+    f->glGenBuffers(kReadbackRingSize, free_pixel_buffers_.data());
 
-  PixelFormatInfo format_info = PixelService::GetPixelFormatInfo(render_instance()->format());
+    foreach (GLuint pixel_buffer, free_pixel_buffers_) {
+      f->glBindBuffer(GL_PIXEL_PACK_BUFFER, pixel_buffer);
+      f->glBufferData(GL_PIXEL_PACK_BUFFER, buffer_size_, nullptr, GL_STREAM_READ);
+    }
+
+    f->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  }
 
-  // Set up OIIO::ImageSpec for compressing cached images on disk
-  OIIO::ImageSpec spec(render_instance()->width(), render_instance()->height(), kRGBAChannels, format_info.oiio_desc);
-  spec.attribute("compression", "dwaa:200");
+  DownloadQueueEntry entry;
 
   while (!cancelled_) {
     // Check queue for textures to download (use mutex to prevent collisions)
     texture_queue_lock_.lock();
 
-    while (texture_queue_.isEmpty()) {
+    // Only sleep if there are no readbacks left to finish either
+    while (texture_queue_.isEmpty() && pending_readbacks_.isEmpty()) {
       // Main waiting condition
       wait_cond_.wait(&texture_queue_lock_);
 
@@ -79,50 +96,179 @@ void RendererDownloadThread::ProcessLoop()
       break;
     }
 
-    entry = texture_queue_.takeFirst();
+    bool has_entry = !texture_queue_.isEmpty();
 
-    texture_queue_lock_.unlock();
+    if (has_entry) {
+      entry = texture_queue_.takeFirst();
+    }
 
-    // Download the texture
+    texture_queue_lock_.unlock();
 
-    f->glBindFramebuffer(GL_READ_FRAMEBUFFER, read_buffer_);
+    if (!has_entry) {
+      // Nothing new has come in, so finish the readbacks we've already started
+      FinishReadback();
+      continue;
+    }
 
-    xf->glFramebufferTexture2D(GL_READ_FRAMEBUFFER,
-                               GL_COLOR_ATTACHMENT0,
-                               GL_TEXTURE_2D,
-                               entry.texture->texture(),
-                               0);
+    // Skip the readback entirely if this frame was invalidated while it was waiting
+    if (parent_->IsGenerationStale(entry.time, entry.generation)) {
+      emit Discarded(entry.hash);
+      continue;
+    }
 
-    f->glReadPixels(0,
-                    0,
-                    entry.texture->width(),
-                    entry.texture->height(),
-                    format_info.pixel_format,
-                    format_info.pixel_type,
-                    data_buffer.data());
+    if (async) {
+      // If every buffer is in use, the oldest readback has to finish before we can start another one
+      if (free_pixel_buffers_.isEmpty()) {
+        FinishReadback();
+      }
 
-    xf->glFramebufferTexture2D(GL_READ_FRAMEBUFFER,
-                               GL_COLOR_ATTACHMENT0,
-                               GL_TEXTURE_2D,
-                               0,
-                               0);
+      StartReadback(entry);
+    } else {
+      QByteArray data;
+      data.resize(buffer_size_);
 
-    f->glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+      ReadTexture(entry, data.data());
 
-    std::string working_fn_std = entry.filename.toStdString();
+      EncodeFrame(entry, data);
+    }
+  }
 
-    std::unique_ptr<OIIO::ImageOutput> out = OIIO::ImageOutput::create(working_fn_std);
+  // Abandon any readbacks that are still in progress
+  QOpenGLExtraFunctions* xf = ctx->extraFunctions();
 
-    if (out) {
-      out->open(working_fn_std, spec);
-      out->write_image(format_info.oiio_desc, data_buffer.data());
-      out->close();
+  foreach (const PendingReadback& pending, pending_readbacks_) {
+    xf->glDeleteSync(pending.fence);
+    free_pixel_buffers_.append(pending.pixel_buffer);
+  }
+  pending_readbacks_.clear();
 
-      emit Downloaded(entry.hash);
-    } else {
-      qWarning() << tr("Failed to open output file \"%1\"").arg(entry.filename);
-    }
+  if (!free_pixel_buffers_.isEmpty()) {
+    f->glDeleteBuffers(free_pixel_buffers_.size(), free_pixel_buffers_.constData());
+    free_pixel_buffers_.clear();
   }
 
   f->glDeleteFramebuffers(1, &read_buffer_);
 }
+
+void RendererDownloadThread::StartReadback(const DownloadQueueEntry &entry)
+{
+  QOpenGLContext* ctx = render_instance()->context();
+
+  GLuint pixel_buffer = free_pixel_buffers_.takeLast();
+
+  ctx->functions()->glBindBuffer(GL_PIXEL_PACK_BUFFER, pixel_buffer);
+
+  // With a pixel pack buffer bound, glReadPixels returns immediately and the copy happens on the GPU
+  ReadTexture(entry, nullptr);
+
+  ctx->functions()->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  GLsync fence = ctx->extraFunctions()->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+  ctx->functions()->glFlush();
+
+  pending_readbacks_.append({entry, pixel_buffer, fence});
+}
+
+void RendererDownloadThread::FinishReadback()
+{
+  if (pending_readbacks_.isEmpty()) {
+    return;
+  }
+
+  QOpenGLContext* ctx = render_instance()->context();
+  QOpenGLFunctions* f = ctx->functions();
+  QOpenGLExtraFunctions* xf = ctx->extraFunctions();
+
+  PendingReadback pending = pending_readbacks_.takeFirst();
+
+  // Wait for the copy to complete (it most likely already has while we were starting the others)
+  GLenum wait_result;
+  do {
+    wait_result = xf->glClientWaitSync(pending.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+  } while (wait_result == GL_TIMEOUT_EXPIRED && !cancelled_);
+
+  xf->glDeleteSync(pending.fence);
+
+  if (wait_result == GL_WAIT_FAILED
+      || wait_result == GL_TIMEOUT_EXPIRED
+      || parent_->IsGenerationStale(pending.entry.time, pending.entry.generation)) {
+    free_pixel_buffers_.append(pending.pixel_buffer);
+    emit Discarded(pending.entry.hash);
+    return;
+  }
+
+  f->glBindBuffer(GL_PIXEL_PACK_BUFFER, pending.pixel_buffer);
+
+  void* mapped = xf->glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, buffer_size_, GL_MAP_READ_BIT);
+
+  // Copy out of the buffer so it can go straight back into the ring
+  QByteArray data;
+
+  if (mapped != nullptr) {
+    data = QByteArray(static_cast<const char*>(mapped), buffer_size_);
+
+    xf->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  }
+
+  f->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  free_pixel_buffers_.append(pending.pixel_buffer);
+
+  if (data.isEmpty()) {
+    qWarning() << tr("Failed to map pixel buffer for readback");
+    emit Discarded(pending.entry.hash);
+    return;
+  }
+
+  EncodeFrame(pending.entry, data);
+}
+
+void RendererDownloadThread::ReadTexture(const DownloadQueueEntry &entry, void *data)
+{
+  QOpenGLFunctions* f = render_instance()->context()->functions();
+  QOpenGLExtraFunctions* xf = render_instance()->context()->extraFunctions();
+
+  PixelFormatInfo format_info = PixelService::GetPixelFormatInfo(render_instance()->format());
+
+  // Wait (on the GPU) for the render thread to finish drawing this texture
+  entry.texture->WaitFence();
+
+  f->glBindFramebuffer(GL_READ_FRAMEBUFFER, read_buffer_);
+
+  xf->glFramebufferTexture2D(GL_READ_FRAMEBUFFER,
+                             GL_COLOR_ATTACHMENT0,
+                             GL_TEXTURE_2D,
+                             entry.texture->texture(),
+                             0);
+
+  f->glReadPixels(0,
+                  0,
+                  entry.texture->width(),
+                  entry.texture->height(),
+                  format_info.pixel_format,
+                  format_info.pixel_type,
+                  data);
+
+  xf->glFramebufferTexture2D(GL_READ_FRAMEBUFFER,
+                             GL_COLOR_ATTACHMENT0,
+                             GL_TEXTURE_2D,
+                             0,
+                             0);
+
+  f->glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+}
+
+void RendererDownloadThread::EncodeFrame(const DownloadQueueEntry &entry, const QByteArray &data)
+{
+  // Compression is the expensive part, so check again before we get there
+  if (parent_->IsGenerationStale(entry.time, entry.generation)) {
+    emit Discarded(entry.hash);
+    return;
+  }
+
+  // We already have the frame decoded, so it goes straight into memory as well as to disk
+  parent_->memory_cache()->Insert(entry.hash, entry.time, data);
+
+  encode_queue_->Push({entry.hash, entry.time, entry.generation, data});
+}
@@ -1,26 +1,34 @@
 #ifndef RENDERERDOWNLOADTHREAD_H
 #define RENDERERDOWNLOADTHREAD_H
 
+#include "rendererencodethread.h"
 #include "rendererthreadbase.h"
 
+class RendererProcessor;
+
 class RendererDownloadThread : public RendererThreadBase
 {
   Q_OBJECT
 public:
-  RendererDownloadThread(QOpenGLContext* share_ctx,
+  RendererDownloadThread(RendererProcessor* parent,
+                         CacheFrameQueuePtr encode_queue,
+                         QOpenGLContext* share_ctx,
                          const int& width,
                          const int& height,
                          const int &divider,
                          const olive::PixelFormat& format,
                          const olive::RenderMode& mode);
 
-  void Queue(RenderTexturePtr texture, const QString &fn, const QByteArray &hash);
+  void Queue(RenderTexturePtr texture, const QByteArray &hash, const rational &time, int generation);
 
 public slots:
   virtual void Cancel() override;
 
 signals:
-  void Downloaded(const QByteArray& hash);
+  /**
+   * @brief Emitted when a download was abandoned because its frame was invalidated before it was written
+   */
+  void Discarded(const QByteArray& hash);
 
 protected:
   virtual void ProcessLoop() override;
@@ -28,12 +36,62 @@ protected:
 private:
   struct DownloadQueueEntry {
     RenderTexturePtr texture;
-    QString filename;
     QByteArray hash;
+    rational time;
+    int generation;
+  };
+
+  /**
+   * @brief A readback that has been issued to the GPU but not yet written to disk
+   */
+  struct PendingReadback {
+    DownloadQueueEntry entry;
+    GLuint pixel_buffer;
+    GLsync fence;
   };
 
+  /**
+   * @brief Issue an asynchronous readback of a texture into a free pixel pack buffer
+   */
+  void StartReadback(const DownloadQueueEntry& entry);
+
+  /**
+   * @brief Wait for the oldest pending readback and pass it on to the encoders
+   */
+  void FinishReadback();
+
+  /**
+   * @brief Bind the entry's texture to the read framebuffer and read it into `data`
+   *
+   * If a GL_PIXEL_PACK_BUFFER is bound, `data` is an offset into it.
+   */
+  void ReadTexture(const DownloadQueueEntry& entry, void* data);
+
+  /**
+   * @brief Pass a downloaded frame on to the encode stage
+   *
+   * Blocks while the encode queue is full, so readback can never get too far ahead of compression.
+   */
+  void EncodeFrame(const DownloadQueueEntry& entry, const QByteArray& data);
+
+  RendererProcessor* parent_;
+
+  CacheFrameQueuePtr encode_queue_;
+
   GLuint read_buffer_;
 
+  /**
+   * @brief Pixel pack buffers not currently in use by a readback
+   */
+  QVector<GLuint> free_pixel_buffers_;
+
+  /**
+   * @brief Readbacks in the order they were issued
+   */
+  QList<PendingReadback> pending_readbacks_;
+
+  int buffer_size_;
+
   QVector<DownloadQueueEntry> texture_queue_;
 
   QMutex texture_queue_lock_;
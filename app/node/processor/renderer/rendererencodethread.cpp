@@ -0,0 +1,64 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "rendererencodethread.h"
+
+#include "renderer.h"
+
+RendererEncodeThread::RendererEncodeThread(RendererProcessor *parent,
+                                           CacheFrameQueuePtr encode_queue,
+                                           CacheFrameQueuePtr write_queue,
+                                           const olive::CacheCodec &codec,
+                                           const int &width,
+                                           const int &height,
+                                           const olive::PixelFormat &format) :
+  parent_(parent),
+  encode_queue_(encode_queue),
+  write_queue_(write_queue),
+  codec_(codec),
+  width_(width),
+  height_(height),
+  format_(format)
+{
+}
+
+void RendererEncodeThread::run()
+{
+  CacheFrameJob job;
+
+  while (encode_queue_->Pop(&job)) {
+    // No point compressing a frame that's already been invalidated
+    if (parent_->IsGenerationStale(job.time, job.generation)) {
+      emit Discarded(job.hash);
+      continue;
+    }
+
+    job.data = CacheCodecService::Encode(codec_, job.data.constData(), width_, height_, format_);
+
+    if (job.data.isEmpty()) {
+      emit Discarded(job.hash);
+      continue;
+    }
+
+    if (!write_queue_->Push(job)) {
+      break;
+    }
+  }
+}
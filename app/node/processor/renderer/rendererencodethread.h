@@ -0,0 +1,96 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef RENDERERENCODETHREAD_H
+#define RENDERERENCODETHREAD_H
+
+#include <memory>
+#include <QThread>
+
+#include "common/boundedqueue.h"
+#include "common/rational.h"
+#include "render/cachecodec.h"
+
+class RendererProcessor;
+
+/**
+ * @brief A frame passing through the render cache's encode and write stages
+ */
+struct CacheFrameJob {
+  QByteArray hash;
+  rational time;
+  int generation;
+
+  /**
+   * @brief Raw pixels going into the encode stage, the encoded frame coming out of it
+   */
+  QByteArray data;
+};
+
+using CacheFrameQueue = BoundedQueue<CacheFrameJob>;
+using CacheFrameQueuePtr = std::shared_ptr<CacheFrameQueue>;
+
+/**
+ * @brief One thread of the render cache's encoder pool
+ *
+ * Takes downloaded frames from one queue, compresses them with the cache codec and passes them on to the write queue.
+ * The thread exits once either queue is cancelled.
+ */
+class RendererEncodeThread : public QThread
+{
+  Q_OBJECT
+public:
+  RendererEncodeThread(RendererProcessor* parent,
+                       CacheFrameQueuePtr encode_queue,
+                       CacheFrameQueuePtr write_queue,
+                       const olive::CacheCodec& codec,
+                       const int& width,
+                       const int& height,
+                       const olive::PixelFormat& format);
+
+signals:
+  /**
+   * @brief Emitted when a frame was dropped, either because it went stale or because it couldn't be encoded
+   */
+  void Discarded(const QByteArray& hash);
+
+protected:
+  virtual void run() override;
+
+private:
+  RendererProcessor* parent_;
+
+  CacheFrameQueuePtr encode_queue_;
+
+  CacheFrameQueuePtr write_queue_;
+
+  olive::CacheCodec codec_;
+
+  int width_;
+
+  int height_;
+
+  olive::PixelFormat format_;
+
+};
+
+using RendererEncodeThreadPtr = std::shared_ptr<RendererEncodeThread>;
+
+#endif // RENDERERENCODETHREAD_H
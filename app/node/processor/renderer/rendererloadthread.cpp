@@ -0,0 +1,168 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "rendererloadthread.h"
+
+#include <QDebug>
+
+#include "render/cachecodec.h"
+#include "render/pixelservice.h"
+#include "renderer.h"
+
+RendererLoadThread::RendererLoadThread(RendererProcessor *parent,
+                                       FrameStorePtr frame_store,
+                                       QOpenGLContext *share_ctx,
+                                       const int &width,
+                                       const int &height,
+                                       const int &divider,
+                                       const olive::PixelFormat &format,
+                                       const olive::RenderMode &mode) :
+  RendererThreadBase(share_ctx, width, height, divider, format, mode),
+  parent_(parent),
+  frame_store_(frame_store),
+  cancelled_(false)
+{
+}
+
+void RendererLoadThread::Queue(const rational &time, const QByteArray &hash, bool urgent)
+{
+  load_queue_lock_.lock();
+
+  if (urgent) {
+    load_queue_.prepend({time, hash});
+  } else {
+    load_queue_.append({time, hash});
+  }
+
+  wait_cond_.wakeAll();
+
+  load_queue_lock_.unlock();
+}
+
+QList<rational> RendererLoadThread::ClearQueue()
+{
+  QList<rational> dropped;
+
+  load_queue_lock_.lock();
+
+  foreach (const LoadQueueEntry& entry, load_queue_) {
+    dropped.append(entry.time);
+  }
+
+  load_queue_.clear();
+
+  load_queue_lock_.unlock();
+
+  return dropped;
+}
+
+void RendererLoadThread::Cancel()
+{
+  cancelled_ = true;
+
+  load_queue_lock_.lock();
+  wait_cond_.wakeAll();
+  load_queue_lock_.unlock();
+
+  wait();
+}
+
+void RendererLoadThread::ProcessLoop()
+{
+  LoadQueueEntry entry;
+
+  while (!cancelled_) {
+    load_queue_lock_.lock();
+
+    while (load_queue_.isEmpty()) {
+      // Main waiting condition
+      wait_cond_.wait(&load_queue_lock_);
+
+      if (cancelled_) {
+        break;
+      }
+    }
+    if (cancelled_) {
+      load_queue_lock_.unlock();
+      break;
+    }
+
+    entry = load_queue_.takeFirst();
+
+    load_queue_lock_.unlock();
+
+    QByteArray frame = GetFrame(entry);
+
+    if (frame.isNull()) {
+      emit LoadFailed(entry.time, entry.hash);
+      continue;
+    }
+
+    RenderTexturePtr texture = render_instance()->image_cache()->Get(render_instance()->context(),
+                                                                     render_instance()->width(),
+                                                                     render_instance()->height(),
+                                                                     render_instance()->format());
+    texture->Upload(frame.constData());
+
+    // The main thread's context waits on this rather than us waiting for the upload to complete
+    texture->Fence();
+
+    emit Loaded(texture, entry.time, entry.hash);
+  }
+}
+
+QByteArray RendererLoadThread::GetFrame(const LoadQueueEntry &entry)
+{
+  // Try memory first
+  QByteArray decoded = parent_->memory_cache()->Get(entry.hash, entry.time);
+
+  if (!decoded.isNull()) {
+    return decoded;
+  }
+
+  FrameStore::ReadHandle handle = frame_store_->Read(entry.hash);
+
+  if (handle.isNull()) {
+    return QByteArray();
+  }
+
+  const QByteArray& encoded = handle.data();
+
+  int width = render_instance()->width();
+  int height = render_instance()->height();
+  olive::PixelFormat format = render_instance()->format();
+
+  // Raw frames are just copied out of the mapping, so the frame stays in memory even if its segment is evicted
+  decoded.resize(PixelService::GetBufferSize(format, width, height));
+
+  if (!CacheCodecService::Decode(encoded, decoded.data(), width, height, format)) {
+    qWarning() << tr("Failed to decode cached frame %1").arg(QString(entry.hash.toHex()));
+
+    // Forget the frame so that it gets rendered again rather than failing to load forever
+    frame_store_->Remove(entry.hash);
+
+    return QByteArray();
+  }
+
+  // Promote to memory so we don't have to read or decode it again next time
+  parent_->memory_cache()->Insert(entry.hash, entry.time, decoded);
+
+  return decoded;
+}
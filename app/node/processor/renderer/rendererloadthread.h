@@ -0,0 +1,109 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef RENDERERLOADTHREAD_H
+#define RENDERERLOADTHREAD_H
+
+#include "render/framestore.h"
+#include "rendererthreadbase.h"
+
+class RendererProcessor;
+
+/**
+ * @brief Loads cached frames into textures away from the main thread
+ *
+ * Frames are taken from the Renderer's memory cache if possible, otherwise they're read from the frame store and
+ * decoded. Either way the frame is uploaded into a new texture in this thread's shared context and fenced, so the
+ * main thread only ever receives a texture that's ready (or about to be ready) to draw.
+ */
+class RendererLoadThread : public RendererThreadBase
+{
+  Q_OBJECT
+public:
+  RendererLoadThread(RendererProcessor* parent,
+                     FrameStorePtr frame_store,
+                     QOpenGLContext* share_ctx,
+                     const int& width,
+                     const int& height,
+                     const int& divider,
+                     const olive::PixelFormat& format,
+                     const olive::RenderMode& mode);
+
+  /**
+   * @brief Queue a frame to be loaded
+   *
+   * @param urgent
+   *
+   * If TRUE, the frame is loaded before any prefetches that are already queued
+   */
+  void Queue(const rational& time, const QByteArray& hash, bool urgent);
+
+  /**
+   * @brief Drop any frames that haven't started loading yet
+   *
+   * Returns the times that were dropped so the caller can stop waiting on them.
+   */
+  QList<rational> ClearQueue();
+
+public slots:
+  virtual void Cancel() override;
+
+signals:
+  void Loaded(RenderTexturePtr texture, const rational& time, const QByteArray& hash);
+
+  /**
+   * @brief Emitted when a frame couldn't be loaded, usually because it's been evicted from the frame store
+   *
+   * Frames that were found but couldn't be decoded are removed from the frame store before this is emitted, so
+   * requesting the frame again renders it rather than attempting to load it again.
+   */
+  void LoadFailed(const rational& time, const QByteArray& hash);
+
+protected:
+  virtual void ProcessLoop() override;
+
+private:
+  struct LoadQueueEntry {
+    rational time;
+    QByteArray hash;
+  };
+
+  /**
+   * @brief Retrieve a decoded frame from the memory cache or the frame store
+   *
+   * Returns a null QByteArray if the frame isn't available.
+   */
+  QByteArray GetFrame(const LoadQueueEntry& entry);
+
+  RendererProcessor* parent_;
+
+  FrameStorePtr frame_store_;
+
+  QList<LoadQueueEntry> load_queue_;
+
+  QMutex load_queue_lock_;
+
+  QAtomicInt cancelled_;
+
+};
+
+using RendererLoadThreadPtr = std::shared_ptr<RendererLoadThread>;
+
+#endif // RENDERERLOADTHREAD_H
@@ -36,7 +36,7 @@ RendererProcessThread::RendererProcessThread(RendererProcessor* parent,
 
 }
 
-bool RendererProcessThread::Queue(const NodeDependency& dep, bool wait, bool sibling)
+bool RendererProcessThread::Queue(const NodeDependency& dep, NodePlanPtr plan, int generation, bool wait, bool sibling)
 {
   if (wait) {
     // Wait for thread to be available
@@ -47,6 +47,8 @@ bool RendererProcessThread::Queue(const NodeDependency& dep, bool wait, bool sib
 
   // We can now change params without the other thread using them
   path_ = dep;
+  plan_ = plan;
+  generation_ = generation;
   sibling_ = sibling;
 
   // Prepare to wait for thread to respond
@@ -89,36 +91,47 @@ void RendererProcessThread::ProcessLoop()
     wait_cond_.wakeAll();
     caller_mutex_.unlock();
 
+    // If this frame was invalidated again while it was waiting, there's no point in even hashing it
+    if (!sibling_ && parent_->IsGenerationStale(path_.time(), generation_)) {
+      emit FrameDiscarded(QByteArray());
+      continue;
+    }
+
     // Process the Node
     NodeOutput* output_to_process = path_.node();
     Node* node_to_process = output_to_process->parent();
 
     texture_ = nullptr;
 
-    QList<Node*> all_deps;
+    int edit_version = 0;
     bool has_hash = false;
     bool can_cache = true;
+    bool discard = false;
 
     if (!sibling_) {
-      node_to_process->Lock();
-
-      all_deps = node_to_process->GetDependencies();
-      foreach (Node* dep, all_deps) {
-        dep->Lock();
-      }
+      // Nodes aren't locked while rendering, so note the edit version to find out later if anything was changed
+      edit_version = plan_->EditVersion();
 
       // Check hash
-      QCryptographicHash hasher(QCryptographicHash::Sha1);
-      node_to_process->Hash(&hasher, output_to_process, path_.time());
+      FastHash hasher;
+      hasher.addData(parent_->cache_id().toUtf8());
+      hasher.addData(node_to_process->GetHash(output_to_process, path_.time()));
       hash_ = hasher.result();
 
-      has_hash = parent_->HasHash(hash_);
+      // The graph may have changed since this frame was dequeued
+      discard = parent_->IsGenerationStale(path_.time(), generation_);
+
+      if (!discard) {
+        has_hash = parent_->HasHash(hash_);
+      }
+
       can_cache = false;
     }
 
-    if (!has_hash){
+    if (!discard && !has_hash) {
 
-      if ((can_cache = parent_->TryCache(hash_))) {
+      // Siblings only render dependencies in advance for the master thread so they don't reserve a hash
+      if (sibling_ || (can_cache = parent_->TryCache(hash_))) {
 
         QList<NodeDependency> deps = node_to_process->RunDependencies(output_to_process, path_.time());
 
@@ -130,26 +143,40 @@ void RendererProcessThread::ProcessLoop()
         }
 
         // Get the requested value
-        texture_ = output_to_process->get_value(path_.time()).value<RenderTexturePtr>();
+        if (sibling_) {
+          texture_ = output_to_process->get_value(path_.time()).value<RenderTexturePtr>();
+        } else {
+          texture_ = plan_->Run(path_.time()).value<RenderTexturePtr>();
+        }
 
-        render_instance()->context()->functions()->glFinish();
+        // Let consumers in other contexts wait on the GPU rather than stalling here until it's finished
+        if (texture_ != nullptr) {
+          texture_->Fence();
+        } else {
+          render_instance()->context()->functions()->glFlush();
+        }
       }
     }
 
-    if (!sibling_) {
-      foreach (Node* dep, all_deps) {
-        dep->Unlock();
-      }
+    if (sibling_) {
+      continue;
+    }
 
-      node_to_process->Unlock();
+    if (can_cache
+        && (parent_->IsGenerationStale(path_.time(), generation_) || plan_->EditVersion() != edit_version)) {
+      // This frame was invalidated or edited while we were rendering it, so it may not match its hash
+      discard = true;
     }
 
-    if (can_cache) {
+    if (discard) {
+      // Release our reservation on this hash (if we made one)
+      emit FrameDiscarded(can_cache ? hash_ : QByteArray());
+    } else if (can_cache) {
       // We cached this frame, signal that it will need to be downloaded to disk
-      emit CachedFrame(texture_, path_.time(), hash_);
+      emit CachedFrame(texture_, path_.time(), hash_, generation_);
     } else {
       // This hash already exists, no need to cache, just map it
-      emit FrameSkipped(path_.time(), hash_);
+      emit FrameSkipped(path_.time(), hash_, generation_);
     }
   }
 }
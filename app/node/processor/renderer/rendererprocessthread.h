@@ -21,6 +21,7 @@
 #ifndef RENDERERPROCESSTHREAD_H
 #define RENDERERPROCESSTHREAD_H
 
+#include "node/plan.h"
 #include "rendererthreadbase.h"
 
 class RendererProcessor;
@@ -36,7 +37,19 @@ public:
                         const olive::PixelFormat& format,
                         const olive::RenderMode& mode);
 
-  bool Queue(const NodeDependency &dep, bool wait, bool sibling);
+  /**
+   * @brief Queue a dependency to be rendered on this thread
+   *
+   * @param plan
+   *
+   * The compiled plan for `dep`'s output, used to evaluate it. Siblings don't use plans and can pass nullptr.
+   *
+   * @param generation
+   *
+   * The RendererProcessor generation this job was queued in. If the frame is invalidated again before this job
+   * finishes, the job is discarded at the next stage boundary rather than completed.
+   */
+  bool Queue(const NodeDependency &dep, NodePlanPtr plan, int generation, bool wait, bool sibling);
 
 public slots:
   virtual void Cancel() override;
@@ -47,15 +60,27 @@ protected:
 signals:
   void RequestSibling(NodeDependency dep);
 
-  void CachedFrame(RenderTexturePtr texture, const rational& time, const QByteArray& hash);
+  void CachedFrame(RenderTexturePtr texture, const rational& time, const QByteArray& hash, int generation);
 
-  void FrameSkipped(const rational& time, const QByteArray& hash);
+  void FrameSkipped(const rational& time, const QByteArray& hash, int generation);
+
+  /**
+   * @brief Emitted when a job was abandoned because its frame was invalidated while it was being processed
+   *
+   * If this job had already reserved its hash, `hash` will be set so the reservation can be released. Otherwise it
+   * will be empty.
+   */
+  void FrameDiscarded(const QByteArray& hash);
 
 private:
   RendererProcessor* parent_;
 
   NodeDependency path_;
 
+  NodePlanPtr plan_;
+
+  int generation_;
+
   QByteArray hash_;
 
   RenderTexturePtr texture_;
@@ -0,0 +1,50 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "rendererwritethread.h"
+
+#include "renderer.h"
+
+RendererWriteThread::RendererWriteThread(RendererProcessor *parent,
+                                         CacheFrameQueuePtr write_queue,
+                                         FrameStorePtr frame_store) :
+  parent_(parent),
+  write_queue_(write_queue),
+  frame_store_(frame_store)
+{
+}
+
+void RendererWriteThread::run()
+{
+  CacheFrameJob job;
+
+  while (write_queue_->Pop(&job)) {
+    if (parent_->IsGenerationStale(job.time, job.generation)) {
+      emit Discarded(job.hash);
+      continue;
+    }
+
+    if (frame_store_->Write(job.hash, job.data)) {
+      emit Written(job.hash);
+    } else {
+      emit Discarded(job.hash);
+    }
+  }
+}
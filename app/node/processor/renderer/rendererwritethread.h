@@ -0,0 +1,61 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef RENDERERWRITETHREAD_H
+#define RENDERERWRITETHREAD_H
+
+#include "render/framestore.h"
+#include "rendererencodethread.h"
+
+/**
+ * @brief The render cache's file write stage
+ *
+ * Takes encoded frames from the write queue and appends them to the frame store. The thread exits once the queue is
+ * cancelled.
+ */
+class RendererWriteThread : public QThread
+{
+  Q_OBJECT
+public:
+  RendererWriteThread(RendererProcessor* parent, CacheFrameQueuePtr write_queue, FrameStorePtr frame_store);
+
+signals:
+  void Written(const QByteArray& hash);
+
+  /**
+   * @brief Emitted when a frame was dropped, either because it went stale or because it couldn't be written
+   */
+  void Discarded(const QByteArray& hash);
+
+protected:
+  virtual void run() override;
+
+private:
+  RendererProcessor* parent_;
+
+  CacheFrameQueuePtr write_queue_;
+
+  FrameStorePtr frame_store_;
+
+};
+
+using RendererWriteThreadPtr = std::shared_ptr<RendererWriteThread>;
+
+#endif // RENDERERWRITETHREAD_H
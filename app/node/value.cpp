@@ -0,0 +1,301 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "value.h"
+
+#include <QFont>
+
+NodeValue::NodeValue() :
+  type_(kNone)
+{
+}
+
+NodeValue::NodeValue(int i)
+{
+  Construct(i);
+}
+
+NodeValue::NodeValue(double d)
+{
+  Construct(d);
+}
+
+NodeValue::NodeValue(bool b)
+{
+  Construct(b);
+}
+
+NodeValue::NodeValue(const void *ptr)
+{
+  Construct(ptr);
+}
+
+NodeValue::NodeValue(const rational &r)
+{
+  Construct(r);
+}
+
+NodeValue::NodeValue(const char *s)
+{
+  Construct(QString(s));
+}
+
+NodeValue::NodeValue(QString s)
+{
+  Construct(std::move(s));
+}
+
+NodeValue::NodeValue(const QColor &c)
+{
+  Construct(c);
+}
+
+NodeValue::NodeValue(const QMatrix4x4 &m)
+{
+  Construct(m);
+}
+
+NodeValue::NodeValue(const QVector2D &v)
+{
+  Construct(v);
+}
+
+NodeValue::NodeValue(const QVector3D &v)
+{
+  Construct(v);
+}
+
+NodeValue::NodeValue(const QVector4D &v)
+{
+  Construct(v);
+}
+
+NodeValue::NodeValue(RenderTexturePtr t)
+{
+  Construct(std::move(t));
+}
+
+NodeValue::NodeValue(const NodeValue &other)
+{
+  CopyFrom(other);
+}
+
+NodeValue::NodeValue(NodeValue &&other)
+{
+  MoveFrom(std::move(other));
+}
+
+NodeValue &NodeValue::operator=(const NodeValue &other)
+{
+  if (this != &other) {
+    Destroy();
+    CopyFrom(other);
+  }
+
+  return *this;
+}
+
+NodeValue &NodeValue::operator=(NodeValue &&other)
+{
+  if (this != &other) {
+    Destroy();
+    MoveFrom(std::move(other));
+  }
+
+  return *this;
+}
+
+NodeValue::~NodeValue()
+{
+  Destroy();
+}
+
+const NodeValue::Type &NodeValue::type() const
+{
+  return type_;
+}
+
+bool NodeValue::isNull() const
+{
+  return type_ == kNone;
+}
+
+int NodeValue::toInt() const
+{
+  switch (type_) {
+  case kInt: return Get<int>();
+  case kFloat: return qRound(Get<double>());
+  case kBoolean: return Get<bool>() ? 1 : 0;
+  case kString: return Get<QString>().toInt();
+  default:
+    break;
+  }
+
+  return 0;
+}
+
+double NodeValue::toDouble() const
+{
+  switch (type_) {
+  case kInt: return Get<int>();
+  case kFloat: return Get<double>();
+  case kBoolean: return Get<bool>() ? 1.0 : 0.0;
+  case kRational: return Get<rational>().toDouble();
+  case kString: return Get<QString>().toDouble();
+  default:
+    break;
+  }
+
+  return 0.0;
+}
+
+float NodeValue::toFloat() const
+{
+  return static_cast<float>(toDouble());
+}
+
+bool NodeValue::toBool() const
+{
+  switch (type_) {
+  case kInt: return Get<int>() != 0;
+  case kFloat: return !qIsNull(Get<double>());
+  case kBoolean: return Get<bool>();
+  case kPointer: return Get<const void*>() != nullptr;
+  case kTexture: return Get<RenderTexturePtr>() != nullptr;
+  default:
+    break;
+  }
+
+  return false;
+}
+
+QString NodeValue::toString() const
+{
+  switch (type_) {
+  case kInt: return QString::number(Get<int>());
+  case kFloat: return QString::number(Get<double>());
+  case kBoolean: return Get<bool>() ? QStringLiteral("true") : QStringLiteral("false");
+  case kString: return Get<QString>();
+  case kColor: return Get<QColor>().name();
+  default:
+    break;
+  }
+
+  return QString();
+}
+
+NodeValue NodeValue::FromVariant(const QVariant &v)
+{
+  switch (v.userType()) {
+  case QMetaType::Int: return v.toInt();
+  case QMetaType::Float:
+  case QMetaType::Double: return v.toDouble();
+  case QMetaType::Bool: return v.toBool();
+  case QMetaType::QString: return v.toString();
+  case QMetaType::QFont: return v.value<QFont>().toString();
+  case QMetaType::QColor: return v.value<QColor>();
+  case QMetaType::QMatrix4x4: return v.value<QMatrix4x4>();
+  case QMetaType::QVector2D: return v.value<QVector2D>();
+  case QMetaType::QVector3D: return v.value<QVector3D>();
+  case QMetaType::QVector4D: return v.value<QVector4D>();
+  default:
+    break;
+  }
+
+  if (v.userType() == qMetaTypeId<rational>()) {
+    return v.value<rational>();
+  } else if (v.userType() == qMetaTypeId<RenderTexturePtr>()) {
+    return v.value<RenderTexturePtr>();
+  } else if (v.userType() == qMetaTypeId<quintptr>()) {
+    // Pointers are sent through the UI as integers (see Node::PtrToValue())
+    return reinterpret_cast<const void*>(v.value<quintptr>());
+  }
+
+  return NodeValue();
+}
+
+QVariant NodeValue::ToVariant() const
+{
+  switch (type_) {
+  case kNone: break;
+  case kInt: return Get<int>();
+  case kFloat: return Get<double>();
+  case kBoolean: return Get<bool>();
+  case kPointer: return QVariant::fromValue(reinterpret_cast<quintptr>(Get<const void*>()));
+  case kRational: return QVariant::fromValue(Get<rational>());
+  case kString: return Get<QString>();
+  case kColor: return Get<QColor>();
+  case kMatrix: return Get<QMatrix4x4>();
+  case kVec2: return Get<QVector2D>();
+  case kVec3: return Get<QVector3D>();
+  case kVec4: return Get<QVector4D>();
+  case kTexture: return QVariant::fromValue(Get<RenderTexturePtr>());
+  }
+
+  return QVariant();
+}
+
+void NodeValue::CopyFrom(const NodeValue &other)
+{
+  switch (other.type_) {
+  case kNone: type_ = kNone; break;
+  case kInt: Construct(other.Get<int>()); break;
+  case kFloat: Construct(other.Get<double>()); break;
+  case kBoolean: Construct(other.Get<bool>()); break;
+  case kPointer: Construct(other.Get<const void*>()); break;
+  case kRational: Construct(other.Get<rational>()); break;
+  case kString: Construct(other.Get<QString>()); break;
+  case kColor: Construct(other.Get<QColor>()); break;
+  case kMatrix: Construct(other.Get<QMatrix4x4>()); break;
+  case kVec2: Construct(other.Get<QVector2D>()); break;
+  case kVec3: Construct(other.Get<QVector3D>()); break;
+  case kVec4: Construct(other.Get<QVector4D>()); break;
+  case kTexture: Construct(other.Get<RenderTexturePtr>()); break;
+  }
+}
+
+void NodeValue::MoveFrom(NodeValue &&other)
+{
+  // Only the types that own something benefit from being moved, everything else is just copied
+  switch (other.type_) {
+  case kString: Construct(std::move(other.Get<QString>())); break;
+  case kTexture: Construct(std::move(other.Get<RenderTexturePtr>())); break;
+  default:
+    CopyFrom(other);
+    break;
+  }
+}
+
+void NodeValue::Destroy()
+{
+  switch (type_) {
+  case kString: Get<QString>().~QString(); break;
+  case kTexture: Get<RenderTexturePtr>().~RenderTexturePtr(); break;
+  case kColor: Get<QColor>().~QColor(); break;
+  case kMatrix: Get<QMatrix4x4>().~QMatrix4x4(); break;
+  case kRational: Get<rational>().~rational(); break;
+
+  // The rest are trivially destructible
+  default:
+    break;
+  }
+
+  type_ = kNone;
+}
@@ -0,0 +1,219 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef NODEVALUE_H
+#define NODEVALUE_H
+
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <QColor>
+#include <QMatrix4x4>
+#include <QString>
+#include <QVariant>
+#include <QVector2D>
+#include <QVector3D>
+#include <QVector4D>
+
+#include "common/rational.h"
+#include "render/rendertexture.h"
+
+/**
+ * @brief A value passed between NodeParams
+ *
+ * This covers every type a NodeParam::DataType resolves to. Unlike QVariant, every type is stored inline (only a
+ * QString's own data lives on the heap), so values can be copied and moved through a graph without allocating on each
+ * frame.
+ *
+ * The interface mirrors QVariant's so it can be used the same way (e.g. `value<RenderTexturePtr>()` or `toDouble()`).
+ * Use FromVariant() and ToVariant() to convert at the UI boundary, where Qt's widgets and models expect QVariant.
+ */
+class NodeValue
+{
+public:
+  enum Type {
+    kNone,
+    kInt,
+    kFloat,
+    kBoolean,
+    kPointer,
+    kRational,
+    kString,
+    kColor,
+    kMatrix,
+    kVec2,
+    kVec3,
+    kVec4,
+    kTexture
+  };
+
+  NodeValue();
+  NodeValue(int i);
+  NodeValue(double d);
+  NodeValue(bool b);
+  NodeValue(const void* ptr);
+  NodeValue(const rational& r);
+  NodeValue(const char* s);
+  NodeValue(QString s);
+  NodeValue(const QColor& c);
+  NodeValue(const QMatrix4x4& m);
+  NodeValue(const QVector2D& v);
+  NodeValue(const QVector3D& v);
+  NodeValue(const QVector4D& v);
+  NodeValue(RenderTexturePtr t);
+
+  NodeValue(const NodeValue& other);
+  NodeValue(NodeValue&& other);
+
+  NodeValue& operator=(const NodeValue& other);
+  NodeValue& operator=(NodeValue&& other);
+
+  ~NodeValue();
+
+  const Type& type() const;
+
+  bool isNull() const;
+
+  /**
+   * @brief Return the value as type T, or a default-constructed T if this value holds a different type
+   *
+   * Numeric types (int, double, float and bool) are converted between each other the same way QVariant does.
+   */
+  template<typename T>
+  T value() const;
+
+  int toInt() const;
+  double toDouble() const;
+  float toFloat() const;
+  bool toBool() const;
+  QString toString() const;
+
+  /**
+   * @brief Convert a QVariant from the UI into a NodeValue
+   *
+   * Types that don't correspond to a NodeValue::Type return a null NodeValue.
+   */
+  static NodeValue FromVariant(const QVariant& v);
+
+  /**
+   * @brief Convert this value to a QVariant for the UI
+   */
+  QVariant ToVariant() const;
+
+private:
+  /**
+   * @brief Size of the inline storage, large enough for the biggest type (QMatrix4x4)
+   */
+  static const size_t kStorageSize = sizeof(QMatrix4x4);
+
+  template<typename T>
+  struct TypeOf;
+
+  template<typename T>
+  void Construct(T&& v);
+
+  template<typename T>
+  const T& Get() const;
+
+  template<typename T>
+  T& Get();
+
+  void CopyFrom(const NodeValue& other);
+
+  void MoveFrom(NodeValue&& other);
+
+  void Destroy();
+
+  Type type_;
+
+  std::aligned_storage<kStorageSize>::type storage_;
+};
+
+template<> struct NodeValue::TypeOf<int> { static const Type type = kInt; };
+template<> struct NodeValue::TypeOf<double> { static const Type type = kFloat; };
+template<> struct NodeValue::TypeOf<bool> { static const Type type = kBoolean; };
+template<> struct NodeValue::TypeOf<const void*> { static const Type type = kPointer; };
+template<> struct NodeValue::TypeOf<rational> { static const Type type = kRational; };
+template<> struct NodeValue::TypeOf<QString> { static const Type type = kString; };
+template<> struct NodeValue::TypeOf<QColor> { static const Type type = kColor; };
+template<> struct NodeValue::TypeOf<QMatrix4x4> { static const Type type = kMatrix; };
+template<> struct NodeValue::TypeOf<QVector2D> { static const Type type = kVec2; };
+template<> struct NodeValue::TypeOf<QVector3D> { static const Type type = kVec3; };
+template<> struct NodeValue::TypeOf<QVector4D> { static const Type type = kVec4; };
+template<> struct NodeValue::TypeOf<RenderTexturePtr> { static const Type type = kTexture; };
+
+template<typename T>
+void NodeValue::Construct(T&& v)
+{
+  typedef typename std::decay<T>::type DecayedT;
+
+  static_assert(sizeof(DecayedT) <= kStorageSize, "Type is too large for NodeValue's storage");
+
+  new (&storage_) DecayedT(std::forward<T>(v));
+  type_ = TypeOf<DecayedT>::type;
+}
+
+template<typename T>
+const T& NodeValue::Get() const
+{
+  return *reinterpret_cast<const T*>(&storage_);
+}
+
+template<typename T>
+T& NodeValue::Get()
+{
+  return *reinterpret_cast<T*>(&storage_);
+}
+
+template<typename T>
+T NodeValue::value() const
+{
+  if (type_ == TypeOf<T>::type) {
+    return Get<T>();
+  }
+
+  return T();
+}
+
+template<>
+inline int NodeValue::value<int>() const
+{
+  return toInt();
+}
+
+template<>
+inline double NodeValue::value<double>() const
+{
+  return toDouble();
+}
+
+template<>
+inline float NodeValue::value<float>() const
+{
+  return toFloat();
+}
+
+template<>
+inline bool NodeValue::value<bool>() const
+{
+  return toBool();
+}
+
+#endif // NODEVALUE_H
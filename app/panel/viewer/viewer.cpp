@@ -79,7 +79,7 @@ rational ViewerPanel::GetTime()
   return viewer_->GetTime();
 }
 
-void ViewerPanel::SetTexture(GLuint tex)
+void ViewerPanel::SetTexture(RenderTexturePtr tex)
 {
   viewer_->SetTexture(tex);
 }
@@ -60,7 +60,7 @@ public slots:
    *
    * @param tex
    */
-  void SetTexture(GLuint tex);
+  void SetTexture(RenderTexturePtr tex);
 
 protected:
   virtual void changeEvent(QEvent* e) override;
@@ -24,7 +24,8 @@
 
 #include "ui/icons/icons.h"
 
-Footage::Footage()
+Footage::Footage() :
+  file_size_(0)
 {
   Clear();
 }
@@ -77,6 +78,16 @@ void Footage::set_timestamp(const QDateTime &t)
   timestamp_ = t;
 }
 
+const qint64 &Footage::file_size()
+{
+  return file_size_;
+}
+
+void Footage::set_file_size(const qint64 &size)
+{
+  file_size_ = size;
+}
+
 void Footage::add_stream(StreamPtr s)
 {
   // Add a copy of this stream to the list
@@ -147,6 +147,18 @@ public:
    */
   void set_timestamp(const QDateTime& t);
 
+  /**
+   * @brief Retrieve the size of the file in bytes (as of the last import or replace)
+   */
+  const qint64& file_size();
+
+  /**
+   * @brief Set the size of the file in bytes
+   *
+   * Like the timestamp, this should probably only be done on import or replace.
+   */
+  void set_file_size(const qint64& size);
+
   /**
    * @brief Add a stream metadata object to this footage
    *
@@ -241,6 +253,11 @@ private:
    */
   QDateTime timestamp_;
 
+  /**
+   * @brief Internal file size
+   */
+  qint64 file_size_;
+
   /**
    * @brief Internal streams array
    */
@@ -0,0 +1,323 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "cachecodec.h"
+
+#include <cstring>
+#include <OpenImageIO/filesystem.h>
+#include <OpenImageIO/imageio.h>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+#include <QRandomGenerator>
+#endif
+#include <QTemporaryFile>
+#include <QtMath>
+
+#include "common/define.h"
+#include "render/pixelservice.h"
+
+/**
+ * @brief The first four bytes of every OpenEXR file
+ */
+const char kExrMagic[] = {0x76, 0x2f, 0x31, 0x01};
+
+/**
+ * @brief The first four bytes of every raw frame
+ */
+const char kRawMagic[] = {'O', 'R', 'A', 'W'};
+
+/**
+ * @brief Identifies the layout of raw frames, bump this if it changes
+ */
+const quint32 kRawVersion = 1;
+
+/**
+ * @brief Header written in front of the pixels of a raw frame
+ */
+struct RawHeader {
+  char magic[4];
+  quint32 version;
+  quint32 width;
+  quint32 height;
+  qint32 format;
+};
+
+/**
+ * @brief Internal function for creating the header of a raw frame
+ */
+RawHeader CreateRawHeader(int width, int height, const olive::PixelFormat& format) {
+  RawHeader header;
+
+  memcpy(header.magic, kRawMagic, sizeof(kRawMagic));
+  header.version = kRawVersion;
+  header.width = static_cast<quint32>(width);
+  header.height = static_cast<quint32>(height);
+  header.format = static_cast<qint32>(format);
+
+  return header;
+}
+
+/**
+ * @brief Internal function for retrieving the OpenEXR compression attribute for a codec
+ */
+const char* GetExrCompression(const olive::CacheCodec& codec) {
+  switch (codec) {
+  case olive::kCacheCodecZip:
+    return "zip";
+  case olive::kCacheCodecPiz:
+    return "piz";
+  case olive::kCacheCodecDwaa:
+    return "dwaa:200";
+  case olive::kCacheCodecNone:
+  case olive::kCacheCodecRaw:
+  case olive::kCacheCodecCount:
+    break;
+  }
+
+  return "none";
+}
+
+CacheCodecService::CacheCodecService()
+{
+}
+
+QString CacheCodecService::GetName(const olive::CacheCodec &codec)
+{
+  switch (codec) {
+  case olive::kCacheCodecNone:
+    return tr("EXR (Uncompressed)");
+  case olive::kCacheCodecZip:
+    return tr("EXR (ZIP)");
+  case olive::kCacheCodecPiz:
+    return tr("EXR (PIZ)");
+  case olive::kCacheCodecDwaa:
+    return tr("EXR (DWAA)");
+  case olive::kCacheCodecRaw:
+    return tr("Raw");
+  case olive::kCacheCodecCount:
+    break;
+  }
+
+  return QString();
+}
+
+bool CacheCodecService::IsRaw(const QByteArray &encoded, int width, int height, const olive::PixelFormat &format)
+{
+  if (encoded.size() != static_cast<int>(sizeof(RawHeader)) + PixelService::GetBufferSize(format, width, height)) {
+    return false;
+  }
+
+  RawHeader expected = CreateRawHeader(width, height, format);
+
+  return (memcmp(encoded.constData(), &expected, sizeof(RawHeader)) == 0);
+}
+
+bool CacheCodecService::IsExr(const QByteArray &encoded)
+{
+  return (encoded.size() >= static_cast<int>(sizeof(kExrMagic))
+          && memcmp(encoded.constData(), kExrMagic, sizeof(kExrMagic)) == 0);
+}
+
+QByteArray CacheCodecService::Encode(const olive::CacheCodec &codec,
+                                     const void *data,
+                                     int width,
+                                     int height,
+                                     const olive::PixelFormat &format)
+{
+  if (codec == olive::kCacheCodecRaw) {
+    RawHeader header = CreateRawHeader(width, height, format);
+
+    QByteArray encoded(reinterpret_cast<const char*>(&header), static_cast<int>(sizeof(RawHeader)));
+    encoded.append(static_cast<const char*>(data), PixelService::GetBufferSize(format, width, height));
+
+    return encoded;
+  }
+
+  PixelFormatInfo format_info = PixelService::GetPixelFormatInfo(format);
+
+  OIIO::ImageSpec spec(width, height, kRGBAChannels, format_info.oiio_desc);
+  spec.attribute("compression", GetExrCompression(codec));
+
+#if OIIO_VERSION >= 20000
+  // Encode straight into memory
+  std::vector<unsigned char> encoded;
+  OIIO::Filesystem::IOVecOutput proxy(encoded);
+  void* proxy_ptr = &proxy;
+  spec.attribute("oiio:ioproxy", OIIO::TypeDesc::PTR, &proxy_ptr);
+
+  std::string working_fn_std = "frame.exr";
+#else
+  // Older versions of OIIO can only write EXRs to files, so we go through a temporary file instead
+  QTemporaryFile temp_file(QDir::temp().filePath("olive-XXXXXX.exr"));
+  if (!temp_file.open()) {
+    qWarning() << tr("Failed to create temporary file for encoding");
+    return QByteArray();
+  }
+
+  std::string working_fn_std = temp_file.fileName().toStdString();
+#endif
+
+  std::unique_ptr<OIIO::ImageOutput> out = OIIO::ImageOutput::create(working_fn_std);
+
+  if (!out
+      || !out->open(working_fn_std, spec)
+      || !out->write_image(format_info.oiio_desc, data)) {
+    qWarning() << "OIIO Error:" << OIIO::geterror().c_str();
+    return QByteArray();
+  }
+
+  out->close();
+
+#if OIIO_VERSION >= 20000
+  return QByteArray(reinterpret_cast<const char*>(encoded.data()), static_cast<int>(encoded.size()));
+#else
+  temp_file.seek(0);
+  return temp_file.readAll();
+#endif
+}
+
+bool CacheCodecService::Decode(const QByteArray &encoded,
+                               void *data,
+                               int width,
+                               int height,
+                               const olive::PixelFormat &format)
+{
+  int buffer_size = PixelService::GetBufferSize(format, width, height);
+
+  if (IsRaw(encoded, width, height, format)) {
+    memcpy(data, encoded.constData() + sizeof(RawHeader), static_cast<size_t>(buffer_size));
+    return true;
+  }
+
+  if (!IsExr(encoded)) {
+    qWarning() << tr("Cached frame is not a recognized format");
+    return false;
+  }
+
+  PixelFormatInfo format_info = PixelService::GetPixelFormatInfo(format);
+
+#if OIIO_VERSION >= 20000
+  // Decode straight from memory
+  OIIO::Filesystem::IOMemReader proxy(const_cast<char*>(encoded.constData()), static_cast<size_t>(encoded.size()));
+  void* proxy_ptr = &proxy;
+
+  OIIO::ImageSpec config;
+  config.attribute("oiio:ioproxy", OIIO::TypeDesc::PTR, &proxy_ptr);
+
+  auto in = OIIO::ImageInput::open("frame.exr", &config);
+#else
+  QTemporaryFile temp_file(QDir::temp().filePath("olive-XXXXXX.exr"));
+  if (!temp_file.open()) {
+    qWarning() << tr("Failed to create temporary file for decoding");
+    return false;
+  }
+  temp_file.write(encoded);
+  temp_file.flush();
+
+  auto in = OIIO::ImageInput::open(temp_file.fileName().toStdString());
+#endif
+
+  if (!in) {
+    qWarning() << "OIIO Error:" << OIIO::geterror().c_str();
+    return false;
+  }
+
+  bool success = (in->spec().width == width
+                  && in->spec().height == height
+                  && in->read_image(format_info.oiio_desc, data));
+
+  in->close();
+
+  return success;
+}
+
+QList<CacheCodecBenchmark> CacheCodecService::Benchmark(int width,
+                                                        int height,
+                                                        const olive::PixelFormat &format,
+                                                        int iterations)
+{
+  // Generate a test frame with smooth gradients and some noise, roughly how a real frame compresses
+  FramePtr frame = Frame::Create();
+  frame->set_width(width);
+  frame->set_height(height);
+  frame->set_format(olive::PIX_FMT_RGBA32F);
+  frame->allocate();
+
+  float* pixels = reinterpret_cast<float*>(frame->data());
+
+  // Seeded so every run measures the same frame
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+  QRandomGenerator random(0);
+#else
+  qsrand(0);
+#endif
+
+  for (int y=0;y<height;y++) {
+    for (int x=0;x<width;x++) {
+      float* pixel = pixels + (y * width + x) * kRGBAChannels;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+      float noise = static_cast<float>(random.bounded(256)) / 8192.0f;
+#else
+      float noise = static_cast<float>(qrand() % 256) / 8192.0f;
+#endif
+
+      pixel[0] = static_cast<float>(x) / static_cast<float>(width) + noise;
+      pixel[1] = static_cast<float>(y) / static_cast<float>(height) + noise;
+      pixel[2] = 0.5f + 0.5f * qSin(static_cast<float>(x + y) * 0.01f);
+      pixel[3] = 1.0f;
+    }
+  }
+
+  frame = PixelService::ConvertPixelFormat(frame, format);
+
+  QByteArray decoded;
+  decoded.resize(PixelService::GetBufferSize(format, width, height));
+
+  QList<CacheCodecBenchmark> results;
+
+  for (int i=0;i<olive::kCacheCodecCount;i++) {
+    olive::CacheCodec codec = static_cast<olive::CacheCodec>(i);
+
+    CacheCodecBenchmark result = {codec, 0, 0, 0};
+
+    QElapsedTimer timer;
+
+    for (int j=0;j<iterations;j++) {
+      timer.start();
+      QByteArray encoded = Encode(codec, frame->const_data(), width, height, format);
+      result.encode_ms += timer.nsecsElapsed() / 1000000.0;
+
+      timer.start();
+      Decode(encoded, decoded.data(), width, height, format);
+      result.decode_ms += timer.nsecsElapsed() / 1000000.0;
+
+      result.bytes = encoded.size();
+    }
+
+    result.encode_ms /= iterations;
+    result.decode_ms /= iterations;
+
+    results.append(result);
+  }
+
+  return results;
+}
@@ -0,0 +1,125 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef CACHECODEC_H
+#define CACHECODEC_H
+
+#include <QByteArray>
+#include <QList>
+#include <QObject>
+
+#include "pixelformat.h"
+
+namespace olive {
+
+/**
+ * @brief Formats frames can be stored in on disk in the render cache
+ *
+ * The EXR codecs trade encode time and decode time against disk usage. kCacheCodecRaw stores the pixels exactly as
+ * they're downloaded from the GPU behind a small header, so it's the fastest to read back but by far the largest on
+ * disk.
+ */
+enum CacheCodec {
+  kCacheCodecNone,
+  kCacheCodecZip,
+  kCacheCodecPiz,
+  kCacheCodecDwaa,
+  kCacheCodecRaw,
+
+  kCacheCodecCount
+};
+
+}
+
+/**
+ * @brief Timing and size results for one codec, see CacheCodecService::Benchmark()
+ */
+struct CacheCodecBenchmark {
+  olive::CacheCodec codec;
+  double encode_ms;
+  double decode_ms;
+  int bytes;
+};
+
+/**
+ * @brief Static functions for encoding and decoding render cache frames in memory
+ *
+ * All functions are thread-safe.
+ */
+class CacheCodecService : public QObject {
+public:
+  CacheCodecService();
+
+  /**
+   * @brief Return a human-readable name for a codec
+   */
+  static QString GetName(const olive::CacheCodec& codec);
+
+  /**
+   * @brief Encode a frame of RGBA pixels
+   *
+   * @return The encoded frame, or an empty QByteArray if encoding failed
+   */
+  static QByteArray Encode(const olive::CacheCodec& codec,
+                           const void* data,
+                           int width,
+                           int height,
+                           const olive::PixelFormat& format);
+
+  /**
+   * @brief Decode a frame encoded by Encode() into a buffer of RGBA pixels
+   *
+   * The codec is detected from the data itself, so frames cached with a different codec can still be read.
+   *
+   * @param data
+   *
+   * Destination buffer. Must be at least PixelService::GetBufferSize(format, width, height) bytes.
+   *
+   * @return True if the frame was decoded successfully
+   */
+  static bool Decode(const QByteArray& encoded,
+                     void* data,
+                     int width,
+                     int height,
+                     const olive::PixelFormat& format);
+
+  /**
+   * @brief Encode and decode a synthetic frame in every codec and measure the results
+   *
+   * @param iterations
+   *
+   * Number of times to encode and decode each codec. Times are averaged over all iterations.
+   */
+  static QList<CacheCodecBenchmark> Benchmark(int width,
+                                              int height,
+                                              const olive::PixelFormat& format,
+                                              int iterations);
+
+private:
+  /**
+   * @brief Returns whether an encoded frame is a raw frame with these dimensions and format
+   */
+  static bool IsRaw(const QByteArray& encoded, int width, int height, const olive::PixelFormat& format);
+
+  static bool IsExr(const QByteArray& encoded);
+
+};
+
+#endif // CACHECODEC_H
@@ -0,0 +1,116 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "framememorycache.h"
+
+FrameMemoryCache::FrameMemoryCache(qint64 budget) :
+  budget_(budget),
+  used_(0),
+  access_counter_(0),
+  timebase_dbl_(0)
+{
+}
+
+QByteArray FrameMemoryCache::Get(const QByteArray &hash, const rational &time)
+{
+  QByteArray data;
+
+  lock_.lock();
+
+  QHash<QByteArray, Entry>::iterator i = frames_.find(hash);
+
+  if (i != frames_.end()) {
+    i.value().time = time;
+    i.value().last_access = ++access_counter_;
+
+    data = i.value().data;
+  }
+
+  lock_.unlock();
+
+  return data;
+}
+
+void FrameMemoryCache::Insert(const QByteArray &hash, const rational &time, const QByteArray &data)
+{
+  lock_.lock();
+
+  QHash<QByteArray, Entry>::iterator i = frames_.find(hash);
+
+  if (i != frames_.end()) {
+    used_ -= i.value().data.size();
+  }
+
+  frames_.insert(hash, {data, time, ++access_counter_});
+  used_ += data.size();
+
+  Evict();
+
+  lock_.unlock();
+}
+
+void FrameMemoryCache::SetPlayhead(const rational &time, const rational &timebase)
+{
+  lock_.lock();
+
+  playhead_ = time;
+  timebase_dbl_ = timebase.toDouble();
+
+  lock_.unlock();
+}
+
+void FrameMemoryCache::Clear()
+{
+  lock_.lock();
+
+  frames_.clear();
+  used_ = 0;
+
+  lock_.unlock();
+}
+
+void FrameMemoryCache::Evict()
+{
+  while (used_ > budget_ && !frames_.isEmpty()) {
+    QHash<QByteArray, Entry>::iterator worst = frames_.end();
+    double worst_score = -1;
+
+    for (QHash<QByteArray, Entry>::iterator i=frames_.begin();i!=frames_.end();i++) {
+      // Both terms are in frames: how many frames have been accessed since this one was, and how many frames away
+      // from the playhead it is
+      double age = static_cast<double>(access_counter_ - i.value().last_access);
+      double distance = 0;
+
+      if (timebase_dbl_ > 0) {
+        distance = qAbs((i.value().time - playhead_).toDouble()) / timebase_dbl_;
+      }
+
+      double score = age + distance;
+
+      if (score > worst_score) {
+        worst = i;
+        worst_score = score;
+      }
+    }
+
+    used_ -= worst.value().data.size();
+    frames_.erase(worst);
+  }
+}
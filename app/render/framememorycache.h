@@ -0,0 +1,105 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FRAMEMEMORYCACHE_H
+#define FRAMEMEMORYCACHE_H
+
+#include <QHash>
+#include <QMutex>
+
+#include "common/rational.h"
+
+/**
+ * @brief A RAM tier for decoded cache frames above the disk-based FrameStore
+ *
+ * Frames are held in the format they're uploaded to the GPU in, so showing a frame from this cache skips reading and
+ * decoding entirely. Frames are promoted here when they're read from disk and inserted directly when they're
+ * downloaded from the GPU. Once the cache goes over its byte budget, frames are demoted (dropped from RAM, the disk
+ * copy is unaffected) by a score combining how long ago they were used and how far they are from the playhead.
+ *
+ * All functions are thread-safe.
+ */
+class FrameMemoryCache
+{
+public:
+  /**
+   * @param budget
+   *
+   * Maximum number of bytes of frame data to hold
+   */
+  FrameMemoryCache(qint64 budget);
+
+  /**
+   * @brief Retrieve a decoded frame, or a null QByteArray if it isn't in memory
+   *
+   * @param time
+   *
+   * The time the frame is being shown at, which becomes its position for eviction purposes
+   */
+  QByteArray Get(const QByteArray& hash, const rational& time);
+
+  /**
+   * @brief Add a decoded frame, evicting others if necessary to stay within budget
+   *
+   * The data is implicitly shared rather than copied.
+   */
+  void Insert(const QByteArray& hash, const rational& time, const QByteArray& data);
+
+  /**
+   * @brief Set the current playhead position and the timebase used to measure distance from it
+   */
+  void SetPlayhead(const rational& time, const rational& timebase);
+
+  void Clear();
+
+private:
+  struct Entry {
+    QByteArray data;
+    rational time;
+    quint64 last_access;
+  };
+
+  /**
+   * @brief Evict frames until we're within budget
+   *
+   * Must be called with lock_ held.
+   */
+  void Evict();
+
+  qint64 budget_;
+
+  qint64 used_;
+
+  QHash<QByteArray, Entry> frames_;
+
+  /**
+   * @brief Incremented on every access, used to measure recency
+   */
+  quint64 access_counter_;
+
+  rational playhead_;
+
+  double timebase_dbl_;
+
+  QMutex lock_;
+
+};
+
+#endif // FRAMEMEMORYCACHE_H
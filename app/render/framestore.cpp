@@ -0,0 +1,497 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "framestore.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include "common/filefunctions.h"
+#include "config/config.h"
+
+/**
+ * @brief Segment ID used in journal records for frames that have been removed
+ */
+const qint32 kJournalTombstone = -1;
+
+bool FrameStore::ReadHandle::isNull() const
+{
+  return data_.isNull();
+}
+
+const QByteArray &FrameStore::ReadHandle::data() const
+{
+  return data_;
+}
+
+FrameStore::Segment::Segment(QFile *file, uchar *data) :
+  file(file),
+  data(data),
+  size(file->size()),
+  used(0),
+  // The file was last modified when a frame was last written to it, which is the best guess we have on startup
+  last_access(QFileInfo(*file).lastModified().toMSecsSinceEpoch()),
+  evicted(false)
+{
+}
+
+FrameStore::Segment::~Segment()
+{
+  file->unmap(data);
+  file->close();
+
+  if (evicted) {
+    file->remove();
+  }
+
+  delete file;
+}
+
+FrameStore::FrameStore(const QString &path, qint64 quota) :
+  dir_(path),
+  quota_(quota),
+  active_segment_id_(-1),
+  journal_(dir_.filePath("index.journal"))
+{
+  stats_ = {0, 0, 0, 0};
+
+  dir_.mkpath(".");
+
+  Recover();
+}
+
+FrameStore::~FrameStore()
+{
+  journal_.close();
+}
+
+FrameStorePtr FrameStore::Shared()
+{
+  static QMutex shared_lock;
+  static FrameStorePtr shared_store;
+
+  shared_lock.lock();
+
+  if (shared_store == nullptr) {
+    shared_store = std::make_shared<FrameStore>(QDir(GetMediaCacheLocation()).filePath("frames"), kFrameStoreQuota);
+  }
+
+  shared_lock.unlock();
+
+  return shared_store;
+}
+
+bool FrameStore::Contains(const QByteArray &hash)
+{
+  lock_.lock();
+
+  QHash<QByteArray, Entry>::const_iterator i = index_.constFind(hash);
+
+  bool contains = (i != index_.constEnd());
+
+  if (contains) {
+    segments_.value(i.value().segment)->last_access = QDateTime::currentMSecsSinceEpoch();
+    stats_.hits++;
+  } else {
+    stats_.misses++;
+  }
+
+  lock_.unlock();
+
+  return contains;
+}
+
+bool FrameStore::Probe(const QByteArray &hash)
+{
+  lock_.lock();
+
+  QHash<QByteArray, Entry>::const_iterator i = index_.constFind(hash);
+
+  bool contains = (i != index_.constEnd());
+
+  if (contains) {
+    segments_.value(i.value().segment)->last_access = QDateTime::currentMSecsSinceEpoch();
+  }
+
+  lock_.unlock();
+
+  return contains;
+}
+
+bool FrameStore::Write(const QByteArray &hash, const QByteArray &data)
+{
+  qint64 length = data.size();
+
+  io_lock_.lock();
+
+  lock_.lock();
+
+  if (index_.contains(hash)) {
+    // Nothing to do
+    lock_.unlock();
+    io_lock_.unlock();
+    return true;
+  }
+
+  bool needs_segment = (active_segment_ == nullptr || active_segment_->size - active_segment_->used < length);
+  int new_id = active_segment_id_ + 1;
+
+  lock_.unlock();
+
+  bool compact = false;
+
+  // Start a new segment if there isn't enough space left in the active one (creating and mapping it is done without
+  // lock_ so lookups can continue in the meantime)
+  if (needs_segment) {
+    SegmentPtr new_segment = OpenSegment(new_id, qMax(kFrameStoreSegmentSize, length));
+
+    if (new_segment == nullptr) {
+      io_lock_.unlock();
+      return false;
+    }
+
+    lock_.lock();
+
+    segments_.insert(new_id, new_segment);
+    active_segment_ = new_segment;
+    active_segment_id_ = new_id;
+
+    stats_.bytes_used += new_segment->size;
+
+    // We've just used more disk space, make sure we're still within the quota
+    compact = (CollectGarbage() > 0);
+
+    lock_.unlock();
+  }
+
+  // Reserve space at the end of the active segment
+  lock_.lock();
+
+  // Hold a reference in case this segment gets evicted while we're writing to it
+  SegmentPtr segment = active_segment_;
+
+  Entry entry = {active_segment_id_, segment->used, length};
+
+  segment->used += length;
+
+  lock_.unlock();
+
+  // Write through the file rather than the mapping so that running out of disk space is an error rather than a crash
+  bool success = (segment->file->seek(entry.offset) && segment->file->write(data) == length);
+
+  if (success) {
+    segment->file->flush();
+  } else {
+    qWarning() << tr("Failed to write frame to \"%1\"").arg(segment->file->fileName());
+  }
+
+  // Only make the frame visible once all of its data is in place
+  lock_.lock();
+
+  // If the segment was evicted while we were writing (very unlikely unless the quota is tiny), the frame is lost
+  bool added = (success && !segment->evicted);
+
+  if (added) {
+    index_.insert(hash, entry);
+
+    segment->last_access = QDateTime::currentMSecsSinceEpoch();
+  }
+
+  // Implicitly shared, so this only copies if the index changes while we're compacting
+  QHash<QByteArray, Entry> index_copy;
+  if (compact) {
+    index_copy = index_;
+  }
+
+  lock_.unlock();
+
+  if (compact) {
+    // The compacted journal already contains this frame if it was added
+    CompactJournal(index_copy);
+  } else if (added) {
+    AppendJournal(hash, entry);
+  }
+
+  io_lock_.unlock();
+
+  return added;
+}
+
+FrameStore::ReadHandle FrameStore::Read(const QByteArray &hash)
+{
+  ReadHandle handle;
+
+  lock_.lock();
+
+  QHash<QByteArray, Entry>::const_iterator i = index_.constFind(hash);
+
+  if (i != index_.constEnd()) {
+    const Entry& entry = i.value();
+
+    handle.segment_ = segments_.value(entry.segment);
+    handle.segment_->last_access = QDateTime::currentMSecsSinceEpoch();
+
+    handle.data_ = QByteArray::fromRawData(reinterpret_cast<const char*>(handle.segment_->data + entry.offset),
+                                           static_cast<int>(entry.length));
+
+    stats_.hits++;
+  } else {
+    stats_.misses++;
+  }
+
+  lock_.unlock();
+
+  return handle;
+}
+
+void FrameStore::Remove(const QByteArray &hash)
+{
+  io_lock_.lock();
+
+  lock_.lock();
+
+  // Any ReadHandles still referencing this frame keep its segment mapped, so it's safe to just drop the entry
+  bool removed = (index_.remove(hash) > 0);
+
+  lock_.unlock();
+
+  // Record the removal so the frame isn't recovered next session
+  if (removed) {
+    AppendJournal(hash, {kJournalTombstone, 0, 0});
+  }
+
+  io_lock_.unlock();
+}
+
+FrameStoreStats FrameStore::GetStats()
+{
+  lock_.lock();
+
+  FrameStoreStats stats = stats_;
+
+  lock_.unlock();
+
+  return stats;
+}
+
+void FrameStore::Recover()
+{
+  // Open every existing segment
+  QStringList segment_files = dir_.entryList({"*.seg"}, QDir::Files);
+
+  foreach (const QString& filename, segment_files) {
+    bool ok;
+    int id = QFileInfo(filename).completeBaseName().toInt(&ok);
+
+    if (!ok) {
+      continue;
+    }
+
+    SegmentPtr segment = OpenSegment(id, 0);
+
+    if (segment != nullptr) {
+      segments_.insert(id, segment);
+      stats_.bytes_used += segment->size;
+    }
+  }
+
+  if (!segments_.isEmpty()) {
+    active_segment_id_ = segments_.lastKey();
+    active_segment_ = segments_.last();
+  }
+
+  if (!journal_.open(QFile::ReadWrite)) {
+    qWarning() << tr("Failed to open frame store journal \"%1\"").arg(journal_.fileName());
+    return;
+  }
+
+  // Replay the journal
+  QDataStream stream(&journal_);
+  stream.setVersion(QDataStream::Qt_5_6);
+
+  qint64 valid_end = 0;
+
+  while (!stream.atEnd()) {
+    QByteArray hash;
+    qint32 segment_id;
+    qint64 offset;
+    qint64 length;
+
+    stream >> hash >> segment_id >> offset >> length;
+
+    if (stream.status() != QDataStream::Ok) {
+      // The last record was only partially written, probably because we crashed while writing it
+      break;
+    }
+
+    valid_end = journal_.pos();
+
+    if (segment_id == kJournalTombstone) {
+      index_.remove(hash);
+      continue;
+    }
+
+    SegmentPtr segment = segments_.value(segment_id);
+
+    if (segment == nullptr || offset < 0 || offset + length > segment->size) {
+      continue;
+    }
+
+    index_.insert(hash, {segment_id, offset, length});
+
+    segment->used = qMax(segment->used, offset + length);
+  }
+
+  // Drop any partial record so new records are appended cleanly
+  journal_.resize(valid_end);
+  journal_.seek(valid_end);
+
+  qDebug() << "Recovered" << index_.size() << "frames from" << dir_.absolutePath();
+
+  // The quota may have been lowered since the last session (nothing else can access the store yet, so there's no
+  // need to copy the index)
+  if (CollectGarbage() > 0) {
+    CompactJournal(index_);
+  }
+}
+
+FrameStore::SegmentPtr FrameStore::OpenSegment(int id, qint64 size)
+{
+  QFile* file = new QFile(SegmentFilename(id));
+
+  if (!file->open(QFile::ReadWrite)) {
+    qWarning() << tr("Failed to open frame store segment \"%1\"").arg(file->fileName());
+    delete file;
+    return nullptr;
+  }
+
+  // Preallocate new segments so they only need to be mapped once
+  if (file->size() < size && !file->resize(size)) {
+    qWarning() << tr("Failed to allocate frame store segment \"%1\"").arg(file->fileName());
+    delete file;
+    return nullptr;
+  }
+
+  uchar* data = file->map(0, file->size());
+
+  if (data == nullptr) {
+    qWarning() << tr("Failed to map frame store segment \"%1\"").arg(file->fileName());
+    delete file;
+    return nullptr;
+  }
+
+  return std::make_shared<Segment>(file, data);
+}
+
+QString FrameStore::SegmentFilename(int id) const
+{
+  return dir_.filePath(QString("%1.seg").arg(id, 8, 10, QChar('0')));
+}
+
+void FrameStore::AppendJournal(const QByteArray &hash, const Entry &entry)
+{
+  QDataStream stream(&journal_);
+  stream.setVersion(QDataStream::Qt_5_6);
+
+  stream << hash << static_cast<qint32>(entry.segment) << entry.offset << entry.length;
+
+  journal_.flush();
+}
+
+void FrameStore::CompactJournal(const QHash<QByteArray, Entry> &index)
+{
+  QSaveFile compacted(journal_.fileName());
+
+  if (!compacted.open(QFile::WriteOnly)) {
+    qWarning() << tr("Failed to compact frame store journal \"%1\"").arg(journal_.fileName());
+    return;
+  }
+
+  QDataStream stream(&compacted);
+  stream.setVersion(QDataStream::Qt_5_6);
+
+  for (QHash<QByteArray, Entry>::const_iterator i=index.constBegin();i!=index.constEnd();i++) {
+    stream << i.key() << static_cast<qint32>(i.value().segment) << i.value().offset << i.value().length;
+  }
+
+  journal_.close();
+
+  if (!compacted.commit()) {
+    qWarning() << tr("Failed to compact frame store journal \"%1\"").arg(journal_.fileName());
+  }
+
+  if (journal_.open(QFile::ReadWrite)) {
+    journal_.seek(journal_.size());
+  }
+}
+
+int FrameStore::CollectGarbage()
+{
+  int evicted_count = 0;
+
+  while (stats_.bytes_used > quota_ && segments_.size() > 1) {
+    // Find least recently used segment (never the one we're currently writing to)
+    QMap<int, SegmentPtr>::iterator lru = segments_.end();
+
+    for (QMap<int, SegmentPtr>::iterator i=segments_.begin();i!=segments_.end();i++) {
+      if (i.value() != active_segment_
+          && (lru == segments_.end() || i.value()->last_access < lru.value()->last_access)) {
+        lru = i;
+      }
+    }
+
+    if (lru == segments_.end()) {
+      break;
+    }
+
+    int lru_id = lru.key();
+
+    // Forget every frame in this segment
+    QHash<QByteArray, Entry>::iterator i = index_.begin();
+    while (i != index_.end()) {
+      if (i.value().segment == lru_id) {
+        i = index_.erase(i);
+      } else {
+        i++;
+      }
+    }
+
+    // The file is deleted once any outstanding ReadHandles have been released
+    lru.value()->evicted = true;
+
+    stats_.bytes_used -= lru.value()->size;
+    stats_.evictions++;
+
+    segments_.erase(lru);
+
+    evicted_count++;
+  }
+
+  if (evicted_count > 0) {
+    qDebug() << "Evicted" << evicted_count << "segments from frame store, now using" << stats_.bytes_used
+             << "bytes with" << stats_.hits << "hits," << stats_.misses << "misses and" << stats_.evictions
+             << "evictions";
+  }
+
+  return evicted_count;
+}
@@ -0,0 +1,237 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FRAMESTORE_H
+#define FRAMESTORE_H
+
+#include <memory>
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+
+/**
+ * @brief Usage statistics for a FrameStore
+ */
+struct FrameStoreStats {
+  qint64 bytes_used;
+  qint64 hits;
+  qint64 misses;
+  qint64 evictions;
+};
+
+/**
+ * @brief A persistent, log-structured store for encoded cache frames
+ *
+ * Rather than one file per frame, frames are appended to large preallocated segment files that are memory mapped
+ * once when they're opened. An in-memory index maps each frame's hash to its location, so checking whether a frame
+ * exists never touches the filesystem. Every write is also appended to a journal file in the store's directory, which
+ * is replayed to rebuild the index when the store is opened again.
+ *
+ * Frames are addressed purely by content hash, so one store is shared by every sequence (see Shared()) and survives
+ * between sessions. Once the store exceeds its quota, whole segments are evicted least recently used first.
+ *
+ * All functions are thread-safe.
+ */
+class FrameStore : public QObject
+{
+  Q_OBJECT
+private:
+  class Segment;
+  using SegmentPtr = std::shared_ptr<Segment>;
+
+public:
+  /**
+   * @brief A frame retrieved with Read()
+   *
+   * data() points directly into the mapped segment. The segment stays mapped for as long as this object exists, even
+   * if it gets evicted in the meantime.
+   */
+  class ReadHandle {
+  public:
+    bool isNull() const;
+
+    const QByteArray& data() const;
+
+  private:
+    QByteArray data_;
+
+    SegmentPtr segment_;
+
+    friend class FrameStore;
+  };
+
+  /**
+   * @brief Open (or create) a frame store in a directory, recovering any frames already in it
+   *
+   * @param quota
+   *
+   * Maximum number of bytes the store's segments are allowed to use on disk
+   */
+  FrameStore(const QString& path, qint64 quota);
+
+  virtual ~FrameStore() override;
+
+  /**
+   * @brief Return the frame store shared by every Renderer, creating it if necessary
+   */
+  static std::shared_ptr<FrameStore> Shared();
+
+  /**
+   * @brief Returns whether a frame with this hash has been stored
+   *
+   * This counts as a use of the frame for the purposes of eviction and statistics.
+   */
+  bool Contains(const QByteArray& hash);
+
+  /**
+   * @brief Same as Contains() but without affecting the hit/miss statistics
+   *
+   * For internal checks (e.g. whether a frame needs rendering) that shouldn't count as a frame being requested.
+   */
+  bool Probe(const QByteArray& hash);
+
+  /**
+   * @brief Append a frame to the store
+   *
+   * @return False if the frame could not be written
+   */
+  bool Write(const QByteArray& hash, const QByteArray& data);
+
+  /**
+   * @brief Retrieve a frame from the store without copying it
+   *
+   * This counts towards the hit/miss statistics.
+   *
+   * @return A handle to the frame's data, or a null handle if no frame with this hash exists
+   */
+  ReadHandle Read(const QByteArray& hash);
+
+  /**
+   * @brief Forget a frame, e.g. because its data turned out to be unreadable
+   *
+   * The frame's space isn't reclaimed until its segment is evicted, but it will never be returned again (including in
+   * future sessions), so it can be rendered and written again.
+   */
+  void Remove(const QByteArray& hash);
+
+  FrameStoreStats GetStats();
+
+private:
+  struct Entry {
+    int segment;
+    qint64 offset;
+    qint64 length;
+  };
+
+  class Segment {
+  public:
+    Segment(QFile* file, uchar* data);
+
+    ~Segment();
+
+    QFile* file;
+    uchar* data;
+    qint64 size;
+    qint64 used;
+    qint64 last_access;
+
+    /**
+     * @brief Set when the segment is evicted so its file is deleted once the last ReadHandle is gone
+     */
+    bool evicted;
+  };
+
+  /**
+   * @brief Open existing segments and replay the journal to rebuild the index
+   */
+  void Recover();
+
+  /**
+   * @brief Open and map a segment file, creating and preallocating it if necessary
+   */
+  SegmentPtr OpenSegment(int id, qint64 size);
+
+  QString SegmentFilename(int id) const;
+
+  /**
+   * @brief Must be called with io_lock_ held (and not lock_)
+   *
+   * An entry with kJournalTombstone as its segment records that the frame was removed.
+   */
+  void AppendJournal(const QByteArray& hash, const Entry& entry);
+
+  /**
+   * @brief Rewrite the journal from a copy of the index, dropping records for evicted segments
+   *
+   * Must be called with io_lock_ held (and not lock_).
+   */
+  void CompactJournal(const QHash<QByteArray, Entry>& index);
+
+  /**
+   * @brief Evict least recently used segments from the index until the store is within its quota
+   *
+   * Segment files are deleted once the last ReadHandle referencing them is gone, and the journal isn't touched (use
+   * CompactJournal() once lock_ has been released). Must be called with lock_ held.
+   *
+   * @return The number of segments that were evicted
+   */
+  int CollectGarbage();
+
+  QDir dir_;
+
+  qint64 quota_;
+
+  QMap<int, SegmentPtr> segments_;
+
+  /**
+   * @brief The segment new frames are currently appended to (always the one with the highest ID)
+   */
+  SegmentPtr active_segment_;
+
+  int active_segment_id_;
+
+  QHash<QByteArray, Entry> index_;
+
+  QFile journal_;
+
+  FrameStoreStats stats_;
+
+  /**
+   * @brief Protects the index, segment list and stats
+   *
+   * No file I/O is ever done while holding this, so lookups are never blocked on I/O.
+   */
+  QMutex lock_;
+
+  /**
+   * @brief Serializes everything that does file I/O: creating segments, writing frames and writing the journal
+   *
+   * Only writers take this, always before lock_ if they need both. Since only writers change the active segment, it
+   * can't change while this is held.
+   */
+  QMutex io_lock_;
+
+};
+
+using FrameStorePtr = std::shared_ptr<FrameStore>;
+
+#endif // FRAMESTORE_H
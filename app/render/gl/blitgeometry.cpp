@@ -0,0 +1,178 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+#include "blitgeometry.h"
+
+#include <QOpenGLFunctions>
+#include <QSurface>
+
+const GLfloat blit_vertices[] = {
+  -1.0f, -1.0f, 0.0f,
+  1.0f, -1.0f, 0.0f,
+  1.0f, 1.0f, 0.0f,
+
+  -1.0f, -1.0f, 0.0f,
+  -1.0f, 1.0f, 0.0f,
+  1.0f, 1.0f, 0.0f
+};
+
+const GLfloat blit_texcoords[] = {
+  0.0, 0.0,
+  1.0, 0.0,
+  1.0, 1.0,
+
+  0.0, 0.0,
+  0.0, 1.0,
+  1.0, 1.0
+};
+
+const GLfloat flipped_blit_texcoords[] = {
+  0.0, 1.0,
+  1.0, 1.0,
+  1.0, 0.0,
+
+  0.0, 1.0,
+  0.0, 0.0,
+  1.0, 0.0
+};
+
+BlitGeometry::BlitGeometry(QOpenGLContext *ctx) :
+  QObject(ctx),
+  context_(ctx),
+  bound_(nullptr)
+{
+}
+
+BlitGeometry *BlitGeometry::Get(QOpenGLContext *ctx)
+{
+  BlitGeometry* geom = nullptr;
+
+  foreach (QObject* child, ctx->children()) {
+    geom = dynamic_cast<BlitGeometry*>(child);
+
+    if (geom != nullptr) {
+      break;
+    }
+  }
+
+  if (geom == nullptr) {
+    geom = new BlitGeometry(ctx);
+  }
+
+  if (!geom->vertices_.isCreated()) {
+    geom->Create();
+  }
+
+  return geom;
+}
+
+void BlitGeometry::Bind(int position, int texcoord, bool flipped)
+{
+  for (int i=0;i<layouts_.size();i++) {
+    const Layout& layout = layouts_.at(i);
+
+    if (layout.position == position && layout.texcoord == texcoord && layout.flipped == flipped) {
+      bound_ = layout.vao;
+      bound_->bind();
+      return;
+    }
+  }
+
+  // First time drawing with this layout, point a new vertex array's attributes at the quad
+  Layout layout = {position, texcoord, flipped, new QOpenGLVertexArrayObject()};
+
+  layout.vao->create();
+  layout.vao->bind();
+
+  SetAttribute(context_, &vertices_, position, 3);
+  SetAttribute(context_, flipped ? &flipped_texcoords_ : &texcoords_, texcoord, 2);
+
+  layouts_.append(layout);
+
+  bound_ = layout.vao;
+}
+
+void BlitGeometry::Release()
+{
+  if (bound_ != nullptr) {
+    bound_->release();
+    bound_ = nullptr;
+  }
+}
+
+void BlitGeometry::Destroy()
+{
+  disconnect(context_, SIGNAL(aboutToBeDestroyed()), this, SLOT(Destroy()));
+
+  // The context is usually still current while it's being destroyed, but make sure before deleting anything in it
+  bool make_current = (QOpenGLContext::currentContext() != context_ && context_->surface() != nullptr);
+
+  if (make_current) {
+    context_->makeCurrent(context_->surface());
+  }
+
+  foreach (const Layout& layout, layouts_) {
+    layout.vao->destroy();
+    delete layout.vao;
+  }
+  layouts_.clear();
+  bound_ = nullptr;
+
+  vertices_.destroy();
+  texcoords_.destroy();
+  flipped_texcoords_.destroy();
+
+  if (make_current) {
+    context_->doneCurrent();
+  }
+}
+
+void BlitGeometry::Create()
+{
+  Allocate(&vertices_, blit_vertices, 18);
+  Allocate(&texcoords_, blit_texcoords, 12);
+  Allocate(&flipped_texcoords_, flipped_blit_texcoords, 12);
+
+  // Delete everything while the context can still be made current, rather than after it's gone
+  connect(context_, SIGNAL(aboutToBeDestroyed()), this, SLOT(Destroy()), Qt::DirectConnection);
+}
+
+void BlitGeometry::Allocate(QOpenGLBuffer *buffer, const GLfloat *data, int count)
+{
+  buffer->create();
+  buffer->bind();
+  buffer->allocate(data, count * static_cast<int>(sizeof(GLfloat)));
+  buffer->release();
+}
+
+void BlitGeometry::SetAttribute(QOpenGLContext *ctx, QOpenGLBuffer *buffer, int location, int size)
+{
+  // Programs that don't use an attribute report its location as -1
+  if (location < 0) {
+    return;
+  }
+
+  QOpenGLFunctions* func = ctx->functions();
+
+  // The vertex array records which buffer each attribute reads from, so the buffer can be released straight away
+  buffer->bind();
+  func->glEnableVertexAttribArray(static_cast<GLuint>(location));
+  func->glVertexAttribPointer(static_cast<GLuint>(location), size, GL_FLOAT, GL_FALSE, 0, nullptr);
+  buffer->release();
+}
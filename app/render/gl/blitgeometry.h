@@ -0,0 +1,103 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+#ifndef BLITGEOMETRY_H
+#define BLITGEOMETRY_H
+
+#include <QOpenGLBuffer>
+#include <QOpenGLContext>
+#include <QOpenGLVertexArrayObject>
+#include <QVector>
+
+/**
+ * @brief Vertex arrays and buffers used by olive::gl::Blit(), created once per context
+ *
+ * The quad never changes so it's uploaded once. Each shader program may read it from different attribute locations,
+ * so a vertex array is set up for each layout the first time it's drawn with and after that drawing only needs to bind
+ * it. VAOs can't be shared between contexts so each context gets its own BlitGeometry, use BlitGeometry::Get() to
+ * retrieve it.
+ */
+class BlitGeometry : public QObject
+{
+  Q_OBJECT
+public:
+  /**
+   * @brief Return the BlitGeometry belonging to `ctx`, creating it if necessary
+   *
+   * `ctx` must be current.
+   */
+  static BlitGeometry* Get(QOpenGLContext* ctx);
+
+  /**
+   * @brief Bind a vertex array that feeds the quad to the attributes at `position` and `texcoord`
+   *
+   * @param flipped
+   *
+   * Use vertically flipped texture coordinates
+   */
+  void Bind(int position, int texcoord, bool flipped);
+
+  /**
+   * @brief Release the vertex array bound by Bind()
+   */
+  void Release();
+
+public slots:
+  /**
+   * @brief Destroy every GL object, called when the context is about to be destroyed
+   */
+  void Destroy();
+
+private:
+  BlitGeometry(QOpenGLContext* ctx);
+
+  /**
+   * @brief Upload the quad, done on first use and again if the context was destroyed and recreated since
+   */
+  void Create();
+
+  struct Layout {
+    int position;
+    int texcoord;
+    bool flipped;
+    QOpenGLVertexArrayObject* vao;
+  };
+
+  static void Allocate(QOpenGLBuffer* buffer, const GLfloat* data, int count);
+
+  static void SetAttribute(QOpenGLContext* ctx, QOpenGLBuffer* buffer, int location, int size);
+
+  QOpenGLContext* context_;
+
+  QOpenGLBuffer vertices_;
+
+  QOpenGLBuffer texcoords_;
+
+  QOpenGLBuffer flipped_texcoords_;
+
+  QVector<Layout> layouts_;
+
+  /**
+   * @brief The vertex array currently bound by Bind()
+   */
+  QOpenGLVertexArrayObject* bound_;
+
+};
+
+#endif // BLITGEOMETRY_H
@@ -20,53 +20,130 @@
 
 #include "functions.h"
 
-#include <QOpenGLFunctions>
+#include <QMutex>
+#include <QOpenGLContext>
 #include <QOpenGLExtraFunctions>
-#include <QOpenGLVertexArrayObject>
-#include <QOpenGLBuffer>
+#include <QOpenGLFunctions>
+#include <QPair>
+#include <QSet>
+#include <QVector2D>
 
-const GLfloat blit_vertices[] = {
-  -1.0f, -1.0f, 0.0f,
-  1.0f, -1.0f, 0.0f,
-  1.0f, 1.0f, 0.0f,
+#include "blitgeometry.h"
 
-  -1.0f, -1.0f, 0.0f,
-  -1.0f, 1.0f, 0.0f,
-  1.0f, 1.0f, 0.0f
-};
+/**
+ * @brief Uniform and attribute locations used by Blit(), looked up once per shader program
+ *
+ * Kept as a child of the program so they're discarded along with it. Use BlitLocations::Get() to retrieve them.
+ */
+class BlitLocations : public QObject
+{
+public:
+  static BlitLocations* Get(QOpenGLShaderProgram* program)
+  {
+    foreach (QObject* child, program->children()) {
+      BlitLocations* loc = dynamic_cast<BlitLocations*>(child);
 
-const GLfloat blit_texcoords[] = {
-  0.0, 0.0,
-  1.0, 0.0,
-  1.0, 1.0,
+      if (loc != nullptr) {
+        return loc;
+      }
+    }
 
-  0.0, 0.0,
-  0.0, 1.0,
-  1.0, 1.0
-};
+    return new BlitLocations(program);
+  }
+
+  int mvp_matrix;
+
+  int texture;
 
-const GLfloat flipped_blit_texcoords[] = {
-  0.0, 1.0,
-  1.0, 1.0,
-  1.0, 0.0,
+  int position;
 
-  0.0, 1.0,
-  0.0, 0.0,
-  1.0, 0.0
+  int texcoord;
+
+private:
+  BlitLocations(QOpenGLShaderProgram* program) :
+    QObject(program)
+  {
+    mvp_matrix = program->uniformLocation("mvp_matrix");
+    texture = program->uniformLocation("texture");
+    position = program->attributeLocation("a_position");
+    texcoord = program->attributeLocation("a_texcoord");
+  }
 };
 
+/**
+ * @brief Textures whose mipmaps are up to date with their level 0 contents
+ *
+ * Keyed by share group since texture names are shared between contexts in the same group. Entries are removed by
+ * olive::gl::TextureChanged().
+ */
+QSet<QPair<QOpenGLContextGroup*, GLuint>> mipmapped_textures;
+
+/**
+ * @brief Mutex for mipmapped_textures (textures are drawn from several render threads)
+ */
+QMutex mipmapped_textures_lock;
+
 /**
  * @brief Set up texture parameters and mipmap for drawing
  *
  * Internal function used just before drawing to allow mipmapped bilinear filtering when drawing textures small.
+ * Mipmaps are only generated when the texture will actually be minified, and only once after each change to its
+ * contents (see olive::gl::TextureChanged()). Otherwise plain bilinear filtering is used.
+ *
+ * @param ctx
+ *
+ * Currently active context
  *
- * @param f
+ * @param matrix
  *
- * Currently active QOpenGLFunctions object (use context()->functions() if unsure).
+ * Transformation matrix the texture will be drawn with
  */
-void PrepareToDraw(QOpenGLFunctions* f) {
-  f->glGenerateMipmap(GL_TEXTURE_2D);
-  f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+void PrepareToDraw(QOpenGLContext* ctx, const QMatrix4x4& matrix) {
+  QOpenGLFunctions* f = ctx->functions();
+  QOpenGLExtraFunctions* xf = ctx->extraFunctions();
+
+  GLint texture;
+  f->glGetIntegerv(GL_TEXTURE_BINDING_2D, &texture);
+
+  bool minified = false;
+
+  if (texture != 0) {
+    GLint tex_width, tex_height;
+    xf->glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &tex_width);
+    xf->glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &tex_height);
+
+    GLint viewport[4];
+    f->glGetIntegerv(GL_VIEWPORT, viewport);
+
+    // The quad spans -1 to 1 on each axis, so the transformed basis vectors give its size on screen
+    QVector4D x_axis = matrix.column(0);
+    QVector4D y_axis = matrix.column(1);
+
+    float drawn_width = QVector2D(x_axis.x(), x_axis.y()).length() * viewport[2];
+    float drawn_height = QVector2D(y_axis.x(), y_axis.y()).length() * viewport[3];
+
+    minified = (drawn_width < tex_width || drawn_height < tex_height);
+  }
+
+  if (minified) {
+    QPair<QOpenGLContextGroup*, GLuint> key(ctx->shareGroup(), static_cast<GLuint>(texture));
+
+    mipmapped_textures_lock.lock();
+    bool generate = !mipmapped_textures.contains(key);
+    if (generate) {
+      mipmapped_textures.insert(key);
+    }
+    mipmapped_textures_lock.unlock();
+
+    if (generate) {
+      f->glGenerateMipmap(GL_TEXTURE_2D);
+    }
+
+    f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  } else {
+    f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  }
+
   f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
   f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
   f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
@@ -74,51 +151,34 @@ void PrepareToDraw(QOpenGLFunctions* f) {
 
 void olive::gl::Blit(ShaderPtr pipeline, bool flipped, QMatrix4x4 matrix) {
   // FIXME: is currentContext() reliable here?
-  QOpenGLFunctions* func = QOpenGLContext::currentContext()->functions();
-
-  PrepareToDraw(func);
-
-  QOpenGLVertexArrayObject m_vao;
-  m_vao.create();
-  m_vao.bind();
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+  QOpenGLFunctions* func = ctx->functions();
 
-  QOpenGLBuffer m_vbo;
-  m_vbo.create();
-  m_vbo.bind();
-  m_vbo.allocate(blit_vertices, 18 * static_cast<int>(sizeof(GLfloat)));
-  m_vbo.release();
+  PrepareToDraw(ctx, matrix);
 
-  QOpenGLBuffer m_vbo2;
-  m_vbo2.create();
-  m_vbo2.bind();
-  m_vbo2.allocate(flipped ? flipped_blit_texcoords : blit_texcoords, 12 * static_cast<int>(sizeof(GLfloat)));
-  m_vbo2.release();
+  BlitGeometry* geom = BlitGeometry::Get(ctx);
+  BlitLocations* loc = BlitLocations::Get(pipeline.get());
 
   pipeline->bind();
 
-  pipeline->setUniformValue("mvp_matrix", matrix);
-  pipeline->setUniformValue("texture", 0);
-
-  GLuint vertex_location = static_cast<GLuint>(pipeline->attributeLocation("a_position"));
-  m_vbo.bind();
-  func->glEnableVertexAttribArray(vertex_location);
-  func->glVertexAttribPointer(vertex_location, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-  m_vbo.release();
+  pipeline->setUniformValue(loc->mvp_matrix, matrix);
+  pipeline->setUniformValue(loc->texture, 0);
 
-  GLuint tex_location = static_cast<GLuint>(pipeline->attributeLocation("a_texcoord"));
-  m_vbo2.bind();
-  func->glEnableVertexAttribArray(tex_location);
-  func->glVertexAttribPointer(tex_location, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
-  m_vbo2.release();
+  // The vertex array for this program's attribute layout already points at the quad
+  geom->Bind(loc->position, loc->texcoord, flipped);
 
   func->glDrawArrays(GL_TRIANGLES, 0, 6);
 
+  geom->Release();
+
   pipeline->release();
+}
 
-  m_vbo2.destroy();
-  m_vbo.destroy();
-  m_vao.release();
-  m_vao.destroy();
+void olive::gl::TextureChanged(QOpenGLContext *ctx, GLuint texture)
+{
+  mipmapped_textures_lock.lock();
+  mipmapped_textures.remove(QPair<QOpenGLContextGroup*, GLuint>(ctx->shareGroup(), texture));
+  mipmapped_textures_lock.unlock();
 }
 
 void olive::gl::OCIOBlit(ShaderPtr pipeline,
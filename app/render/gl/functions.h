@@ -22,6 +22,7 @@
 #define GLFUNC_H
 
 #include <QMatrix4x4>
+#include <QOpenGLContext>
 
 #include "shaderptr.h"
 
@@ -47,6 +48,14 @@ void Blit(ShaderPtr pipeline, bool flipped = false, QMatrix4x4 matrix = QMatrix4
 
 void OCIOBlit(ShaderPtr pipeline, GLuint lut, bool flipped = false, QMatrix4x4 matrix = QMatrix4x4());
 
+/**
+ * @brief Notify that the contents of a texture have changed
+ *
+ * Blit() only regenerates a texture's mipmaps when they're needed and out of date, so anything that writes to a texture
+ * (uploading, rendering into it, deleting it) must call this afterwards.
+ */
+void TextureChanged(QOpenGLContext* ctx, GLuint texture);
+
 }
 }
 
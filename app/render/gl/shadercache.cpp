@@ -0,0 +1,267 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "shadercache.h"
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QOpenGLExtraFunctions>
+#include <QSaveFile>
+
+#include "common/filefunctions.h"
+
+namespace olive {
+
+/**
+ * @brief Identifies the layout of binary files written to the shader cache, bump this if it changes
+ */
+const quint32 kShaderCacheFileVersion = 1;
+
+/**
+ * @brief A linked program retrieved with glGetProgramBinary()
+ */
+struct ProgramBinary {
+  GLenum format;
+  QByteArray data;
+};
+
+/**
+ * @brief Binaries already loaded or linked in this session, keyed by driver string and source hash
+ */
+QHash<QByteArray, ProgramBinary> shader_binaries;
+
+ShaderCacheStats shader_stats = {0, 0};
+
+/**
+ * @brief Mutex for shader_binaries and shader_stats
+ */
+QMutex shader_cache_lock;
+
+/**
+ * @brief Return a string that identifies the driver, binaries from any other driver can't be loaded
+ */
+QByteArray GetDriverString(QOpenGLContext* ctx)
+{
+  QOpenGLFunctions* f = ctx->functions();
+
+  QByteArray driver;
+
+  driver.append(reinterpret_cast<const char*>(f->glGetString(GL_VENDOR)));
+  driver.append('\n');
+  driver.append(reinterpret_cast<const char*>(f->glGetString(GL_RENDERER)));
+  driver.append('\n');
+  driver.append(reinterpret_cast<const char*>(f->glGetString(GL_VERSION)));
+
+  return driver;
+}
+
+bool SupportsProgramBinaries(QOpenGLContext* ctx)
+{
+  if (ctx->format().version() < qMakePair(4, 1)
+      && !ctx->hasExtension("GL_ARB_get_program_binary")) {
+    return false;
+  }
+
+  // Drivers are allowed to support the functions while not supporting any binary formats
+  GLint formats = 0;
+  ctx->functions()->glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+
+  return (formats > 0);
+}
+
+QString GetBinaryFilename(const QByteArray& key)
+{
+  return QDir(GetShaderCacheLocation()).filePath(QString::fromLatin1(key));
+}
+
+/**
+ * @brief Find a binary for this source hash, either in memory or on disk
+ */
+bool FindBinary(const QByteArray& driver, const QByteArray& key, ProgramBinary* binary)
+{
+  QByteArray memory_key = driver + '\n' + key;
+
+  shader_cache_lock.lock();
+  QHash<QByteArray, ProgramBinary>::const_iterator it = shader_binaries.constFind(memory_key);
+  bool found = (it != shader_binaries.constEnd());
+  if (found) {
+    *binary = it.value();
+  }
+  shader_cache_lock.unlock();
+
+  if (found) {
+    return true;
+  }
+
+  QFile file(GetBinaryFilename(key));
+
+  if (!file.open(QFile::ReadOnly)) {
+    return false;
+  }
+
+  QDataStream stream(&file);
+
+  quint32 version;
+  QByteArray file_driver;
+  quint32 format;
+  QByteArray data;
+
+  stream >> version;
+
+  if (version != kShaderCacheFileVersion) {
+    return false;
+  }
+
+  stream >> file_driver >> format >> data;
+
+  // Binaries from another driver (or another version of the same driver) can't be used
+  if (stream.status() != QDataStream::Ok || file_driver != driver || data.isEmpty()) {
+    return false;
+  }
+
+  binary->format = static_cast<GLenum>(format);
+  binary->data = data;
+
+  shader_cache_lock.lock();
+  shader_binaries.insert(memory_key, *binary);
+  shader_cache_lock.unlock();
+
+  return true;
+}
+
+void StoreBinary(const QByteArray& driver, const QByteArray& key, const ProgramBinary& binary)
+{
+  shader_cache_lock.lock();
+  shader_binaries.insert(driver + '\n' + key, binary);
+  shader_cache_lock.unlock();
+
+  // QSaveFile only replaces the existing file once everything was written, so other threads never read half a file
+  QSaveFile file(GetBinaryFilename(key));
+
+  if (!file.open(QFile::WriteOnly)) {
+    qWarning() << QCoreApplication::translate("ShaderCache", "Failed to write shader cache file %1").arg(file.fileName());
+    return;
+  }
+
+  QDataStream stream(&file);
+
+  stream << kShaderCacheFileVersion << driver << static_cast<quint32>(binary.format) << binary.data;
+
+  file.commit();
+}
+
+void ForgetBinary(const QByteArray &driver, const QByteArray &key)
+{
+  shader_cache_lock.lock();
+  shader_binaries.remove(driver + '\n' + key);
+  shader_cache_lock.unlock();
+
+  QFile::remove(GetBinaryFilename(key));
+}
+
+ShaderPtr ShaderCache::Get(QOpenGLContext *ctx, const QString &vert_shader, const QString &frag_shader)
+{
+  QOpenGLExtraFunctions* xf = ctx->extraFunctions();
+
+  ShaderPtr program = std::make_shared<QOpenGLShaderProgram>();
+
+  bool use_binaries = SupportsProgramBinaries(ctx);
+
+  QByteArray driver;
+  QByteArray key;
+
+  if (use_binaries) {
+    driver = GetDriverString(ctx);
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(vert_shader.toUtf8());
+    hash.addData("\0", 1);
+    hash.addData(frag_shader.toUtf8());
+    key = hash.result().toHex();
+
+    ProgramBinary binary;
+
+    if (FindBinary(driver, key, &binary)) {
+      program->create();
+
+      xf->glProgramBinary(program->programId(), binary.format, binary.data.constData(), binary.data.size());
+
+      // With no shaders attached, link() just checks whether the binary was accepted
+      if (program->link()) {
+        shader_cache_lock.lock();
+        shader_stats.loaded++;
+        shader_cache_lock.unlock();
+
+        return program;
+      }
+
+      // The driver rejected the binary (e.g. it was updated without its version string changing), compile it again
+      ForgetBinary(driver, key);
+
+      program = std::make_shared<QOpenGLShaderProgram>();
+    }
+  }
+
+  program->addShaderFromSourceCode(QOpenGLShader::Vertex, vert_shader);
+  program->addShaderFromSourceCode(QOpenGLShader::Fragment, frag_shader);
+
+  if (use_binaries) {
+    xf->glProgramParameteri(program->programId(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+
+  bool linked = program->link();
+
+  shader_cache_lock.lock();
+  shader_stats.compiled++;
+  shader_cache_lock.unlock();
+
+  if (linked && use_binaries) {
+    GLint length = 0;
+    xf->glGetProgramiv(program->programId(), GL_PROGRAM_BINARY_LENGTH, &length);
+
+    if (length > 0) {
+      ProgramBinary binary;
+
+      binary.data.resize(length);
+      xf->glGetProgramBinary(program->programId(), length, nullptr, &binary.format, binary.data.data());
+
+      StoreBinary(driver, key, binary);
+    }
+  }
+
+  return program;
+}
+
+ShaderCacheStats ShaderCache::GetStats()
+{
+  shader_cache_lock.lock();
+  ShaderCacheStats stats = shader_stats;
+  shader_cache_lock.unlock();
+
+  return stats;
+}
+
+}
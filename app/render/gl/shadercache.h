@@ -0,0 +1,77 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef SHADERCACHE_H
+#define SHADERCACHE_H
+
+#include <QOpenGLContext>
+
+#include "shaderptr.h"
+
+namespace olive {
+
+/**
+ * @brief Usage statistics for the ShaderCache
+ */
+struct ShaderCacheStats {
+  qint64 compiled;
+  qint64 loaded;
+};
+
+/**
+ * @brief Creates shader programs, reusing previously linked program binaries where possible
+ *
+ * Every program that's linked is retrieved with glGetProgramBinary() and kept both in memory and on disk (see
+ * GetShaderCacheLocation()), keyed by a hash of its source code. Requesting the same source again, in any context or
+ * in a later session, loads the binary with glProgramBinary() instead of compiling and linking the GLSL again.
+ *
+ * Binaries are only valid for the driver that produced them, so each one is stored with the driver's vendor, renderer
+ * and version strings and ignored if they don't match. If the context doesn't support program binaries, programs are
+ * simply compiled from source.
+ *
+ * Each call still returns a new program object. Uniform values are stored in the program, so sharing one between
+ * contexts would let render threads overwrite each other's uniforms.
+ *
+ * All functions are thread-safe.
+ */
+class ShaderCache
+{
+public:
+  /**
+   * @brief Create a linked shader program from vertex and fragment shader source code
+   *
+   * @param ctx
+   *
+   * Context to create the program in, must be current
+   *
+   * @return The program, which may not be linked if the source code failed to compile
+   */
+  static ShaderPtr Get(QOpenGLContext* ctx, const QString& vert_shader, const QString& frag_shader);
+
+  /**
+   * @brief Return how many programs have been compiled from source and how many were loaded from binaries
+   */
+  static ShaderCacheStats GetStats();
+
+};
+
+}
+
+#endif // SHADERCACHE_H
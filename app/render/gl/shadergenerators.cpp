@@ -22,31 +22,38 @@
 
 #include <QOpenGLExtraFunctions>
 
+#include "shadercache.h"
+
 namespace olive {
 
+/**
+ * @brief Vertex shader shared by all pipelines, which all draw a textured quad with olive::gl::Blit()
+ */
+QString DefaultVertexShader() {
+  return "#version 110\n"
+         "\n"
+         "#ifdef GL_ES\n"
+         "precision mediump int;\n"
+         "precision mediump float;\n"
+         "#endif\n"
+         "\n"
+         "uniform mat4 mvp_matrix;\n"
+         "\n"
+         "attribute vec4 a_position;\n"
+         "attribute vec2 a_texcoord;\n"
+         "\n"
+         "varying vec2 v_texcoord;\n"
+         "\n"
+         "void main() {\n"
+         "  gl_Position = mvp_matrix * a_position;\n"
+         "  v_texcoord = a_texcoord;\n"
+         "}\n";
+}
+
 ShaderPtr ShaderGenerator::DefaultPipeline(const QString& function_name, const QString& shader_code)
 {
-  ShaderPtr program = std::make_shared<QOpenGLShaderProgram>();
-
   // Generate vertex shader
-  QString vert_shader = "#version 110\n"
-                        "\n"
-                        "#ifdef GL_ES\n"
-                        "precision mediump int;\n"
-                        "precision mediump float;\n"
-                        "#endif\n"
-                        "\n"
-                        "uniform mat4 mvp_matrix;\n"
-                        "\n"
-                        "attribute vec4 a_position;\n"
-                        "attribute vec2 a_texcoord;\n"
-                        "\n"
-                        "varying vec2 v_texcoord;\n"
-                        "\n"
-                        "void main() {\n"
-                        "  gl_Position = mvp_matrix * a_position;\n"
-                        "  v_texcoord = a_texcoord;\n"
-                        "}\n";
+  QString vert_shader = DefaultVertexShader();
 
   // Generate fragment shader
   QString frag_shader = "#version 110\n"
@@ -100,10 +107,8 @@ ShaderPtr ShaderGenerator::DefaultPipeline(const QString& function_name, const Q
 
 
 
-  // Add shaders to program
-  program->addShaderFromSourceCode(QOpenGLShader::Vertex, vert_shader);
-  program->addShaderFromSourceCode(QOpenGLShader::Fragment, frag_shader);
-  program->link();
+  // Create program (or load it from the cache)
+  ShaderPtr program = ShaderCache::Get(QOpenGLContext::currentContext(), vert_shader, frag_shader);
 
   // Set opacity default to 100%
   program->bind();
@@ -113,6 +118,59 @@ ShaderPtr ShaderGenerator::DefaultPipeline(const QString& function_name, const Q
   return program;
 }
 
+ShaderPtr ShaderGenerator::CompositorPipeline(int layers)
+{
+  QString frag_shader = "#version 110\n"
+                        "\n"
+                        "#ifdef GL_ES\n"
+                        "precision mediump int;\n"
+                        "precision mediump float;\n"
+                        "#endif\n"
+                        "\n"
+                        "varying vec2 v_texcoord;\n"
+                        "\n";
+
+  for (int i=0;i<layers;i++) {
+    frag_shader.append(QString("uniform sampler2D layer%1;\n"
+                               "uniform float opacity%1;\n"
+                               "uniform int mode%1;\n").arg(i));
+  }
+
+  // Blend modes match CompositorNode::BlendMode, all colors have associated alpha
+  frag_shader.append("\n"
+                     "vec4 blend(vec4 dst, vec4 src, int mode) {\n"
+                     "  if (mode == 1) {\n"
+                     "    return vec4(dst.rgb + src.rgb, min(dst.a + src.a, 1.0));\n"
+                     "  } else if (mode == 2) {\n"
+                     "    return src*dst + src*(1.0 - dst.a) + dst*(1.0 - src.a);\n"
+                     "  } else if (mode == 3) {\n"
+                     "    return src + dst - src*dst;\n"
+                     "  }\n"
+                     "  return src + dst*(1.0 - src.a);\n"
+                     "}\n"
+                     "\n"
+                     "void main() {\n"
+                     "  vec4 color = vec4(0.0);\n");
+
+  for (int i=0;i<layers;i++) {
+    frag_shader.append(QString("  color = blend(color, texture2D(layer%1, v_texcoord)*opacity%1, mode%1);\n").arg(i));
+  }
+
+  frag_shader.append("  gl_FragColor = color;\n"
+                     "}\n");
+
+  ShaderPtr program = ShaderCache::Get(QOpenGLContext::currentContext(), DefaultVertexShader(), frag_shader);
+
+  // Each layer samples from the texture unit with the same index
+  program->bind();
+  for (int i=0;i<layers;i++) {
+    program->setUniformValue(QString("layer%1").arg(i).toUtf8().constData(), i);
+  }
+  program->release();
+
+  return program;
+}
+
 QString ShaderGenerator::AlphaDisassociateFunction(const QString &function_name)
 {
   return QString("vec4 %1(vec4 col) {\n"
@@ -45,6 +45,14 @@ public:
                                 OCIO::ConstProcessorRcPtr processor,
                                 bool alpha_is_associated);
 
+  /**
+   * @brief Pipeline that composites `layers` textures over each other in one pass
+   *
+   * Layer `i` is read from texture unit `i` and has the uniforms `opacity<i>` (0.0-1.0) and `mode<i>` (see
+   * CompositorNode::BlendMode). Layer 0 is the bottom layer.
+   */
+  static ShaderPtr CompositorPipeline(int layers);
+
   static QString AlphaDisassociateFunction(const QString& function_name);
   static QString AlphaReassociateFunction(const QString& function_name);
   static QString AlphaAssociateFunction(const QString& function_name);
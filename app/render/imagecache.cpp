@@ -20,294 +20,188 @@
 
 #include "imagecache.h"
 
-#include <QDebug>
+#include "render/pixelservice.h"
 
-ImageCache::ImageCache() :
-  ctx_(nullptr),
-  width_(0),
-  height_(0)
+ImageCache::ImageCache(qint64 budget) :
+  state_(std::make_shared<State>())
 {
+  state_->budget = budget;
+  state_->used = 0;
+  state_->stats.fill(ImageCacheStats {0, 0, 0, 0, 0}, olive::PIX_FMT_COUNT);
 }
 
 ImageCache::~ImageCache()
 {
-  buffer_array_mutex_.lock();
-
   Clear();
-
-  buffer_array_mutex_.unlock();
 }
 
-void ImageCache::SetParameters(QOpenGLContext *ctx, int width, int height)
+RenderTexturePtr ImageCache::Get(QOpenGLContext *ctx,
+                                 int width,
+                                 int height,
+                                 const olive::PixelFormat &format,
+                                 const RenderTexture::Type &type)
 {
-  buffer_array_mutex_.lock();
+  Q_ASSERT(format > olive::PIX_FMT_INVALID && format < olive::PIX_FMT_COUNT);
 
-  ctx_ = ctx;
+  Key key = {width, height, format, type};
+  qint64 size = TextureSize(key);
 
-  if (ctx_ != nullptr) {
-    Q_ASSERT(width > 0 && height > 0);
-
-    width_ = width;
-    height_ = height;
-  }
+  RenderTexture* texture = nullptr;
 
-  Clear();
+  // Textures are only destroyed once the lock is released
+  QList<RenderTexture*> destroy;
 
-  buffer_array_mutex_.unlock();
-}
+  state_->lock.lock();
 
-int ImageCache::RequestBuffer(Ref* r, const BufferType& type, const olive::PixelFormat& format, int width, int height)
-{
-  if (type == kTexBuf && (ctx_ == nullptr || width_ == 0 || height_ == 0)) {
-    qWarning() << tr("Texture cache request made without valid parameters (%1: %2, %3").arg(QString::number(reinterpret_cast<quintptr>(ctx_)),
-                                                                                            QString::number(width_),
-                                                                                            QString::number(height_));
-    return -1;
-  }
-
-  buffer_array_mutex_.lock();
-
-  int buffer = RequestBufferInternal(r, type, format, width, height);
-
-  buffer_array_mutex_.unlock();
-
-  return buffer;
-}
-
-int ImageCache::RequestBufferInternal(Ref *r, const BufferType& type, const olive::PixelFormat& format, int width, int height)
-{
-  Q_ASSERT(type != kInvalidBuf);
+  ImageCacheStats& stats = state_->stats[format];
 
-  QList<int>& relinquished = (type == kMemBuf) ? img_relinquished_ : tex_relinquished_;
-  QList<Ref*>& refs = (type == kMemBuf) ? img_refs_ : tex_refs_;
-  QList<time_t>& access_times = (type == kMemBuf) ? img_access_times_ : tex_access_times_;
+  // Reuse the most recently released texture with these parameters
+  QHash<Key, QList<FreeIterator>>::iterator bucket = state_->free_by_key.find(key);
 
-  // Try to return a relinquished buffer
-  if (!relinquished.isEmpty()) {
+  while (texture == nullptr && bucket != state_->free_by_key.end() && !bucket->isEmpty()) {
+    FreeIterator it = bucket->takeLast();
+    RenderTexture* candidate = it->texture;
+    state_->free.erase(it);
 
-    if (type == kTexBuf) {
-
-      int buf_index = relinquished.takeFirst();
-
-      refs.replace(buf_index, r);
-
-      return buf_index;
-
-    } else if (type == kMemBuf) {
-
-      // Check for a relinquished buffer with the desired size
-
-      //
-      // TODO consider a database for sorting through these buffers
-      //
-      for (int i=0;i<relinquished.size();i++) {
-
-        const MemoryBuffer& b = img_buffers_.at(relinquished.at(i));
-
-        if (b.width() == width && b.height() == height) {
-          // This buffer fits, we'll use it
-          int buffer_index = relinquished.takeAt(i);
-
-          refs.replace(buffer_index, r);
-
-          return buffer_index;
-        }
-      }
+    stats.bytes_free -= size;
 
+    if (candidate->IsCreated()) {
+      texture = candidate;
+    } else {
+      // This texture was destroyed along with its context
+      state_->used -= size;
+      destroy.append(candidate);
     }
   }
 
-  // If no buffer was available, we may have to create a new one
+  if (texture != nullptr) {
+    stats.hits++;
+  } else {
+    stats.misses++;
 
-  // Check if we have enough memory (according to user-defined limits in the Config), if we don't, try to relinquish an
-  // old buffer and return that.
-  if (OutOfMemory()) {
+    // Make room for the new texture, starting with the textures that have been unused for the longest
+    while (state_->used + size > state_->budget && !state_->free.empty()) {
+      const FreeTexture& oldest = state_->free.front();
+      qint64 oldest_size = TextureSize(oldest.key);
 
-    //
-    // TODO no support for a MemBuf's variable size
-    //
+      ImageCacheStats& oldest_stats = state_->stats[oldest.key.format];
+      oldest_stats.bytes_free -= oldest_size;
+      oldest_stats.evictions++;
 
-    int least_recent_access = 0;
+      state_->used -= oldest_size;
+      state_->free_by_key[oldest.key].removeFirst();
+      destroy.append(oldest.texture);
 
-    // Loop through buffers for the oldest accessed buffer
-    for (int i=1;i<access_times.size();i++) {
-      if (access_times.at(i) < access_times.at(least_recent_access)
-          && refs.at(i) != nullptr) { // ensure this buffer has not been relinquished
-        least_recent_access = i;
-      }
+      state_->free.pop_front();
     }
 
-    // Relinquish this buffer
-    refs.at(least_recent_access)->Relinquish();
-    refs.replace(least_recent_access, r);
-    return least_recent_access;
+    state_->used += size;
   }
 
-  // Otherwise, just generate a new buffer
-  int index = -1;
-  switch (type) {
-  case kMemBuf:
-    index = img_buffers_.size();
-    img_buffers_.append(MemoryBuffer());
-    img_buffers_.last().Create(width_, height_, format);
-    break;
-  case kTexBuf:
-    index = tex_buffers_.size();
-    tex_buffers_.append(TextureBuffer());
-    tex_buffers_.last().Create(ctx_, format, width_, height_);
-    break;
-  default:
-    Q_ASSERT(false);
-  }
+  stats.bytes_in_use += size;
 
-  refs.append(r);
-  access_times.append(time(nullptr));
+  state_->lock.unlock();
 
-  return index;
-}
+  qDeleteAll(destroy);
 
-void ImageCache::RelinquishBuffer(int index, const BufferType &type)
-{
-  buffer_array_mutex_.lock();
-
-  switch (type) {
-  case kMemBuf:
-    img_refs_.replace(index, nullptr);
-    img_relinquished_.append(index);
-    break;
-  case kTexBuf:
-    tex_refs_.replace(index, nullptr);
-    tex_relinquished_.append(index);
-    break;
-  default:
-    qFatal("Invalid buffer type on ImageCache::RelinquishBuffer");
+  if (texture == nullptr) {
+    texture = new RenderTexture();
+    texture->Create(ctx, width, height, format, type);
+  } else {
+    // Whichever context released this texture may still be reading from it, don't draw over it until it's done
+    texture->WaitFence();
   }
 
-  buffer_array_mutex_.unlock();
-}
+  std::weak_ptr<State> weak_state = state_;
 
-void *ImageCache::Buffer(int index, const BufferType &type)
-{
-  switch (type) {
-  case kMemBuf:
-    img_access_times_.replace(index, time(nullptr));
-    return &img_buffers_[index];
-  case kTexBuf:
-    tex_access_times_.replace(index, time(nullptr));
-    return &tex_buffers_[index];
-  default:
-    qFatal("Invalid buffer type on ImageCache::Buffer");
-  }
-}
-
-bool ImageCache::OutOfMemory()
-{
-  // TODO actually check if we have any memory or not
-  return false;
+  return RenderTexturePtr(texture, [weak_state, key](RenderTexture* t) {
+    Recycle(weak_state, key, t);
+  });
 }
 
 void ImageCache::Clear()
 {
-  for (int i=0;i<img_refs_.size();i++) {
-    img_refs_.at(i)->Relinquish();
-  }
+  QList<RenderTexture*> destroy;
+
+  state_->lock.lock();
 
-  for (int i=0;i<tex_refs_.size();i++) {
-    tex_refs_.at(i)->Relinquish();
+  for (FreeIterator it=state_->free.begin();it!=state_->free.end();it++) {
+    qint64 size = TextureSize(it->key);
+
+    state_->stats[it->key.format].bytes_free -= size;
+    state_->used -= size;
+
+    destroy.append(it->texture);
   }
 
-  img_refs_.clear();
-  tex_refs_.clear();
+  state_->free.clear();
+  state_->free_by_key.clear();
 
-  img_buffers_.clear();
-  tex_buffers_.clear();
+  state_->lock.unlock();
 
-  img_relinquished_.clear();
-  tex_relinquished_.clear();
+  qDeleteAll(destroy);
 }
 
-ImageCache::Ref::Ref(ImageCache *cache) :
-  buffer_type_(kInvalidBuf),
-  width_(cache->width_),
-  height_(cache->height_),
-  cache_(cache),
-  buffer_(-1)
+QVector<ImageCacheStats> ImageCache::GetStats()
 {
+  state_->lock.lock();
+  QVector<ImageCacheStats> stats = state_->stats;
+  state_->lock.unlock();
+
+  return stats;
 }
 
-ImageCache::Ref::~Ref()
+bool ImageCache::Key::operator==(const ImageCache::Key &rhs) const
 {
-  Relinquish();
+  return width == rhs.width && height == rhs.height && format == rhs.format && type == rhs.type;
 }
 
-void *ImageCache::Ref::BufferInternal()
+ImageCache::State::~State()
 {
-  // If we don't have a buffer yet, request one
-  if (buffer_ == -1) {
-    Request();
+  // Textures released after the ImageCache was destroyed but before the last reference to this state was dropped
+  for (FreeIterator it=free.begin();it!=free.end();it++) {
+    delete it->texture;
   }
-
-  // If we didn't receive one, return null
-  if (buffer_ == -1) {
-    return nullptr;
-  }
-
-  // Otherwise, return the buffer we received
-  return cache_->Buffer(buffer_, buffer_type_);
 }
 
-void ImageCache::Ref::Relinquish()
+qint64 ImageCache::TextureSize(const ImageCache::Key &key)
 {
-  if (buffer_ == -1) {
-    return;
+  qint64 size = PixelService::GetBufferSize(key.format, key.width, key.height);
+
+  if (key.type == RenderTexture::kDoubleBuffer) {
+    size *= 2;
   }
 
-  cache_->RelinquishBuffer(buffer_, buffer_type_);
-  buffer_ = -1;
+  return size;
 }
 
-void ImageCache::Ref::Request()
+void ImageCache::Recycle(const std::weak_ptr<State> &weak_state, const ImageCache::Key &key, RenderTexture *texture)
 {
-  // Check if we already have a buffer, in which case we don't need to request a new one
-  if (buffer_ != -1) {
-    return;
-  }
+  std::shared_ptr<State> state = weak_state.lock();
 
-  // Check if we have a valid buffer type to request
-  if (buffer_type_ == kInvalidBuf) {
-    qWarning() << tr("Tried to request an invalid buffer type");
+  if (state == nullptr) {
+    delete texture;
     return;
   }
 
-  buffer_ = cache_->RequestBuffer(this, buffer_type_, width_, height_);
-}
+  // If another context (e.g. the viewer or a download thread) was the last to use this texture, its reads may still be
+  // pending on the GPU. Fence them so Get() can wait for them before the texture is drawn over.
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
 
-ImageCache::ImgRef::ImgRef(ImageCache *cache) :
-  Ref(cache)
-{
-  buffer_type_ = kMemBuf;
-}
+  if (ctx != nullptr && ctx != texture->context() && texture->IsCreated()) {
+    texture->Fence();
+  }
 
-void ImageCache::ImgRef::SetSize(int w, int h)
-{
-  width_ = w;
-  height_ = h;
+  qint64 size = TextureSize(key);
 
-  Relinquish();
-}
+  state->lock.lock();
 
-MemoryBuffer *ImageCache::ImgRef::buffer()
-{
-  return static_cast<MemoryBuffer*>(BufferInternal());
-}
+  state->free.push_back(FreeTexture {texture, key});
+  state->free_by_key[key].append(std::prev(state->free.end()));
 
-ImageCache::TexRef::TexRef(ImageCache *cache) :
-  Ref(cache)
-{
-  buffer_type_ = kTexBuf;
-}
+  ImageCacheStats& stats = state->stats[key.format];
+  stats.bytes_in_use -= size;
+  stats.bytes_free += size;
 
-TextureBuffer *ImageCache::TexRef::buffer()
-{
-  return static_cast<TextureBuffer*>(BufferInternal());
+  state->lock.unlock();
 }
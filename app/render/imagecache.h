@@ -18,94 +18,142 @@
 
 ***/
 
-#ifndef MEMORYCACHE_H
-#define MEMORYCACHE_H
+#ifndef IMAGECACHE_H
+#define IMAGECACHE_H
 
+#include <iterator>
+#include <list>
+#include <memory>
+#include <QHash>
 #include <QList>
 #include <QMutex>
+#include <QVector>
+
+#include "rendertexture.h"
+
+/**
+ * @brief Usage statistics for one pixel format in an ImageCache
+ */
+struct ImageCacheStats {
+  qint64 hits;
+  qint64 misses;
+  qint64 evictions;
+  qint64 bytes_in_use;
+  qint64 bytes_free;
+};
 
-#include "texturebuffer.h"
-#include "memorybuffer.h"
-
-class ImageCache : public QObject
+/**
+ * @brief A pool of textures that are recycled rather than created for every frame
+ *
+ * Get() returns a texture with the requested size, format and type. Once every reference to it is gone, the texture
+ * goes back to the pool instead of being destroyed, and the next request with the same parameters receives it again
+ * without allocating anything. Textures waiting in the pool are kept in least recently released order and destroyed,
+ * oldest first, when creating another texture would put the pool over its byte budget. Textures that are still in use
+ * can't be evicted, so the pool will go over budget rather than fail a request.
+ *
+ * Recycled textures keep their previous contents, so they must be overwritten or cleared before use. A texture released
+ * in another context is fenced there, and Get() waits on that fence before handing it out again.
+ *
+ * Textures can be released from any thread, but Get() and Clear() create and destroy textures so they must be called
+ * with the pool's context current.
+ */
+class ImageCache
 {
 public:
+  /**
+   * @param budget
+   *
+   * Maximum number of bytes of textures to keep (in use or not)
+   */
+  ImageCache(qint64 budget);
 
-  enum BufferType {
-    kInvalidBuf,  // No buffer
-    kMemBuf,      // RAM (CPU) buffer
-    kTexBuf       // VRAM (GPU) buffer
-  };
-
-  class Ref {
-  public:
-    Ref(ImageCache* cache);
-    ~Ref();
-
-    void Relinquish();
-  protected:
-    void* BufferInternal();
-
-    BufferType buffer_type_;
-
-    int width_;
-    int height_;
-  private:
-    void Request();
-
-    ImageCache* cache_;
-    int buffer_;
-  };
-
-  class ImgRef : public Ref {
-  public:
-    ImgRef(ImageCache* cache);
+  ~ImageCache();
 
-    void SetSize(int w, int h);
+  ImageCache(const ImageCache& other) = delete;
+  ImageCache(ImageCache&& other) = delete;
+  ImageCache& operator=(const ImageCache& other) = delete;
+  ImageCache& operator=(ImageCache&& other) = delete;
+
+  /**
+   * @brief Retrieve a texture, recycling a released one if possible (see RenderTexture::Create() for parameters)
+   */
+  RenderTexturePtr Get(QOpenGLContext* ctx,
+                       int width,
+                       int height,
+                       const olive::PixelFormat &format,
+                       const RenderTexture::Type& type = RenderTexture::kSingleBuffer);
+
+  /**
+   * @brief Destroy every texture waiting in the pool
+   *
+   * Textures that are still in use are unaffected and return to the pool as usual once released.
+   */
+  void Clear();
 
-    MemoryBuffer* buffer();
+  /**
+   * @brief Return usage statistics, indexed by olive::PixelFormat
+   */
+  QVector<ImageCacheStats> GetStats();
 
+private:
+  struct Key {
+    int width;
+    int height;
+    olive::PixelFormat format;
+    RenderTexture::Type type;
+
+    bool operator==(const Key& rhs) const;
+
+    friend uint qHash(const Key& key, uint seed)
+    {
+      return ::qHash(key.width, seed) ^ ::qHash(key.height, seed) ^ ::qHash((key.format << 1) | key.type, seed);
+    }
   };
 
-  class TexRef : public Ref {
-  public:
-    TexRef(ImageCache* cache);
-    TextureBuffer* buffer();
+  struct FreeTexture {
+    RenderTexture* texture;
+    Key key;
   };
 
-  ImageCache();
-  ~ImageCache();
+  using FreeIterator = std::list<FreeTexture>::iterator;
 
-  void SetParameters(QOpenGLContext* ctx, int width, int height);
+  /**
+   * @brief Everything shared with textures that are in use, so they can return after the ImageCache is gone
+   */
+  struct State {
+    ~State();
 
-private:
-  int RequestBuffer(Ref *r, const BufferType& type, const olive::PixelFormat &format, int width, int height);
-  int RequestBufferInternal(Ref *r, const BufferType& type, const olive::PixelFormat &format, int width, int height);
+    qint64 budget;
 
-  void RelinquishBuffer(int index, const BufferType& type);
+    /**
+     * @brief Bytes of all textures created by the pool that haven't been destroyed yet
+     */
+    qint64 used;
 
-  void *Buffer(int index, const BufferType &type);
+    /**
+     * @brief Textures waiting to be reused, least recently released first
+     */
+    std::list<FreeTexture> free;
 
-  bool OutOfMemory();
+    /**
+     * @brief The same textures as `free` grouped by parameters, also least recently released first
+     */
+    QHash<Key, QList<FreeIterator>> free_by_key;
 
-  void Clear();
+    QVector<ImageCacheStats> stats;
 
-  QList<MemoryBuffer> img_buffers_;
-  QList<Ref*> img_refs_;
-  QList<time_t> img_access_times_;
-  QList<int> img_relinquished_;
+    QMutex lock;
+  };
 
-  QList<TextureBuffer> tex_buffers_;
-  QList<Ref*> tex_refs_;
-  QList<time_t> tex_access_times_;
-  QList<int> tex_relinquished_;
+  static qint64 TextureSize(const Key& key);
 
-  QOpenGLContext* ctx_;
+  /**
+   * @brief Deleter for textures handed out by Get(), returns them to the pool if it still exists
+   */
+  static void Recycle(const std::weak_ptr<State>& weak_state, const Key& key, RenderTexture* texture);
 
-  int width_;
-  int height_;
+  std::shared_ptr<State> state_;
 
-  QMutex buffer_array_mutex_;
 };
 
-#endif // MEMORYCACHE_H
+#endif // IMAGECACHE_H
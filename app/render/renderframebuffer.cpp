@@ -23,6 +23,8 @@
 #include <QDebug>
 #include <QOpenGLExtraFunctions>
 
+#include "render/gl/functions.h"
+
 RenderFramebuffer::RenderFramebuffer() :
   context_(nullptr),
   buffer_(0),
@@ -88,14 +90,14 @@ void RenderFramebuffer::Release()
   context_->functions()->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 }
 
-void RenderFramebuffer::Attach(RenderTexturePtr texture)
+void RenderFramebuffer::Attach(RenderTexturePtr texture, bool clear)
 {
   if (context_ == nullptr) {
     return;
   }
 
   texture_ = texture;
-  AttachInternal(texture_->texture(), false);
+  AttachInternal(texture_->texture(), clear);
 }
 
 void RenderFramebuffer::AttachBackBuffer(RenderTexturePtr texture)
@@ -147,6 +149,9 @@ void RenderFramebuffer::AttachInternal(GLuint tex, bool clear)
         GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, 0
         );
 
+  // Anything drawn from here on makes the texture's mipmaps stale
+  olive::gl::TextureChanged(context_, tex);
+
   if (clear) {
     context_->functions()->glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
     context_->functions()->glClear(GL_COLOR_BUFFER_BIT);
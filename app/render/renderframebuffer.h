@@ -44,7 +44,7 @@ public:
 
   void Release();
 
-  void Attach(RenderTexturePtr texture);
+  void Attach(RenderTexturePtr texture, bool clear = false);
 
   void AttachBackBuffer(RenderTexturePtr texture);
 
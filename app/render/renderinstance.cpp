@@ -24,12 +24,19 @@
 
 #include "render/gl/shadergenerators.h"
 
+/**
+ * @brief Maximum number of bytes of textures each RenderInstance keeps for reuse
+ */
+const qint64 kImageCacheBudget = 128 * 1024 * 1024;
+
 RenderInstance::RenderInstance(const int& width,
                                const int& height,
                                const int& divider,
                                const olive::PixelFormat& format,
                                const olive::RenderMode& mode) :
+  ctx_(nullptr),
   share_ctx_(nullptr),
+  image_cache_(kImageCacheBudget),
   width_(width),
   height_(height),
   format_(format),
@@ -93,18 +100,25 @@ bool RenderInstance::Start()
 
 void RenderInstance::Stop()
 {
-  if (IsStarted()) {
+  if (!IsStarted()) {
     return;
   }
 
+  // Everything below deletes GL objects, which needs this instance's context
+  ctx_->makeCurrent(&surface_);
+
   // Destroy pipeline
   default_pipeline_ = nullptr;
 
+  // Destroy unused textures (any still in use are destroyed along with the context)
+  image_cache_.Clear();
+
   // Destroy buffer
   buffer_.Destroy();
 
   // Destroy context
   delete ctx_;
+  ctx_ = nullptr;
 }
 
 bool RenderInstance::IsStarted()
@@ -117,6 +131,11 @@ RenderFramebuffer *RenderInstance::buffer()
   return &buffer_;
 }
 
+ImageCache *RenderInstance::image_cache()
+{
+  return &image_cache_;
+}
+
 QOpenGLContext *RenderInstance::context()
 {
   return ctx_;
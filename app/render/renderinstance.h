@@ -26,6 +26,7 @@
 #include <QOpenGLContext>
 
 #include "render/gl/shaderptr.h"
+#include "render/imagecache.h"
 #include "render/renderframebuffer.h"
 #include "render/rendermodes.h"
 
@@ -78,6 +79,11 @@ public:
 
   RenderFramebuffer* buffer();
 
+  /**
+   * @brief Pool that Nodes should take their output textures from rather than creating them
+   */
+  ImageCache* image_cache();
+
   QOpenGLContext* context();
 
   const int& width() const;
@@ -101,6 +107,8 @@ private:
 
   RenderFramebuffer buffer_;
 
+  ImageCache image_cache_;
+
   int width_;
 
   int height_;
@@ -23,15 +23,31 @@
 #include <QDateTime>
 #include <QDebug>
 
+#include "render/gl/functions.h"
 #include "render/pixelservice.h"
 
+/**
+ * @brief Deleter for the fences shared by RenderTexture::Fence() and RenderTexture::WaitFence()
+ *
+ * Sync objects are shared between contexts, so whichever context drops the last reference can delete it. That's
+ * normally a context that has just fenced or waited on the texture, so one is current.
+ */
+void DeleteFence(GLsync fence) {
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+
+  if (ctx != nullptr) {
+    ctx->extraFunctions()->glDeleteSync(fence);
+  }
+}
+
 RenderTexture::RenderTexture() :
   context_(nullptr),
   texture_(0),
   back_texture_(0),
   width_(0),
   height_(0),
-  format_(olive::PIX_FMT_INVALID)
+  format_(olive::PIX_FMT_INVALID),
+  read_fbo_(0)
 {
 }
 
@@ -80,12 +96,24 @@ void RenderTexture::Destroy()
   if (context_ != nullptr) {
     disconnect(context_, SIGNAL(aboutToBeDestroyed()), this, SLOT(Destroy()));
 
+    olive::gl::TextureChanged(context_, texture_);
     context_->functions()->glDeleteTextures(1, &texture_);
     texture_ = 0;
 
+    olive::gl::TextureChanged(context_, back_texture_);
     context_->functions()->glDeleteTextures(1, &back_texture_);
     back_texture_ = 0;
 
+    if (read_fbo_ != 0) {
+      context_->functions()->glDeleteFramebuffers(1, &read_fbo_);
+      read_fbo_ = 0;
+    }
+
+    // Any thread still waiting on the fence holds its own reference, so it's only deleted once they're done
+    fence_lock_.lock();
+    fence_ = nullptr;
+    fence_lock_.unlock();
+
     context_ = nullptr;
   }
 }
@@ -97,6 +125,9 @@ void RenderTexture::Bind()
     return;
   }
 
+  // Make sure whichever context drew to this texture has finished before we use it
+  WaitFence();
+
   context_->functions()->glBindTexture(GL_TEXTURE_2D, texture_);
 }
 
@@ -168,6 +199,8 @@ void RenderTexture::Upload(const void *data)
                                          info.pixel_type,
                                          data);
 
+  olive::gl::TextureChanged(context_, texture_);
+
   Release();
 }
 
@@ -180,11 +213,13 @@ uchar *RenderTexture::Download() const
 
   QOpenGLFunctions* f = context_->functions();
 
-  GLuint read_fbo;
+  if (read_fbo_ == 0) {
+    f->glGenFramebuffers(1, &read_fbo_);
+  }
 
-  f->glGenFramebuffers(1, &read_fbo);
+  WaitFence();
 
-  f->glBindFramebuffer(GL_READ_FRAMEBUFFER, read_fbo);
+  f->glBindFramebuffer(GL_READ_FRAMEBUFFER, read_fbo_);
 
   context_->extraFunctions()->glFramebufferTexture2D(
         GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture_, 0
@@ -198,11 +233,73 @@ uchar *RenderTexture::Download() const
 
   f->glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
 
-  f->glDeleteFramebuffers(1, &read_fbo);
-
   return data;
 }
 
+void RenderTexture::Fence()
+{
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+
+  if (ctx == nullptr) {
+    qWarning() << tr("RenderTexture::Fence() called without a current context");
+    return;
+  }
+
+  if (!SyncSupported(ctx)) {
+    ctx->functions()->glFinish();
+    return;
+  }
+
+  QOpenGLExtraFunctions* xf = ctx->extraFunctions();
+
+  // Several contexts can fence the same texture (e.g. a cached texture returned by more than one render thread). Only
+  // the newest fence is kept, so make it come after any fence another context inserted before it.
+  WaitFence();
+
+  FencePtr fence(xf->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), DeleteFence);
+
+  // Waiting on a fence that was never flushed from another context can wait forever
+  xf->glFlush();
+
+  // Other threads may be holding the old fence, it's only deleted once they've all finished with it
+  fence_lock_.lock();
+  fence_.swap(fence);
+  fence_lock_.unlock();
+}
+
+void RenderTexture::WaitFence() const
+{
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+
+  if (ctx == nullptr) {
+    return;
+  }
+
+  // Take our own reference so the fence can't be deleted by Fence() while we're waiting on it
+  fence_lock_.lock();
+  FencePtr fence = fence_;
+  fence_lock_.unlock();
+
+  if (fence == nullptr) {
+    return;
+  }
+
+  ctx->extraFunctions()->glWaitSync(fence.get(), 0, GL_TIMEOUT_IGNORED);
+}
+
+bool RenderTexture::SyncSupported(QOpenGLContext *ctx)
+{
+  if (ctx == nullptr) {
+    return false;
+  }
+
+  if (ctx->isOpenGLES()) {
+    return (ctx->format().majorVersion() >= 3);
+  }
+
+  return (ctx->format().version() >= qMakePair(3, 2) || ctx->hasExtension("GL_ARB_sync"));
+}
+
 void RenderTexture::CreateInternal(GLuint* tex, void *data)
 {
   QOpenGLFunctions* f = context_->functions();
@@ -234,8 +331,11 @@ void RenderTexture::CreateInternal(GLuint* tex, void *data)
         data
         );
 
-  // Set texture filtering to bilinear
-  f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  // A recycled texture name may still be marked as mipmapped
+  olive::gl::TextureChanged(context_, *tex);
+
+  // Set texture filtering to bilinear (there are no mipmaps until a Blit() needs them)
+  f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
   f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
   // Release texture
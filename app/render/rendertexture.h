@@ -22,7 +22,10 @@
 #define RENDERTEXTURE_H
 
 #include <memory>
+#include <QMutex>
+#include <QOpenGLExtraFunctions>
 #include <QOpenGLFunctions>
+#include <type_traits>
 
 #include "pixelformat.h"
 
@@ -67,6 +70,32 @@ public:
 
   uchar *Download() const;
 
+  /**
+   * @brief Insert a fence after the commands that have been issued so far in the current context
+   *
+   * Call this in the context that drew to this texture once drawing is complete. Other contexts can then use
+   * WaitFence() to wait for the texture to be ready, rather than the drawing context stalling in glFinish().
+   *
+   * If the current context doesn't support sync objects, this falls back to glFinish().
+   *
+   * This function is thread-safe.
+   */
+  void Fence();
+
+  /**
+   * @brief Make the current context wait for the fence inserted by Fence() (if any)
+   *
+   * This is a server-side wait, so it doesn't block the calling thread.
+   *
+   * This function is thread-safe.
+   */
+  void WaitFence() const;
+
+  /**
+   * @brief Returns whether a context supports sync objects (OpenGL 3.2, OpenGL ES 3.0 or ARB_sync)
+   */
+  static bool SyncSupported(QOpenGLContext* ctx);
+
 public slots:
   void Destroy();
 
@@ -84,6 +113,23 @@ private:
   int height_;
 
   olive::PixelFormat format_;
+
+  /**
+   * @brief A reference counted sync object, deleted once neither the texture nor any waiting thread needs it
+   */
+  using FencePtr = std::shared_ptr<std::remove_pointer<GLsync>::type>;
+
+  /**
+   * @brief The fence inserted by the last Fence(), protected by fence_lock_
+   */
+  FencePtr fence_;
+
+  mutable QMutex fence_lock_;
+
+  /**
+   * @brief Framebuffer used by Download(), created the first time it's needed
+   */
+  mutable GLuint read_fbo_;
 };
 
 using RenderTexturePtr = std::shared_ptr<RenderTexture>;
@@ -134,6 +134,7 @@ void ImportTask::Import(const QStringList &files, Folder *folder, QUndoCommand *
       f->set_filename(url);
       f->set_name(file_info.fileName());
       f->set_timestamp(file_info.lastModified());
+      f->set_file_size(file_info.size());
 
       // Create undoable command that adds the items to the model
       new ProjectViewModel::AddItemCommand(model_,
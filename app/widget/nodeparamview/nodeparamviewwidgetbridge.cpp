@@ -301,7 +301,7 @@ void NodeParamViewWidgetBridge::WidgetCallback()
     {
       // Widget is a QFontComboBox
       QFontComboBox* font_combobox = static_cast<QFontComboBox*>(sender());
-      input->set_value(font_combobox->currentFont());
+      input->set_value(font_combobox->currentFont().toString());
       break;
     }
     case NodeParam::kFootage:
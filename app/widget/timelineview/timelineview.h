@@ -63,6 +63,12 @@ signals:
   void RequestReplaceBlock(Block* old, Block* replace, int track);
   void RequestSplitAtTime(rational time, int track);
 
+  /**
+   * @brief Signals that the following requests are part of one edit, until RequestCommitEdit() is emitted
+   */
+  void RequestBeginEdit();
+  void RequestCommitEdit();
+
 protected:
   virtual void mousePressEvent(QMouseEvent *event) override;
   virtual void mouseMoveEvent(QMouseEvent *event) override;
@@ -47,7 +47,7 @@ TimelineViewGhostItem *TimelineViewGhostItem::FromClip(TimelineViewClipItem *cli
 
   ghost->SetIn(clip->in());
   ghost->SetOut(clip->out());
-  ghost->setData(0, Node::PtrToValue(clip));
+  ghost->setData(0, Node::PtrToValue(clip).ToVariant());
 
   return ghost;
 }
@@ -154,6 +154,8 @@ void TimelineView::ImportTool::DragDrop(QDropEvent *event)
     // of scope will delete the nodes. If there is, they'll become parents of the NodeGraph instead
     QObject node_memory_manager;
 
+    emit parent()->RequestBeginEdit();
+
     foreach (TimelineViewGhostItem* ghost, parent()->ghost_items_) {
       ClipBlock* clip = new ClipBlock();
       MediaInput* media = new MediaInput();
@@ -180,6 +182,8 @@ void TimelineView::ImportTool::DragDrop(QDropEvent *event)
       }
     }
 
+    emit parent()->RequestCommitEdit();
+
     parent()->ClearGhosts();
 
     event->accept();
@@ -147,6 +147,9 @@ void TimelineView::PointerTool::MouseRelease(QMouseEvent *event)
 
   QObject block_memory_manager;
 
+  // Moving all the Blocks is one edit
+  emit parent()->RequestBeginEdit();
+
   foreach (TimelineViewGhostItem* ghost, parent()->ghost_items_) {
     Block* b = Node::ValueToPtr<Block>(ghost->data(0));
 
@@ -175,6 +178,8 @@ void TimelineView::PointerTool::MouseRelease(QMouseEvent *event)
     emit parent()->RequestPlaceBlock(b, ghost->GetAdjustedIn(), ghost->GetAdjustedTrack());
   }
 
+  emit parent()->RequestCommitEdit();
+
   parent()->ClearGhosts();
 
   dragging_ = false;
@@ -27,6 +27,9 @@ TimelineView::RazorTool::RazorTool(TimelineView* parent) :
 
 void TimelineView::RazorTool::MousePress(QMouseEvent *event)
 {
+  // Every split made during this drag is one edit
+  emit parent()->RequestBeginEdit();
+
   MouseMove(event);
 }
 
@@ -52,5 +55,7 @@ void TimelineView::RazorTool::MouseRelease(QMouseEvent *event)
 {
   Q_UNUSED(event)
 
+  emit parent()->RequestCommitEdit();
+
   dragging_ = false;
 }
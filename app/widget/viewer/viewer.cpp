@@ -121,7 +121,7 @@ bool ViewerWidget::IsPlaying()
   return playback_timer_.isActive();
 }
 
-void ViewerWidget::SetTexture(GLuint tex)
+void ViewerWidget::SetTexture(RenderTexturePtr tex)
 {
   gl_widget_->SetTexture(tex);
 }
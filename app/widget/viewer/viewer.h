@@ -67,7 +67,7 @@ public slots:
    *
    * @param tex
    */
-  void SetTexture(GLuint tex);
+  void SetTexture(RenderTexturePtr tex);
 
   void GoToStart();
 
@@ -29,14 +29,13 @@
 
 ViewerGLWidget::ViewerGLWidget(QWidget *parent) :
   QOpenGLWidget(parent),
-  texture_(0),
   ocio_lut_(0)
 {
   // FIXME: Hardcoded values for testing
   color_service_ = ColorService::Create(OCIO::ROLE_SCENE_LINEAR, "srgb");
 }
 
-void ViewerGLWidget::SetTexture(GLuint tex)
+void ViewerGLWidget::SetTexture(RenderTexturePtr tex)
 {
   // Update the texture
   texture_ = tex;
@@ -66,9 +65,12 @@ void ViewerGLWidget::paintGL()
   f->glClear(GL_COLOR_BUFFER_BIT);
 
   // Check if we have a texture to draw
-  if (texture_ > 0) {
+  if (texture_ != nullptr) {
+    // The texture may have been drawn by a render thread, wait for it to finish before drawing it
+    texture_->WaitFence();
+
     // Bind retrieved texture
-    f->glBindTexture(GL_TEXTURE_2D, texture_);
+    f->glBindTexture(GL_TEXTURE_2D, texture_->texture());
 
     // Blit using the pipeline retrieved in initializeGL()
     olive::gl::OCIOBlit(pipeline_, ocio_lut_, true);
@@ -24,6 +24,7 @@
 #include <QOpenGLWidget>
 
 #include "render/colorservice.h"
+#include "render/rendertexture.h"
 #include "render/gl/shaderptr.h"
 
 /**
@@ -32,7 +33,7 @@
  * Actual composition occurs elsewhere offscreen and
  * multithreaded, so its main purpose is receiving a finalized OpenGL texture and displaying it.
  *
- * The main entry point is SetTexture() which will receive an OpenGL texture ID, store it, and then call update() to
+ * The main entry point is SetTexture() which will receive a RenderTexture, store it, and then call update() to
  * draw it on screen. The drawing function is in paintGL() (called during the update() process by Qt) and is fairly
  * simple OpenGL drawing code standardized around OpenGL ES 3.2 Core.
  *
@@ -62,7 +63,7 @@ public slots:
    *
    * @param tex
    */
-  void SetTexture(GLuint tex);
+  void SetTexture(RenderTexturePtr tex);
 
 protected:
   /**
@@ -80,9 +81,11 @@ protected:
   virtual void paintGL() override;
 private:
   /**
-   * @brief Internal reference to the OpenGL texture to draw. Set in SetTexture() and used in paintGL().
+   * @brief Internal reference to the texture to draw. Set in SetTexture() and used in paintGL().
+   *
+   * Holding a reference also keeps the texture alive for as long as it's on screen.
    */
-  GLuint texture_;
+  RenderTexturePtr texture_;
 
   /**
    * @brief Internal shader object to use as the pipeline shader